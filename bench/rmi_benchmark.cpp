@@ -0,0 +1,514 @@
+/*
+ * Self-contained benchmark suite: builds trees for procedural meshes (and optional
+ * mesh files), sweeps splitters, thread counts and query types and prints results
+ * as JSON. Compare mode reports operations, that became slower between two runs.
+ *
+ * rmi_benchmark [--meshes sphere,terrain,soup,slivers] [--sizes 10000,100000,1000000]
+ *               [--files data/bunny.ply,...] [--splitters sah,median] [--threads 1,2,4,8]
+ *               [--queries sync,omp,brute,pool,closest,count,spatial,region] [--workloads camera,secondary,uniform]
+ *               [--rays 10000] [--repeat 3] [--seed 1]
+ *               [--output results.json]
+ * rmi_benchmark --compare baseline.json current.json [--threshold 0.1]
+ */
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "rmilib/rmi.hpp"
+#include "rmilib/raw_mesh.hpp"
+#include "rmilib/reader.hpp"
+#include "rmilib/mesh_generator.hpp"
+#include "rmilib/ray_generator.hpp"
+#include "rmilib/closest_point.hpp"
+#include "rmilib/spatial_tree.hpp"
+#include "rmilib/region_query.hpp"
+
+
+struct Options {
+    std::vector<std::string> meshes = {"sphere", "terrain", "soup", "slivers"};
+    std::vector<size_t> sizes = {10000, 100000, 1000000};
+    std::vector<std::string> files;
+    std::vector<std::string> splitters = {"sah", "median"};
+    std::vector<int> threads = {1, 2, 4, 8};
+    // pool starts threads for every ray, so it is opt-in; closest searches nearest points to ray origins,
+    // count counts hits without storing them, spatial compares object and spatial splits trees,
+    // region selects triangles in boxes and a view frustum
+    std::vector<std::string> queries = {"sync", "omp", "brute"};
+    // also segments and scanlines, see rmi::Workload
+    std::vector<std::string> workloads = {"camera", "secondary", "uniform"};
+    size_t rays = 10000;
+    int repeat = 3;
+    unsigned seed = 1;
+    std::string output;
+
+    std::vector<std::string> compare;
+    double threshold = 0.1;
+};
+
+struct Result {
+    std::string mesh;
+    size_t triangles;
+    std::string splitter;
+    // "build" or query type
+    std::string operation;
+    // empty for build
+    std::string workload;
+    int threads;
+    double seconds;
+    // zero for build, count of regions for region queries
+    size_t rays;
+};
+
+
+// Brute force search is skipped when it would test more triangles
+constexpr double brute_force_limit = 1e9;
+
+// Region queries select triangles in boxes of this fraction of the mesh extent
+constexpr float region_box_size = 0.01f;
+constexpr size_t region_boxes_count = 100;
+
+
+std::vector<std::string> split_list(const std::string& list) {
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+template<typename T>
+std::vector<T> parse_numbers(const std::string& list) {
+    std::vector<T> numbers;
+    for (const auto& item : split_list(list)) {
+        numbers.push_back(static_cast<T>(std::stod(item)));
+    }
+    return numbers;
+}
+
+Options parse_options(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw "Missing value of " + arg;
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--meshes") {
+            options.meshes = split_list(value());
+        } else if (arg == "--sizes") {
+            options.sizes = parse_numbers<size_t>(value());
+        } else if (arg == "--files") {
+            options.files = split_list(value());
+        } else if (arg == "--splitters") {
+            options.splitters = split_list(value());
+        } else if (arg == "--threads") {
+            options.threads = parse_numbers<int>(value());
+        } else if (arg == "--queries") {
+            options.queries = split_list(value());
+        } else if (arg == "--workloads") {
+            options.workloads = split_list(value());
+        } else if (arg == "--rays") {
+            options.rays = std::stoul(value());
+        } else if (arg == "--repeat") {
+            options.repeat = std::max(1, std::stoi(value()));
+        } else if (arg == "--seed") {
+            options.seed = static_cast<unsigned>(std::stoul(value()));
+        } else if (arg == "--output") {
+            options.output = value();
+        } else if (arg == "--compare") {
+            options.compare.push_back(value());
+            options.compare.push_back(value());
+        } else if (arg == "--threshold") {
+            options.threshold = std::stod(value());
+        } else {
+            throw "Unknown option " + arg;
+        }
+    }
+    return options;
+}
+
+
+WebGLMesh make_mesh(const std::string& name, size_t size, unsigned seed) {
+    if (name == "sphere") {
+        return generate_sphere_mesh<float, unsigned int>(size);
+    } else if (name == "terrain") {
+        return generate_terrain_mesh<float, unsigned int>(size, seed);
+    } else if (name == "soup") {
+        return generate_soup_mesh<float, unsigned int>(size, seed);
+    } else if (name == "slivers") {
+        return generate_slivers_mesh<float, unsigned int>(size, seed);
+    }
+    throw "Unknown mesh " + name;
+}
+
+// Best of several runs
+template<typename Function>
+double measure(int repeat, Function function) {
+    double best = std::numeric_limits<double>::max();
+    for (int i = 0; i < repeat; ++i) {
+        const auto start = std::chrono::steady_clock::now();
+        function();
+        const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+        best = std::min(best, duration.count());
+    }
+    return best;
+}
+
+bool has_query(const Options& options, const std::string& query) {
+    return std::find(options.queries.begin(), options.queries.end(), query) != options.queries.end();
+}
+
+// Counts visited nodes and tested triangles
+template<typename Node>
+void traversal_work(const Node& node, const rmi::Ray<float>& ray, size_t& nodes, size_t& triangles) {
+    ++nodes;
+    if (node.is_leaf()) {
+        triangles += static_cast<size_t>(std::distance(node.begin(), node.end()));
+        return;
+    }
+    if (ray.is_intersects(node.left().box()))  traversal_work(node.left(), ray, nodes, triangles);
+    if (ray.is_intersects(node.right().box())) traversal_work(node.right(), ray, nodes, triangles);
+}
+
+// Prints sibling overlap of tree and work per ray of workload
+template<typename Tree>
+void print_work(const std::string& name, const Tree& tree, const std::vector<rmi::Ray<float>>& rays) {
+    size_t nodes = 0, triangles = 0;
+    for (const auto& ray : rays) {
+        traversal_work(tree.top(), ray, nodes, triangles);
+    }
+    std::cerr << name << ": sibling overlap " << rmi::get_tree_stats(tree.top()).overlap
+              << ", per ray: " << static_cast<double>(nodes) / rays.size() << " nodes visited, "
+              << static_cast<double>(triangles) / rays.size() << " triangles tested" << std::endl;
+}
+
+template<typename Function>
+void with_splitter(const std::string& name, Function function) {
+    if (name == "sah") {
+        function(rmi::SAHSplitter<WebGLMesh>());
+    } else if (name == "median") {
+        function(rmi::MedianSplitter<WebGLMesh>());
+    } else {
+        throw "Unknown splitter " + name;
+    }
+}
+
+
+void run_mesh(const std::string& name, WebGLMesh& mesh, const Options& options, std::vector<Result>& results) {
+    const size_t triangles = mesh.size();
+
+    std::vector<std::pair<std::string, std::vector<rmi::Ray<float>>>> workloads;
+    for (const auto& workload : options.workloads) {
+        workloads.emplace_back(workload, rmi::generate_rays<float>(
+            rmi::workload_from_string(workload), mesh, options.rays, options.seed
+        ));
+    }
+
+    auto report = [&](const std::string& splitter, const std::string& operation, const std::string& workload,
+                      int threads, double seconds, size_t rays_count) {
+        results.push_back({name, triangles, splitter, operation, workload, threads, seconds, rays_count});
+        std::cerr << name << " (" << triangles << ") " << splitter << " " << operation;
+        if (!workload.empty()) {
+            std::cerr << " " << workload;
+        }
+        std::cerr << " x" << threads << ": " << seconds << " s";
+        if (rays_count > 0) {
+            std::cerr << ", " << rays_count / seconds << (operation.rfind("region", 0) == 0 ? " queries/s" : " rays/s");
+        }
+        std::cerr << std::endl;
+    };
+
+    // every run counts hits, so queries can't be optimized away
+    size_t hits = 0;
+
+    std::vector<rmi::AABBox<float>> boxes;
+    const auto bounds = rmi::get_bounding_box<WebGLMesh>(mesh.begin(), mesh.end());
+    const auto extent = bounds.max - bounds.min;
+    const auto frustum = rmi::Frustum<float>::perspective(
+        bounds.min - extent * 0.1f, extent, rmi::Vector3f(0, 0, 1), 0.3f, 1.5f, 0.1f, extent.length()
+    );
+    if (has_query(options, "region")) {
+        std::mt19937 engine(options.seed);
+        std::uniform_real_distribution<float> unit(0, 1);
+        for (size_t i = 0; i < region_boxes_count; ++i) {
+            const auto center = bounds.min + extent * rmi::Vector3f(unit(engine), unit(engine), unit(engine));
+            boxes.push_back({center - extent * (region_box_size / 2), center + extent * (region_box_size / 2)});
+        }
+    }
+    std::vector<unsigned int> selection;
+
+    for (const auto& splitter_name : options.splitters) {
+        with_splitter(splitter_name, [&](const auto& splitter) {
+            for (int threads : options.threads) {
+                if (threads == 1) {
+                    report(splitter_name, "build", "", 1, measure(options.repeat, [&] {
+                        hits += rmi::KDTree<WebGLMesh>::for_mesh(mesh, splitter).top().is_leaf();
+                    }), 0);
+                }
+#ifdef RMI_INCLUDE_OMP
+                else {
+                    report(splitter_name, "build", "", threads, measure(options.repeat, [&] {
+                        hits += rmi::KDTree<WebGLMesh>::for_mesh(mesh, threads, splitter).top().is_leaf();
+                    }), 0);
+                }
+#endif
+#ifdef RMI_INCLUDE_POOL
+                if (threads > 1) {
+                    report(splitter_name, "pool_build", "", threads, measure(options.repeat, [&] {
+                        hits += rmi::KDTree<WebGLMesh>::pool_for_mesh(mesh, threads, splitter).top().is_leaf();
+                    }), 0);
+                }
+#endif
+            }
+
+            const auto tree = rmi::KDTree<WebGLMesh>::for_mesh(mesh, splitter);
+            if (has_query(options, "region")) {
+                report(splitter_name, "region_box", "", 1, measure(options.repeat, [&] {
+                    selection.clear();
+                    for (const auto& box : boxes) rmi::query_box(tree, box, selection);
+                    hits += selection.size();
+                }), boxes.size());
+                std::cerr << "(" << selection.size() << " triangles in boxes)" << std::endl;
+                report(splitter_name, "region_frustum", "", 1, measure(options.repeat, [&] {
+                    selection.clear();
+                    rmi::query_frustum(tree, frustum, selection);
+                    hits += selection.size();
+                }), 1);
+                std::cerr << "(" << selection.size() << " triangles in frustum)" << std::endl;
+            }
+            for (const auto& [workload, rays] : workloads) {
+                for (const auto& query : options.queries) {
+                    for (int threads : options.threads) {
+                        if (query == "sync" && threads == 1) {
+                            report(splitter_name, query, workload, threads, measure(options.repeat, [&] {
+                                for (const auto& ray : rays) hits += ray.intersects(tree).size();
+                            }), rays.size());
+                        }
+#ifdef RMI_INCLUDE_OMP
+                        if (query == "omp" && threads > 1) {
+                            report(splitter_name, query, workload, threads, measure(options.repeat, [&] {
+                                for (const auto& ray : rays) hits += ray.omp_intersects(tree, threads).size();
+                            }), rays.size());
+                        }
+#endif
+#ifdef RMI_INCLUDE_POOL
+                        if (query == "pool" && threads > 1) {
+                            report(splitter_name, query, workload, threads, measure(options.repeat, [&] {
+                                for (const auto& ray : rays) hits += ray.pool_intersects(tree, threads).size();
+                            }), rays.size());
+                        }
+#endif
+                        if (query == "count" && threads == 1) {
+                            report(splitter_name, query, workload, threads, measure(options.repeat, [&] {
+                                for (const auto& ray : rays) hits += ray.count_intersections(tree).count;
+                            }), rays.size());
+                        }
+                        if (query == "closest") {
+                            std::vector<rmi::Vector3f> points;
+                            for (const auto& ray : rays) points.push_back(ray.origin());
+                            if (threads == 1) {
+                                report(splitter_name, query, workload, threads, measure(options.repeat, [&] {
+                                    hits += rmi::closest_points(tree, points).size();
+                                }), points.size());
+                            }
+#ifdef RMI_INCLUDE_OMP
+                            else {
+                                report(splitter_name, query, workload, threads, measure(options.repeat, [&] {
+                                    hits += rmi::omp_closest_points(tree, points, threads).size();
+                                }), points.size());
+                            }
+#endif
+                        }
+                    }
+                }
+            }
+        });
+    }
+
+    for (const auto& [workload, rays] : workloads) {
+        if (has_query(options, "brute") && static_cast<double>(triangles) * rays.size() <= brute_force_limit) {
+            report("none", "brute", workload, 1, measure(options.repeat, [&] {
+                for (const auto& ray : rays) hits += ray.intersects(mesh).size();
+            }), rays.size());
+        }
+    }
+
+    if (has_query(options, "region") && static_cast<double>(triangles) * boxes.size() <= brute_force_limit) {
+        report("none", "region_scan", "", 1, measure(options.repeat, [&] {
+            selection.clear();
+            for (const auto& box : boxes) {
+                for (const auto& triangle : mesh) {
+                    if (rmi::triangle_overlaps<WebGLMesh>(triangle, box)) selection.push_back(triangle.index);
+                }
+            }
+            hits += selection.size();
+        }), boxes.size());
+    }
+
+    // splitter column tells object splits only tree from spatial splits one
+    if (has_query(options, "spatial")) {
+        const auto kdtree = rmi::KDTree<WebGLMesh>::for_mesh(mesh, rmi::SAHSplitter<WebGLMesh>());
+        const auto object = rmi::SpatialTree<WebGLMesh>::for_mesh(mesh, rmi::SpatialSplitter<WebGLMesh>(4, 0));
+        const auto spatial = rmi::SpatialTree<WebGLMesh>::for_mesh(mesh);
+        std::cerr << name << ": " << spatial.references().size() << " references with spatial splits" << std::endl;
+        for (const auto& [workload, rays] : workloads) {
+            print_work(name + " " + workload + " sah kdtree", kdtree, rays);
+            print_work(name + " " + workload + " object splits", object, rays);
+            print_work(name + " " + workload + " spatial splits", spatial, rays);
+            report("object", "spatial", workload, 1, measure(options.repeat, [&] {
+                for (const auto& ray : rays) hits += ray.intersects(object).size();
+            }), rays.size());
+            report("spatial", "spatial", workload, 1, measure(options.repeat, [&] {
+                for (const auto& ray : rays) hits += ray.intersects(spatial).size();
+            }), rays.size());
+        }
+    }
+
+    std::cerr << "(" << hits << " hits)" << std::endl;
+}
+
+
+std::string escape(const std::string& value) {
+    std::string escaped;
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+void write_json(std::ostream& stream, const std::vector<Result>& results) {
+    stream << "{\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        stream << "    {\"mesh\": \"" << escape(r.mesh) << "\", \"triangles\": " << r.triangles
+               << ", \"splitter\": \"" << r.splitter << "\", \"operation\": \"" << r.operation
+               << "\", \"workload\": \"" << r.workload << "\", \"threads\": " << r.threads << ", \"seconds\": " << r.seconds
+               << ", \"rays\": " << r.rays << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    stream << "  ]\n}\n";
+}
+
+// Reads results written by write_json, every result is a flat object
+std::vector<Result> read_json(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw "Can't open " + path;
+    }
+    std::stringstream content;
+    content << file.rdbuf();
+    const std::string text = content.str();
+
+    const std::regex object(R"(\{[^{}]*\})");
+    const std::regex field(R"xx("(\w+)"\s*:\s*("((?:[^"\\]|\\.)*)"|[-+0-9.eE]+))xx");
+
+    std::vector<Result> results;
+    for (auto it = std::sregex_iterator(text.begin(), text.end(), object); it != std::sregex_iterator(); ++it) {
+        const std::string item = it->str();
+        std::map<std::string, std::string> values;
+        for (auto f = std::sregex_iterator(item.begin(), item.end(), field); f != std::sregex_iterator(); ++f) {
+            values[(*f)[1]] = (*f)[3].matched ? (*f)[3].str() : (*f)[2].str();
+        }
+        if (!values.count("operation")) {
+            continue;
+        }
+        results.push_back({
+            values["mesh"],
+            static_cast<size_t>(std::stod(values["triangles"])),
+            values["splitter"],
+            values["operation"],
+            values["workload"],
+            std::stoi(values["threads"]),
+            std::stod(values["seconds"]),
+            static_cast<size_t>(std::stod(values["rays"]))
+        });
+    }
+    return results;
+}
+
+// Returns count of regressions: operations slower by more than threshold fraction
+int compare(const std::string& baseline_path, const std::string& current_path, double threshold) {
+    auto key = [](const Result& r) {
+        return r.mesh + " (" + std::to_string(r.triangles) + ") " + r.splitter + " " + r.operation
+            + (r.workload.empty() ? "" : " " + r.workload) + " x" + std::to_string(r.threads);
+    };
+
+    std::map<std::string, Result> baseline;
+    for (const auto& result : read_json(baseline_path)) {
+        baseline.emplace(key(result), result);
+    }
+
+    int regressions = 0;
+    for (const auto& current : read_json(current_path)) {
+        const auto it = baseline.find(key(current));
+        if (it == baseline.end() || it->second.seconds <= 0) {
+            std::cout << "NEW        " << key(current) << std::endl;
+            continue;
+        }
+
+        const double ratio = current.seconds / it->second.seconds;
+        const char* status = "ok        ";
+        if (ratio > 1 + threshold) {
+            status = "REGRESSION";
+            ++regressions;
+        } else if (ratio < 1 - threshold) {
+            status = "faster    ";
+        }
+        std::cout << status << " " << key(current) << ": " << it->second.seconds << " s -> "
+                  << current.seconds << " s (" << (ratio - 1) * 100 << "%)" << std::endl;
+    }
+
+    std::cout << regressions << " regression(s) with threshold " << threshold * 100 << "%" << std::endl;
+    return regressions;
+}
+
+
+int main(int argc, char** argv) {
+    try {
+        const auto options = parse_options(argc, argv);
+        if (!options.compare.empty()) {
+            return compare(options.compare[0], options.compare[1], options.threshold) > 0 ? 1 : 0;
+        }
+
+        std::vector<Result> results;
+        for (const auto& name : options.meshes) {
+            for (size_t size : options.sizes) {
+                auto mesh = make_mesh(name, size, options.seed);
+                run_mesh(name, mesh, options, results);
+            }
+        }
+        for (const auto& path : options.files) {
+            auto mesh = read_raw_triangular_mesh<float, unsigned int>(path);
+            run_mesh(path, mesh, options, results);
+        }
+
+        if (options.output.empty()) {
+            write_json(std::cout, results);
+        } else {
+            std::ofstream file(options.output);
+            write_json(file, results);
+        }
+    } catch (const std::string& error) {
+        std::cerr << error << std::endl;
+        return 2;
+    } catch (const char* error) {
+        std::cerr << error << std::endl;
+        return 2;
+    }
+    return 0;
+}
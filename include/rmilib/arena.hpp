@@ -0,0 +1,245 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#    include <sys/mman.h>
+#endif
+
+
+namespace rmi {
+
+struct ArenaOptions {
+    // memory is reserved by blocks of this size, larger allocations get own blocks.
+    // 0 lets the owner size blocks by the expected objects (sized_for), 1 MiB otherwise.
+    size_t block_size = 0;
+    // blocks are advised to be backed by transparent huge pages (Linux only)
+    bool   huge_pages = false;
+
+    // Copy with unset block size fitted to count objects, from 4 KiB to 1 MiB
+    ArenaOptions sized_for(size_t count, size_t object_size) const;
+};
+
+
+/*
+ * Bump allocator for objects living as long as the arena, e.g. nodes of a tree.
+ * Every thread takes memory from its own block, the lock is taken only to get
+ * a new block. Objects are not freed one by one, unless given back by destroy:
+ * their memory is then reused by objects of the same size, e.g. nodes of rebuilt
+ * subtrees. Other destructors are not called, blocks are released with the arena.
+ */
+class Arena {
+public:
+    explicit Arena(ArenaOptions options = {});
+    ~Arena();
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t alignment);
+
+    template<typename U, typename... Args>
+    U* create(Args&&... args);
+
+    // Calls destructor and keeps memory for the next allocation of the same size and alignment
+    template<typename U>
+    void destroy(U* object);
+
+    void deallocate(void* pointer, size_t size, size_t alignment);
+
+    // Memory reserved from the system
+    size_t reserved_bytes() const;
+    // Number of times threads had to take the lock for a new block
+    size_t refills_count() const;
+private:
+    struct Block {
+        char*  data;
+        size_t size;
+        bool   mapped;
+    };
+
+    // Free part of the block of a thread. A thread keeps one cursor, so
+    // switching between arenas in the same thread wastes the rest of blocks.
+    struct Cursor {
+        uint64_t arena_id = 0;
+        char*    current = nullptr;
+        char*    end = nullptr;
+    };
+
+    // Singly linked list of given back chunks, next pointer is kept in the chunk
+    struct FreeList {
+        size_t size;
+        size_t alignment;
+        void*  head;
+    };
+
+    static Cursor& cursor();
+
+    Block reserve(size_t size);
+
+    void* reuse(size_t size, size_t alignment);
+
+    ArenaOptions          options;
+    uint64_t              id;
+    mutable std::mutex    mutex;
+    std::vector<Block>    blocks;
+    size_t                refills = 0;
+    // free lists are locked only when something was given back
+    std::vector<FreeList> free_lists;
+    std::atomic_size_t    free_chunks{0};
+};
+
+
+// Deleter of unique pointers to objects in arena, memory is released by the arena itself
+struct ArenaDeleter {
+    template<typename U>
+    inline void operator()(U*) const noexcept {}
+};
+
+
+inline ArenaOptions ArenaOptions::sized_for(size_t count, size_t object_size) const {
+    ArenaOptions sized = *this;
+    if (sized.block_size == 0) {
+        sized.block_size = std::clamp(count * object_size, size_t(4) << 10, size_t(1) << 20);
+    }
+    return sized;
+}
+
+inline Arena::Arena(ArenaOptions options): options(options) {
+    static std::atomic<uint64_t> next_id(1);
+    id = next_id++;
+    if (this->options.block_size == 0) {
+        this->options.block_size = size_t(1) << 20;
+    }
+}
+
+inline Arena::~Arena() {
+    for (const auto& block : blocks) {
+#ifdef __linux__
+        if (block.mapped) {
+            munmap(block.data, block.size);
+            continue;
+        }
+#endif
+        ::operator delete(block.data);
+    }
+}
+
+inline Arena::Cursor& Arena::cursor() {
+    static thread_local Cursor cursor;
+    return cursor;
+}
+
+inline Arena::Block Arena::reserve(size_t size) {
+#ifdef __linux__
+    constexpr size_t huge_page = size_t(2) << 20;
+    if (options.huge_pages) {
+        size = (size + huge_page - 1) / huge_page * huge_page;
+        void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (data != MAP_FAILED) {
+            madvise(data, size, MADV_HUGEPAGE);
+            return {static_cast<char*>(data), size, true};
+        }
+    }
+#endif
+    return {static_cast<char*>(::operator new(size)), size, false};
+}
+
+inline void* Arena::reuse(size_t size, size_t alignment) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& list : free_lists) {
+        if (list.size == size && list.alignment == alignment && list.head != nullptr) {
+            void* chunk = list.head;
+            std::memcpy(&list.head, chunk, sizeof(void*));
+            --free_chunks;
+            return chunk;
+        }
+    }
+    return nullptr;
+}
+
+inline void* Arena::allocate(size_t size, size_t alignment) {
+    if (free_chunks.load(std::memory_order_relaxed) != 0) {
+        if (void* chunk = reuse(size, alignment)) {
+            return chunk;
+        }
+    }
+
+    auto& local = cursor();
+    if (local.arena_id == id) {
+        const auto address = reinterpret_cast<uintptr_t>(local.current);
+        const auto aligned = reinterpret_cast<char*>((address + alignment - 1) & ~(uintptr_t(alignment) - 1));
+        if (aligned + size <= local.end) {
+            local.current = aligned + size;
+            return aligned;
+        }
+    }
+
+    // alignment of operator new is enough for blocks start, unless over-aligned types are stored
+    const auto block_size = std::max(options.block_size, size + alignment);
+    std::lock_guard<std::mutex> lock(mutex);
+    blocks.push_back(reserve(block_size));
+    ++refills;
+
+    const auto& block = blocks.back();
+    const auto address = reinterpret_cast<uintptr_t>(block.data);
+    const auto aligned = reinterpret_cast<char*>((address + alignment - 1) & ~(uintptr_t(alignment) - 1));
+    local = {id, aligned + size, block.data + block.size};
+    return aligned;
+}
+
+template<typename U, typename... Args>
+inline U* Arena::create(Args&&... args) {
+    return new (allocate(sizeof(U), alignof(U))) U(std::forward<Args>(args)...);
+}
+
+template<typename U>
+inline void Arena::destroy(U* object) {
+    if (object != nullptr) {
+        object->~U();
+        deallocate(object, sizeof(U), alignof(U));
+    }
+}
+
+inline void Arena::deallocate(void* pointer, size_t size, size_t alignment) {
+    // chunks too small to keep the link stay unused until the arena is released
+    if (pointer == nullptr || size < sizeof(void*)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    auto list = std::find_if(free_lists.begin(), free_lists.end(), [size, alignment](const FreeList& list) {
+        return list.size == size && list.alignment == alignment;
+    });
+    if (list == free_lists.end()) {
+        free_lists.push_back({size, alignment, nullptr});
+        list = std::prev(free_lists.end());
+    }
+    std::memcpy(pointer, &list->head, sizeof(void*));
+    list->head = pointer;
+    ++free_chunks;
+}
+
+inline size_t Arena::reserved_bytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t bytes = 0;
+    for (const auto& block : blocks) {
+        bytes += block.size;
+    }
+    return bytes;
+}
+
+inline size_t Arena::refills_count() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return refills;
+}
+
+} // namespace rmi
@@ -0,0 +1,259 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <optional>
+#include <vector>
+#include "rmi.hpp"
+
+
+/*
+ * Nearest point of mesh surface to query points (distance fields, snapping).
+ * Children are visited nearest first and boxes farther than the best point
+ * found so far are skipped, so a query usually visits O(log n) nodes.
+ * Any hierarchy with KDTree-like nodes is accepted (KDTree, DynamicTree, SpatialTree).
+ */
+namespace rmi {
+
+template<typename float_t, typename index_t>
+struct ClosestPoint {
+    Vector3<float_t> point;
+    // index of triangle in wrapped mesh
+    index_t          triangle;
+    float_t          distance;
+};
+
+namespace detail {
+
+template<typename U>
+struct non_deduced {
+    using type = U;
+};
+
+} // namespace detail
+
+
+// Point of triangle nearest to p, vertices are converted to the precision of p
+template<typename T, typename float_t>
+Vector3<float_t> closest_point(const typename Mesh<T>::Element& triangle, const Vector3<float_t>& p);
+
+// std::nullopt if there are no triangles within max_distance from p
+template<typename Tree, typename float_t, typename T = typename Tree::mesh_type>
+std::optional<ClosestPoint<float_t, typename T::index_t>> closest_point(
+    const Tree& tree,
+    const Vector3<float_t>& p,
+    typename detail::non_deduced<float_t>::type max_distance = std::numeric_limits<float_t>::infinity()
+);
+
+template<typename Tree, typename float_t, typename T = typename Tree::mesh_type>
+std::vector<std::optional<ClosestPoint<float_t, typename T::index_t>>> closest_points(
+    const Tree& tree,
+    const std::vector<Vector3<float_t>>& points,
+    typename detail::non_deduced<float_t>::type max_distance = std::numeric_limits<float_t>::infinity()
+);
+
+#ifdef RMI_INCLUDE_OMP
+template<typename Tree, typename float_t, typename T = typename Tree::mesh_type>
+std::vector<std::optional<ClosestPoint<float_t, typename T::index_t>>> omp_closest_points(
+    const Tree& tree,
+    const std::vector<Vector3<float_t>>& points,
+    int threads_count,
+    typename detail::non_deduced<float_t>::type max_distance = std::numeric_limits<float_t>::infinity()
+);
+#endif
+
+#ifdef RMI_INCLUDE_POOL
+template<typename Tree, typename float_t, typename T = typename Tree::mesh_type>
+std::vector<std::optional<ClosestPoint<float_t, typename T::index_t>>> pool_closest_points(
+    const Tree& tree,
+    const std::vector<Vector3<float_t>>& points,
+    int threads_count,
+    typename detail::non_deduced<float_t>::type max_distance = std::numeric_limits<float_t>::infinity()
+);
+#endif
+
+
+namespace detail {
+
+// Queries of one batch task, the result slots are independent
+constexpr size_t closest_point_grain = 256;
+
+template<typename float_t, typename box_float_t>
+inline float_t squared_distance(const AABBox<box_float_t>& box, const Vector3<float_t>& p) {
+    float_t result = 0;
+    for (int axis = 0; axis < 3; ++axis) {
+        const float_t below = static_cast<float_t>(box.min[axis]) - p[axis];
+        const float_t above = p[axis] - static_cast<float_t>(box.max[axis]);
+        const float_t distance = std::max({below, above, float_t(0)});
+        result += distance * distance;
+    }
+    return result;
+}
+
+template<typename T, typename Node, typename float_t>
+void closest_point_search(
+    const Node& node,
+    const Vector3<float_t>& p,
+    std::optional<ClosestPoint<float_t, typename T::index_t>>& best,
+    float_t& best_distance2
+) {
+    if (node.is_leaf()) {
+        for (const auto& triangle : node) {
+            const auto point = closest_point<T>(triangle, p);
+            const auto offset = point - p;
+            const auto distance2 = offset.dot(offset);
+            if (distance2 <= best_distance2) {
+                best_distance2 = distance2;
+                best = ClosestPoint<float_t, typename T::index_t>{point, triangle.index, 0};
+            }
+        }
+        return;
+    }
+
+    const Node* near = &node.left();
+    const Node* far = &node.right();
+    auto near_distance2 = squared_distance(near->box(), p);
+    auto far_distance2 = squared_distance(far->box(), p);
+    if (far_distance2 < near_distance2) {
+        std::swap(near, far);
+        std::swap(near_distance2, far_distance2);
+    }
+
+    if (near_distance2 <= best_distance2) {
+        closest_point_search<T>(*near, p, best, best_distance2);
+    }
+    // best distance may be reduced by the near child
+    if (far_distance2 <= best_distance2) {
+        closest_point_search<T>(*far, p, best, best_distance2);
+    }
+}
+
+} // namespace detail
+
+
+/*
+ * Read for details: Ericson, Real-Time Collision Detection, 5.1.5.
+ * The plane of triangle is split into vertex, edge and face regions by
+ * barycentric coordinates of projection of p.
+ */
+template<typename T, typename float_t>
+Vector3<float_t> closest_point(const typename Mesh<T>::Element& triangle, const Vector3<float_t>& p) {
+    const Vector3<float_t> a(triangle.v1);
+    const Vector3<float_t> b(triangle.v2);
+    const Vector3<float_t> c(triangle.v3);
+
+    const auto ab = b - a;
+    const auto ac = c - a;
+    const auto ap = p - a;
+    const float_t d1 = ab.dot(ap);
+    const float_t d2 = ac.dot(ap);
+    if (d1 <= 0 && d2 <= 0) {
+        return a;
+    }
+
+    const auto bp = p - b;
+    const float_t d3 = ab.dot(bp);
+    const float_t d4 = ac.dot(bp);
+    if (d3 >= 0 && d4 <= d3) {
+        return b;
+    }
+
+    const float_t vc = d1 * d4 - d3 * d2;
+    if (vc <= 0 && d1 >= 0 && d3 <= 0) {
+        return a + ab * (d1 / (d1 - d3));
+    }
+
+    const auto cp = p - c;
+    const float_t d5 = ab.dot(cp);
+    const float_t d6 = ac.dot(cp);
+    if (d6 >= 0 && d5 <= d6) {
+        return c;
+    }
+
+    const float_t vb = d5 * d2 - d1 * d6;
+    if (vb <= 0 && d2 >= 0 && d6 <= 0) {
+        return a + ac * (d2 / (d2 - d6));
+    }
+
+    const float_t va = d3 * d6 - d5 * d4;
+    if (va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0) {
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }
+
+    const float_t sum = va + vb + vc;
+    // degenerate triangle, all regions above failed only due to rounding
+    if (sum == 0) {
+        return a;
+    }
+    return a + ab * (vb / sum) + ac * (vc / sum);
+}
+
+template<typename Tree, typename float_t, typename T>
+std::optional<ClosestPoint<float_t, typename T::index_t>> closest_point(
+    const Tree& tree,
+    const Vector3<float_t>& p,
+    typename detail::non_deduced<float_t>::type max_distance
+) {
+    std::optional<ClosestPoint<float_t, typename T::index_t>> best;
+    float_t best_distance2 = max_distance * max_distance;
+
+    const auto& root = tree.top();
+    if (detail::squared_distance(root.box(), p) <= best_distance2) {
+        detail::closest_point_search<T>(root, p, best, best_distance2);
+    }
+    if (best) {
+        best->distance = std::sqrt(best_distance2);
+    }
+    return best;
+}
+
+template<typename Tree, typename float_t, typename T>
+std::vector<std::optional<ClosestPoint<float_t, typename T::index_t>>> closest_points(
+    const Tree& tree,
+    const std::vector<Vector3<float_t>>& points,
+    typename detail::non_deduced<float_t>::type max_distance
+) {
+    std::vector<std::optional<ClosestPoint<float_t, typename T::index_t>>> result(points.size());
+    for (size_t i = 0; i < points.size(); ++i) {
+        result[i] = closest_point(tree, points[i], max_distance);
+    }
+    return result;
+}
+
+#ifdef RMI_INCLUDE_OMP
+template<typename Tree, typename float_t, typename T>
+std::vector<std::optional<ClosestPoint<float_t, typename T::index_t>>> omp_closest_points(
+    const Tree& tree,
+    const std::vector<Vector3<float_t>>& points,
+    int threads_count,
+    typename detail::non_deduced<float_t>::type max_distance
+) {
+    std::vector<std::optional<ClosestPoint<float_t, typename T::index_t>>> result(points.size());
+
+    // cost of queries differs a lot between near and far points
+    #pragma omp parallel for schedule(dynamic, detail::closest_point_grain) num_threads(threads_count)
+    for (size_t i = 0; i < points.size(); ++i) {
+        result[i] = closest_point(tree, points[i], max_distance);
+    }
+    return result;
+}
+#endif
+
+#ifdef RMI_INCLUDE_POOL
+template<typename Tree, typename float_t, typename T>
+std::vector<std::optional<ClosestPoint<float_t, typename T::index_t>>> pool_closest_points(
+    const Tree& tree,
+    const std::vector<Vector3<float_t>>& points,
+    int threads_count,
+    typename detail::non_deduced<float_t>::type max_distance
+) {
+    std::vector<std::optional<ClosestPoint<float_t, typename T::index_t>>> result(points.size());
+    parallel::pool_for(threads_count, points.size(), detail::closest_point_grain, [&](size_t i) {
+        result[i] = closest_point(tree, points[i], max_distance);
+    });
+    return result;
+}
+#endif
+
+} // namespace rmi
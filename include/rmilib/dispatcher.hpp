@@ -0,0 +1,391 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <istream>
+#include <iterator>
+#include <limits>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "rmi.hpp"
+#include "ray_generator.hpp"
+
+
+/*
+ * Routing of ray queries to the fastest backend: brute force, sequential tree
+ * search, OpenMP or pool. Which one wins depends on mesh size, batch size and
+ * cores, e.g. more threads than cores slow tree queries down. Calibration times
+ * every backend on random rays inside the mesh box and keeps the fastest route
+ * per batch size in a profile, which may be saved and loaded on next start.
+ */
+namespace rmi {
+
+enum class Backend {
+    // Ray::intersects(mesh)
+    Brute,
+    // Ray::intersects(tree)
+    Tree,
+    // Ray::omp_intersects for single rays, rays of batch are split between threads otherwise
+    Omp,
+    // Ray::pool_intersects for single rays, rays of batch are split between threads otherwise
+    Pool
+};
+
+// Throws on unknown name
+Backend backend_from_string(const std::string& name);
+
+const char* to_string(Backend backend);
+
+// True when the backend is compiled in (RMI_INCLUDE_OMP, RMI_INCLUDE_POOL)
+bool is_available(Backend backend);
+
+
+struct Route {
+    Backend backend = Backend::Tree;
+    int     threads = 1;
+};
+
+struct ProfileEntry {
+    // mesh and batch sizes the route was measured for
+    size_t triangles;
+    size_t batch;
+    Route  route;
+    double seconds_per_ray;
+};
+
+class DispatchProfile {
+public:
+    // Replaces an entry measured for the same mesh and batch sizes
+    void add(const ProfileEntry& entry);
+
+    // Route of the entry nearest to the sizes in log scale, mesh size is matched
+    // first. Tree search when there are no entries or the backend is not compiled in.
+    Route route(size_t triangles, size_t batch) const;
+
+    inline const std::vector<ProfileEntry>& entries() const { return m_entries; }
+
+    // One "triangles batch backend threads seconds_per_ray" line per entry
+    void save(std::ostream& out) const;
+
+    // Throws on malformed lines
+    static DispatchProfile load(std::istream& in);
+
+private:
+    std::vector<ProfileEntry> m_entries;
+};
+
+struct CalibrationOptions {
+    std::vector<size_t> batches = {1, 64, 4096};
+    // empty for 2, 4, 8, ... up to hardware concurrency
+    std::vector<int> threads;
+    // rays timed for every candidate route, at least one batch
+    size_t rays = 512;
+    // brute force is not timed when triangles * rays exceeds the limit
+    double brute_force_limit = 5e7;
+    int repeat = 2;
+    unsigned seed = 1;
+};
+
+
+template<typename Tree, typename float_t = typename Tree::mesh_type::float_t>
+class Dispatcher {
+public:
+    using T = typename Tree::mesh_type;
+    using Points = std::vector<Vector3<float_t>>;
+
+    // Mesh and tree must outlive the dispatcher
+    Dispatcher(Mesh<T>& mesh, const Tree& tree, DispatchProfile profile = {});
+
+    // Times every available route for each batch size and adds the fastest ones to the profile
+    void calibrate(const CalibrationOptions& options = {});
+
+    Route route(size_t batch) const;
+
+    Points intersects(const Ray<float_t>& ray) const;
+
+    // Hits of every ray, order of points of one ray may differ between backends
+    std::vector<Points> intersects(const std::vector<Ray<float_t>>& rays) const;
+
+    // Runs the batch by the given route
+    std::vector<Points> intersects(const std::vector<Ray<float_t>>& rays, const Route& route) const;
+
+    inline size_t triangles() const { return m_triangles; }
+    inline const DispatchProfile& profile() const { return m_profile; }
+
+private:
+    Points single(const Ray<float_t>& ray, const Route& route) const;
+
+    Mesh<T>* m_mesh;
+    const Tree* m_tree;
+    size_t m_triangles;
+    DispatchProfile m_profile;
+};
+
+
+namespace detail {
+
+// Rays of one batch task
+constexpr size_t dispatch_grain = 16;
+
+inline double log_distance(size_t a, size_t b) {
+    return std::abs(std::log(static_cast<double>(std::max<size_t>(a, 1))) - std::log(static_cast<double>(std::max<size_t>(b, 1))));
+}
+
+inline std::vector<int> default_threads() {
+    const int cores = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    std::vector<int> threads;
+    for (int count = 2; count <= cores; count *= 2) {
+        threads.push_back(count);
+    }
+    if (cores > 1 && threads.back() != cores) {
+        threads.push_back(cores);
+    }
+    return threads;
+}
+
+} // namespace detail
+
+
+inline Backend backend_from_string(const std::string& name) {
+    for (auto backend : {Backend::Brute, Backend::Tree, Backend::Omp, Backend::Pool}) {
+        if (name == to_string(backend)) {
+            return backend;
+        }
+    }
+    throw "Unknown backend " + name;
+}
+
+inline const char* to_string(Backend backend) {
+    switch (backend) {
+    case Backend::Brute:
+        return "brute";
+    case Backend::Tree:
+        return "tree";
+    case Backend::Omp:
+        return "omp";
+    case Backend::Pool:
+        return "pool";
+    }
+    return "";
+}
+
+inline bool is_available(Backend backend) {
+    switch (backend) {
+    case Backend::Brute:
+    case Backend::Tree:
+        return true;
+    case Backend::Omp:
+#ifdef RMI_INCLUDE_OMP
+        return true;
+#else
+        return false;
+#endif
+    case Backend::Pool:
+#ifdef RMI_INCLUDE_POOL
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+inline void DispatchProfile::add(const ProfileEntry& entry) {
+    for (auto& existing : m_entries) {
+        if (existing.triangles == entry.triangles && existing.batch == entry.batch) {
+            existing = entry;
+            return;
+        }
+    }
+    m_entries.push_back(entry);
+}
+
+inline Route DispatchProfile::route(size_t triangles, size_t batch) const {
+    const ProfileEntry* best = nullptr;
+    for (const auto& entry : m_entries) {
+        if (best == nullptr) {
+            best = &entry;
+            continue;
+        }
+        const auto mesh_distance = detail::log_distance(entry.triangles, triangles);
+        const auto best_mesh_distance = detail::log_distance(best->triangles, triangles);
+        if (mesh_distance < best_mesh_distance ||
+            (mesh_distance == best_mesh_distance &&
+             detail::log_distance(entry.batch, batch) < detail::log_distance(best->batch, batch))) {
+            best = &entry;
+        }
+    }
+    if (best == nullptr || !is_available(best->route.backend)) {
+        return Route{};
+    }
+    return best->route;
+}
+
+inline void DispatchProfile::save(std::ostream& out) const {
+    for (const auto& entry : m_entries) {
+        out << entry.triangles << ' ' << entry.batch << ' ' << to_string(entry.route.backend) << ' '
+            << entry.route.threads << ' ' << entry.seconds_per_ray << '\n';
+    }
+}
+
+inline DispatchProfile DispatchProfile::load(std::istream& in) {
+    DispatchProfile profile;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+        std::istringstream words(line);
+        ProfileEntry entry;
+        std::string backend;
+        if (!(words >> entry.triangles >> entry.batch >> backend >> entry.route.threads >> entry.seconds_per_ray) ||
+            entry.route.threads < 1) {
+            throw "Malformed profile line '" + line + "'";
+        }
+        entry.route.backend = backend_from_string(backend);
+        profile.add(entry);
+    }
+    return profile;
+}
+
+
+template<typename Tree, typename float_t>
+Dispatcher<Tree, float_t>::Dispatcher(Mesh<T>& mesh, const Tree& tree, DispatchProfile profile):
+    m_mesh(&mesh),
+    m_tree(&tree),
+    m_triangles(static_cast<size_t>(std::distance(mesh.begin(), mesh.end()))),
+    m_profile(std::move(profile)) {}
+
+template<typename Tree, typename float_t>
+void Dispatcher<Tree, float_t>::calibrate(const CalibrationOptions& options) {
+    const auto threads = options.threads.empty() ? detail::default_threads() : options.threads;
+    std::vector<Route> candidates = {Route{Backend::Brute, 1}, Route{Backend::Tree, 1}};
+    for (auto backend : {Backend::Omp, Backend::Pool}) {
+        if (!is_available(backend)) {
+            continue;
+        }
+        for (int count : threads) {
+            candidates.push_back(Route{backend, count});
+        }
+    }
+
+    for (const auto batch : options.batches) {
+        if (batch == 0) {
+            continue;
+        }
+        const auto batches = std::max<size_t>(1, options.rays / batch);
+        const auto sample = uniform_rays<float_t>(m_tree->top().box(), batches * batch, options.seed);
+        std::vector<std::vector<Ray<float_t>>> groups;
+        for (size_t i = 0; i < batches; ++i) {
+            groups.emplace_back(sample.begin() + i * batch, sample.begin() + (i + 1) * batch);
+        }
+
+        ProfileEntry best = {m_triangles, batch, Route{}, std::numeric_limits<double>::infinity()};
+        for (const auto& candidate : candidates) {
+            if (candidate.backend == Backend::Brute &&
+                static_cast<double>(m_triangles) * static_cast<double>(sample.size()) > options.brute_force_limit) {
+                continue;
+            }
+            auto seconds = std::numeric_limits<double>::infinity();
+            for (int run = 0; run < std::max(1, options.repeat); ++run) {
+                const auto start = std::chrono::steady_clock::now();
+                for (const auto& group : groups) {
+                    intersects(group, candidate);
+                }
+                const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                seconds = std::min(seconds, elapsed.count());
+            }
+            const auto per_ray = seconds / static_cast<double>(sample.size());
+            if (per_ray < best.seconds_per_ray) {
+                best.route = candidate;
+                best.seconds_per_ray = per_ray;
+            }
+        }
+        m_profile.add(best);
+    }
+}
+
+template<typename Tree, typename float_t>
+Route Dispatcher<Tree, float_t>::route(size_t batch) const {
+    return m_profile.route(m_triangles, batch);
+}
+
+template<typename Tree, typename float_t>
+typename Dispatcher<Tree, float_t>::Points Dispatcher<Tree, float_t>::intersects(const Ray<float_t>& ray) const {
+    return single(ray, route(1));
+}
+
+template<typename Tree, typename float_t>
+std::vector<typename Dispatcher<Tree, float_t>::Points> Dispatcher<Tree, float_t>::intersects(
+    const std::vector<Ray<float_t>>& rays
+) const {
+    return intersects(rays, route(rays.size()));
+}
+
+template<typename Tree, typename float_t>
+std::vector<typename Dispatcher<Tree, float_t>::Points> Dispatcher<Tree, float_t>::intersects(
+    const std::vector<Ray<float_t>>& rays,
+    const Route& route
+) const {
+    std::vector<Points> result(rays.size());
+    if (rays.size() == 1) {
+        result[0] = single(rays[0], route);
+        return result;
+    }
+
+    switch (route.backend) {
+    case Backend::Brute:
+        for (size_t i = 0; i < rays.size(); ++i) {
+            result[i] = rays[i].intersects(*m_mesh);
+        }
+        break;
+#ifdef RMI_INCLUDE_OMP
+    case Backend::Omp:
+        #pragma omp parallel for schedule(dynamic, detail::dispatch_grain) num_threads(route.threads)
+        for (size_t i = 0; i < rays.size(); ++i) {
+            rays[i].intersects(*m_tree, result[i]);
+        }
+        break;
+#endif
+#ifdef RMI_INCLUDE_POOL
+    case Backend::Pool:
+        parallel::pool_for(route.threads, rays.size(), detail::dispatch_grain, [&](size_t i) {
+            rays[i].intersects(*m_tree, result[i]);
+        });
+        break;
+#endif
+    default:
+        for (size_t i = 0; i < rays.size(); ++i) {
+            rays[i].intersects(*m_tree, result[i]);
+        }
+        break;
+    }
+    return result;
+}
+
+template<typename Tree, typename float_t>
+typename Dispatcher<Tree, float_t>::Points Dispatcher<Tree, float_t>::single(
+    const Ray<float_t>& ray,
+    const Route& route
+) const {
+    switch (route.backend) {
+    case Backend::Brute:
+        return ray.intersects(*m_mesh);
+#ifdef RMI_INCLUDE_OMP
+    case Backend::Omp:
+        return ray.omp_intersects(*m_tree, route.threads);
+#endif
+#ifdef RMI_INCLUDE_POOL
+    case Backend::Pool:
+        return ray.pool_intersects(*m_tree, route.threads);
+#endif
+    default:
+        return ray.intersects(*m_tree);
+    }
+}
+
+} // namespace rmi
@@ -0,0 +1,236 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include "rmi.hpp"
+
+
+namespace rmi {
+
+/*
+ * Bounding volume hierarchy with insertion and removal of single triangles.
+ *
+ * Every leaf keeps a copy of one mesh element. New leaf is paired with a sibling
+ * chosen by surface area heuristic, then ancestors are refitted and rotated
+ * to keep the tree compact. Read for details:
+ * Kopta et al. "Fast, Effective BVH Updates for Animated Scenes", 2012
+ *
+ * Nodes have the same interface as KDTree nodes, so all Ray query methods accept the tree.
+ */
+template<typename T>
+class DynamicTree {
+public:
+    using mesh_type = T;
+    using float_t = typename T::float_t;
+    using Element = typename Mesh<T>::Element;
+
+    class Node {
+    public:
+        friend DynamicTree;
+
+        inline bool                   is_leaf() const { return !m_left; }
+        inline const Node&            left()    const { return *m_left; }
+        inline const Node&            right()   const { return *m_right; }
+        inline const AABBox<float_t>& box()     const { return bounding_box; }
+        inline const Element*         begin()   const { return element ? &*element : nullptr; }
+        inline const Element*         end()     const { return element ? &*element + 1 : nullptr; }
+
+        template<typename U>
+        inline bool accepts(const Element&, const Vector3<U>&) const { return true; }
+    private:
+        AABBox<float_t>        bounding_box;
+        std::optional<Element> element;
+
+        Node*                  parent = nullptr;
+        std::unique_ptr<Node>  m_left;
+        std::unique_ptr<Node>  m_right;
+    };
+
+    // Leaf of inserted element, stays valid until element is removed
+    using handle = const Node*;
+
+    static DynamicTree<T> for_mesh(Mesh<T>& mesh);
+
+    handle insert(const Element& element);
+
+    void remove(handle leaf);
+
+    inline size_t size()  const { return m_size; }
+    inline bool   empty() const { return !root; }
+
+    inline const Node& top() const {
+        static const Node empty_node{};
+        return root ? *root : empty_node;
+    }
+private:
+    std::unique_ptr<Node>& owner(Node* node);
+
+    Node* find_sibling(const AABBox<float_t>& box) const;
+
+    void refit(Node* node);
+
+    void rotate(Node* node);
+
+    std::unique_ptr<Node> root;
+    size_t m_size = 0;
+};
+
+
+template<typename T>
+DynamicTree<T> DynamicTree<T>::for_mesh(Mesh<T>& mesh) {
+    DynamicTree<T> tree;
+    for (const auto& element : mesh) {
+        tree.insert(element);
+    }
+    return tree;
+}
+
+template<typename T>
+inline std::unique_ptr<typename DynamicTree<T>::Node>& DynamicTree<T>::owner(Node* node) {
+    if (!node->parent) {
+        return root;
+    }
+    return node->parent->m_left.get() == node ? node->parent->m_left : node->parent->m_right;
+}
+
+/*
+ * Descends while pushing new box down is cheaper than pairing it with current node
+ */
+template<typename T>
+typename DynamicTree<T>::Node* DynamicTree<T>::find_sibling(const AABBox<float_t>& box) const {
+    Node* sibling = root.get();
+
+    while (!sibling->is_leaf()) {
+        const auto area = sibling->box().area();
+        const auto combined_area = (sibling->box() + box).area();
+
+        // cost of creating new parent for sibling and new leaf
+        const auto cost = 2 * combined_area;
+        // increase of ancestors area if leaf is pushed further
+        const auto inheritance = 2 * (combined_area - area);
+
+        auto descend_cost = [&box, inheritance](const Node& child) {
+            const auto enlarged_area = (child.box() + box).area();
+            if (child.is_leaf()) {
+                return enlarged_area + inheritance;
+            }
+            return enlarged_area - child.box().area() + inheritance;
+        };
+
+        const auto left_cost = descend_cost(*sibling->m_left);
+        const auto right_cost = descend_cost(*sibling->m_right);
+
+        if (cost < left_cost && cost < right_cost) {
+            break;
+        }
+        sibling = left_cost < right_cost ? sibling->m_left.get() : sibling->m_right.get();
+    }
+
+    return sibling;
+}
+
+template<typename T>
+typename DynamicTree<T>::handle DynamicTree<T>::insert(const Element& element) {
+    auto leaf = std::make_unique<Node>();
+    leaf->element = element;
+    leaf->bounding_box = get_bounding_box<T>(element);
+    const Node* result = leaf.get();
+
+    ++m_size;
+    if (!root) {
+        root = std::move(leaf);
+        return result;
+    }
+
+    Node* sibling = find_sibling(leaf->box());
+    auto& slot = owner(sibling);
+
+    auto parent = std::make_unique<Node>();
+    parent->parent = sibling->parent;
+    parent->m_left = std::move(slot);
+    parent->m_right = std::move(leaf);
+    parent->m_left->parent = parent.get();
+    parent->m_right->parent = parent.get();
+
+    slot = std::move(parent);
+    refit(slot.get());
+
+    return result;
+}
+
+template<typename T>
+void DynamicTree<T>::remove(handle leaf) {
+    --m_size;
+
+    Node* node = const_cast<Node*>(leaf);
+    if (node == root.get()) {
+        root.reset();
+        return;
+    }
+
+    Node* parent = node->parent;
+    Node* grandparent = parent->parent;
+    auto& sibling = parent->m_left.get() == node ? parent->m_right : parent->m_left;
+
+    sibling->parent = grandparent;
+    // destroys parent together with removed leaf
+    owner(parent) = std::move(sibling);
+
+    refit(grandparent);
+}
+
+template<typename T>
+void DynamicTree<T>::refit(Node* node) {
+    for (; node; node = node->parent) {
+        node->bounding_box = node->m_left->box() + node->m_right->box();
+        rotate(node);
+    }
+}
+
+/*
+ * Swaps one child with grandchild from another side if it decreases
+ * area of the affected child. Box of the node itself stays the same.
+ */
+template<typename T>
+void DynamicTree<T>::rotate(Node* node) {
+    Node* b = node->m_left.get();
+    Node* c = node->m_right.get();
+
+    enum class Rotation { None, BF, BG, CD, CE } rotation = Rotation::None;
+    float_t best_diff = 0;
+
+    auto consider = [&rotation, &best_diff](Rotation candidate, float_t diff) {
+        if (diff < best_diff) {
+            best_diff = diff;
+            rotation = candidate;
+        }
+    };
+
+    if (!c->is_leaf()) {
+        const auto area = c->box().area();
+        consider(Rotation::BF, (b->box() + c->m_right->box()).area() - area);
+        consider(Rotation::BG, (c->m_left->box() + b->box()).area() - area);
+    }
+    if (!b->is_leaf()) {
+        const auto area = b->box().area();
+        consider(Rotation::CD, (c->box() + b->m_right->box()).area() - area);
+        consider(Rotation::CE, (b->m_left->box() + c->box()).area() - area);
+    }
+
+    auto swap = [node](std::unique_ptr<Node>& child, Node* other, std::unique_ptr<Node>& grandchild) {
+        std::swap(child, grandchild);
+        child->parent = node;
+        grandchild->parent = other;
+        other->bounding_box = other->m_left->box() + other->m_right->box();
+    };
+
+    switch (rotation) {
+    case Rotation::None: break;
+    case Rotation::BF: swap(node->m_left,  c, c->m_left);  break;
+    case Rotation::BG: swap(node->m_left,  c, c->m_right); break;
+    case Rotation::CD: swap(node->m_right, b, b->m_left);  break;
+    case Rotation::CE: swap(node->m_right, b, b->m_right); break;
+    }
+}
+
+} // namespace rmi
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "raw_mesh.hpp"
+
+
+/*
+ * Procedural meshes for benchmarks and tests. Triangles count of the result
+ * is close to the requested one, but not always equal to it.
+ * All generated meshes fit into [-1, 1] cube.
+ */
+
+// UV sphere of unit radius
+template<typename float_t, typename index_t>
+RawMesh<float_t, index_t> generate_sphere_mesh(size_t triangles_count);
+
+// Height field over [-1, 1] square with several octaves of value noise
+template<typename float_t, typename index_t>
+RawMesh<float_t, index_t> generate_terrain_mesh(size_t triangles_count, unsigned seed);
+
+// Independent random triangles with size proportional to mean distance between them
+template<typename float_t, typename index_t>
+RawMesh<float_t, index_t> generate_soup_mesh(size_t triangles_count, unsigned seed);
+
+// CAD-like set of long thin cylinders tessellated without intermediate rings,
+// every side triangle spans the whole cylinder length
+template<typename float_t, typename index_t>
+RawMesh<float_t, index_t> generate_slivers_mesh(size_t triangles_count, unsigned seed);
+
+
+template<typename float_t, typename index_t>
+RawMesh<float_t, index_t> generate_sphere_mesh(size_t triangles_count) {
+    // 2 * slices * (stacks - 1) triangles, poles are shared vertices
+    const size_t stacks = std::max<size_t>(2, static_cast<size_t>(std::sqrt(triangles_count / 4.0)));
+    const size_t slices = std::max<size_t>(3, triangles_count / (2 * (stacks - 1)));
+    const double pi = std::acos(-1.0);
+
+    std::vector<float_t> coords;
+    std::vector<index_t> indices;
+    coords.reserve(3 * (slices * (stacks - 1) + 2));
+    indices.reserve(6 * slices * (stacks - 1));
+
+    coords.insert(coords.end(), {0, 0, 1});
+    for (size_t i = 1; i < stacks; ++i) {
+        const double theta = pi * i / stacks;
+        for (size_t j = 0; j < slices; ++j) {
+            const double phi = 2 * pi * j / slices;
+            coords.push_back(static_cast<float_t>(std::sin(theta) * std::cos(phi)));
+            coords.push_back(static_cast<float_t>(std::sin(theta) * std::sin(phi)));
+            coords.push_back(static_cast<float_t>(std::cos(theta)));
+        }
+    }
+    coords.insert(coords.end(), {0, 0, -1});
+
+    const auto ring = [slices](size_t i, size_t j) {
+        return static_cast<index_t>(1 + (i - 1) * slices + j % slices);
+    };
+    const auto south = static_cast<index_t>(1 + (stacks - 1) * slices);
+
+    for (size_t j = 0; j < slices; ++j) {
+        indices.insert(indices.end(), {0, ring(1, j), ring(1, j + 1)});
+    }
+    for (size_t i = 1; i + 1 < stacks; ++i) {
+        for (size_t j = 0; j < slices; ++j) {
+            indices.insert(indices.end(), {ring(i, j), ring(i + 1, j), ring(i + 1, j + 1)});
+            indices.insert(indices.end(), {ring(i, j), ring(i + 1, j + 1), ring(i, j + 1)});
+        }
+    }
+    for (size_t j = 0; j < slices; ++j) {
+        indices.insert(indices.end(), {ring(stacks - 1, j + 1), ring(stacks - 1, j), south});
+    }
+
+    return RawMesh<float_t, index_t>(std::move(coords), std::move(indices));
+}
+
+template<typename float_t, typename index_t>
+RawMesh<float_t, index_t> generate_terrain_mesh(size_t triangles_count, unsigned seed) {
+    const size_t size = std::max<size_t>(1, static_cast<size_t>(std::sqrt(triangles_count / 2.0)));
+
+    // random values in lattice nodes
+    auto lattice = [seed](int64_t x, int64_t y) {
+        uint64_t h = static_cast<uint64_t>(x) * 0x9E3779B97F4A7C15ull ^ static_cast<uint64_t>(y) * 0xC2B2AE3D27D4EB4Full ^ seed;
+        h ^= h >> 31;
+        h *= 0xBF58476D1CE4E5B9ull;
+        h ^= h >> 29;
+        return static_cast<double>(h >> 11) / static_cast<double>(1ull << 53) * 2 - 1;
+    };
+    auto noise = [&lattice](double x, double y) {
+        const auto ix = static_cast<int64_t>(std::floor(x));
+        const auto iy = static_cast<int64_t>(std::floor(y));
+        const double fx = x - ix, fy = y - iy;
+        const double sx = fx * fx * (3 - 2 * fx), sy = fy * fy * (3 - 2 * fy);
+        const double top = lattice(ix, iy) + (lattice(ix + 1, iy) - lattice(ix, iy)) * sx;
+        const double bottom = lattice(ix, iy + 1) + (lattice(ix + 1, iy + 1) - lattice(ix, iy + 1)) * sx;
+        return top + (bottom - top) * sy;
+    };
+
+    std::vector<float_t> coords;
+    std::vector<index_t> indices;
+    coords.reserve(3 * (size + 1) * (size + 1));
+    indices.reserve(6 * size * size);
+
+    for (size_t i = 0; i <= size; ++i) {
+        for (size_t j = 0; j <= size; ++j) {
+            const double x = 2.0 * i / size - 1;
+            const double y = 2.0 * j / size - 1;
+            double height = 0, amplitude = 0.25, frequency = 2;
+            for (int octave = 0; octave < 6; ++octave) {
+                height += amplitude * noise(x * frequency, y * frequency);
+                amplitude /= 2;
+                frequency *= 2;
+            }
+            coords.push_back(static_cast<float_t>(x));
+            coords.push_back(static_cast<float_t>(y));
+            coords.push_back(static_cast<float_t>(height));
+        }
+    }
+    for (size_t i = 0; i < size; ++i) {
+        for (size_t j = 0; j < size; ++j) {
+            const auto v = static_cast<index_t>(i * (size + 1) + j);
+            const auto row = static_cast<index_t>(size + 1);
+            indices.insert(indices.end(), {v, static_cast<index_t>(v + 1), static_cast<index_t>(v + row)});
+            indices.insert(indices.end(), {static_cast<index_t>(v + 1), static_cast<index_t>(v + row + 1), static_cast<index_t>(v + row)});
+        }
+    }
+
+    return RawMesh<float_t, index_t>(std::move(coords), std::move(indices));
+}
+
+template<typename float_t, typename index_t>
+RawMesh<float_t, index_t> generate_soup_mesh(size_t triangles_count, unsigned seed) {
+    std::mt19937 engine(seed);
+    // at most half of the cube, so the range of centers is never empty
+    const double spacing = std::min(1.0, 2 / std::cbrt(static_cast<double>(std::max<size_t>(triangles_count, 1))));
+    std::uniform_real_distribution<double> position(-1 + spacing, 1 - spacing);
+    std::uniform_real_distribution<double> offset(-spacing, spacing);
+
+    std::vector<float_t> coords;
+    std::vector<index_t> indices;
+    coords.reserve(9 * triangles_count);
+    indices.reserve(3 * triangles_count);
+
+    for (size_t i = 0; i < triangles_count; ++i) {
+        const double center[3] = {position(engine), position(engine), position(engine)};
+        for (size_t j = 0; j < 3; ++j) {
+            for (int axis = 0; axis < 3; ++axis) {
+                coords.push_back(static_cast<float_t>(center[axis] + offset(engine)));
+            }
+            indices.push_back(static_cast<index_t>(3 * i + j));
+        }
+    }
+
+    return RawMesh<float_t, index_t>(std::move(coords), std::move(indices));
+}
+
+template<typename float_t, typename index_t>
+RawMesh<float_t, index_t> generate_slivers_mesh(size_t triangles_count, unsigned seed) {
+    constexpr size_t segments = 16;
+    const size_t cylinders = std::max<size_t>(1, triangles_count / (2 * segments));
+    const double pi = std::acos(-1.0);
+
+    std::mt19937 engine(seed);
+    std::uniform_real_distribution<double> position(-0.9, 0.9);
+    std::uniform_real_distribution<double> unit(-1, 1);
+    const double radius = 0.5 / std::cbrt(static_cast<double>(cylinders)) * 0.1;
+
+    std::vector<float_t> coords;
+    std::vector<index_t> indices;
+    coords.reserve(3 * 2 * segments * cylinders);
+    indices.reserve(6 * segments * cylinders);
+
+    for (size_t c = 0; c < cylinders; ++c) {
+        // long axis from a to b, clamped to the cube
+        double a[3], b[3], axis[3];
+        for (int k = 0; k < 3; ++k) {
+            a[k] = position(engine);
+            b[k] = std::clamp(a[k] + unit(engine), -0.9, 0.9);
+            axis[k] = b[k] - a[k];
+        }
+        const double length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]) + 1e-12;
+        for (double& value : axis) value /= length;
+
+        // orthonormal basis u, v perpendicular to axis
+        double u[3] = {axis[1], -axis[0], 0};
+        if (std::abs(axis[2]) > 0.9) {
+            u[0] = 0; u[1] = axis[2]; u[2] = -axis[1];
+        }
+        const double u_length = std::sqrt(u[0] * u[0] + u[1] * u[1] + u[2] * u[2]);
+        for (double& value : u) value /= u_length;
+        const double v[3] = {
+            axis[1] * u[2] - axis[2] * u[1],
+            axis[2] * u[0] - axis[0] * u[2],
+            axis[0] * u[1] - axis[1] * u[0]
+        };
+
+        const auto first = static_cast<index_t>(coords.size() / 3);
+        for (size_t s = 0; s < segments; ++s) {
+            const double phi = 2 * pi * s / segments;
+            for (const double* end : {a, b}) {
+                for (int k = 0; k < 3; ++k) {
+                    coords.push_back(static_cast<float_t>(
+                        end[k] + radius * (std::cos(phi) * u[k] + std::sin(phi) * v[k])
+                    ));
+                }
+            }
+        }
+        for (size_t s = 0; s < segments; ++s) {
+            const auto p = static_cast<index_t>(first + 2 * s);
+            const auto q = static_cast<index_t>(first + 2 * ((s + 1) % segments));
+            indices.insert(indices.end(), {p, static_cast<index_t>(p + 1), q});
+            indices.insert(indices.end(), {static_cast<index_t>(p + 1), static_cast<index_t>(q + 1), q});
+        }
+    }
+
+    return RawMesh<float_t, index_t>(std::move(coords), std::move(indices));
+}
@@ -0,0 +1,509 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "rmi.hpp"
+
+
+/*
+ * Intersection of two meshes (clash detection) by simultaneous traversal of
+ * their trees. Pairs of nodes with disjoint boxes are skipped, the node with
+ * larger box of a pair is split first, triangles of leaf pairs are tested
+ * by the interval overlap method.
+ */
+namespace rmi {
+
+template<typename first_index_t, typename second_index_t, typename contact_float_t>
+struct TriangleContact {
+    using float_t = contact_float_t;
+
+    // indices of triangles in wrapped meshes
+    first_index_t  first;
+    second_index_t second;
+    // segment where the triangles cross, set only if segments are requested;
+    // coplanar and zero-area triangles get a single common point
+    Vector3<float_t> from;
+    Vector3<float_t> to;
+};
+
+template<typename TreeA, typename TreeB>
+using contact_type = TriangleContact<
+    typename TreeA::mesh_type::index_t,
+    typename TreeB::mesh_type::index_t,
+    std::common_type_t<typename TreeA::mesh_type::float_t, typename TreeB::mesh_type::float_t>
+>;
+
+// Triangles of two meshes, that touch or cross each other. Trees must reference
+// every triangle once (KDTree, DynamicTree), otherwise pairs may be repeated.
+template<typename TreeA, typename TreeB>
+std::vector<contact_type<TreeA, TreeB>> mesh_intersections(
+    const TreeA& first,
+    const TreeB& second,
+    bool segments = false
+);
+
+#ifdef RMI_INCLUDE_POOL
+// Pairs of large nodes are given to pool threads, the order of contacts is not defined
+template<typename TreeA, typename TreeB>
+std::vector<contact_type<TreeA, TreeB>> pool_mesh_intersections(
+    const TreeA& first,
+    const TreeB& second,
+    int threads_count,
+    bool segments = false
+);
+#endif
+
+// from and to are set to the ends of the common segment when triangles intersect.
+// A zero-area triangle is tested as its longest edge, two of them never intersect.
+template<typename float_t>
+bool triangles_intersect(
+    const std::array<Vector3<float_t>, 3>& a,
+    const std::array<Vector3<float_t>, 3>& b,
+    Vector3<float_t>& from,
+    Vector3<float_t>& to
+);
+
+
+namespace detail {
+
+// Pairs of nodes deeper than this are traversed by one pool task
+constexpr int parallel_contacts_depth = 12;
+
+// Plane distances below this share of normal length times triangles size are
+// taken as zero (the epsilon of Moller's test), triangles with normal shorter
+// than this share of squared longest edge are degenerate
+template<typename float_t>
+constexpr float_t plane_epsilon = 64 * std::numeric_limits<float_t>::epsilon();
+
+template<typename float_t, typename U, typename V>
+inline bool boxes_touch(const AABBox<U>& a, const AABBox<V>& b) {
+    for (int axis = 0; axis < 3; ++axis) {
+        if (static_cast<float_t>(a.min[axis]) > static_cast<float_t>(b.max[axis]) ||
+            static_cast<float_t>(b.min[axis]) > static_cast<float_t>(a.max[axis])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Points of triangle lying in plane, distances are signed distances of vertices
+template<typename float_t>
+size_t plane_section(
+    const std::array<Vector3<float_t>, 3>& triangle,
+    const std::array<float_t, 3>& distances,
+    std::array<Vector3<float_t>, 3>& points
+) {
+    size_t count = 0;
+    for (int i = 0; i < 3; ++i) {
+        const int j = (i + 1) % 3;
+        if (distances[i] == 0) {
+            points[count++] = triangle[i];
+        } else if ((distances[i] < 0 && distances[j] > 0) || (distances[i] > 0 && distances[j] < 0)) {
+            const auto t = distances[i] / (distances[i] - distances[j]);
+            points[count++] = triangle[i] + (triangle[j] - triangle[i]) * t;
+        }
+    }
+    return count;
+}
+
+template<typename float_t>
+inline float_t orient_2d(const std::array<float_t, 2>& a, const std::array<float_t, 2>& b, const std::array<float_t, 2>& c) {
+    return (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+}
+
+template<typename float_t>
+bool point_in_triangle_2d(const std::array<float_t, 2>& p, const std::array<std::array<float_t, 2>, 3>& t) {
+    const auto d1 = orient_2d(t[0], t[1], p);
+    const auto d2 = orient_2d(t[1], t[2], p);
+    const auto d3 = orient_2d(t[2], t[0], p);
+    const bool negative = d1 < 0 || d2 < 0 || d3 < 0;
+    const bool positive = d1 > 0 || d2 > 0 || d3 > 0;
+    return !(negative && positive);
+}
+
+// Common point of segments ab and cd is written as parameter t along ab
+template<typename float_t>
+bool segments_intersect_2d(
+    const std::array<float_t, 2>& a, const std::array<float_t, 2>& b,
+    const std::array<float_t, 2>& c, const std::array<float_t, 2>& d,
+    float_t& t
+) {
+    const auto d1 = orient_2d(c, d, a), d2 = orient_2d(c, d, b);
+    const auto d3 = orient_2d(a, b, c), d4 = orient_2d(a, b, d);
+    if (((d1 > 0 && d2 < 0) || (d1 < 0 && d2 > 0)) && ((d3 > 0 && d4 < 0) || (d3 < 0 && d4 > 0))) {
+        // a and b are on different sides of cd at distances proportional to d1 and d2
+        t = d1 / (d1 - d2);
+        return true;
+    }
+    // collinear touching
+    auto on_segment = [](const auto& p, const auto& q, const auto& r) {
+        return std::min(p[0], q[0]) <= r[0] && r[0] <= std::max(p[0], q[0]) &&
+               std::min(p[1], q[1]) <= r[1] && r[1] <= std::max(p[1], q[1]);
+    };
+    // parameter of point r on the line of ab
+    auto project = [&a, &b](const auto& r) {
+        const float_t dx = b[0] - a[0], dy = b[1] - a[1];
+        const float_t length = dx * dx + dy * dy;
+        return length > 0 ? ((r[0] - a[0]) * dx + (r[1] - a[1]) * dy) / length : float_t(0);
+    };
+    if (d1 == 0 && on_segment(c, d, a)) {
+        t = 0;
+    } else if (d2 == 0 && on_segment(c, d, b)) {
+        t = 1;
+    } else if (d3 == 0 && on_segment(a, b, c)) {
+        t = project(c);
+    } else if (d4 == 0 && on_segment(a, b, d)) {
+        t = project(d);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Axes of the coordinate plane, where projections of the plane with given normal have largest area
+template<typename float_t>
+std::pair<int, int> projection_axes(const Vector3<float_t>& normal) {
+    const std::array<float_t, 3> n = {std::abs(normal.x()), std::abs(normal.y()), std::abs(normal.z())};
+    const int drop = n[0] > n[1] ? (n[0] > n[2] ? 0 : 2) : (n[1] > n[2] ? 1 : 2);
+    return std::make_pair((drop + 1) % 3, (drop + 2) % 3);
+}
+
+// Vertices of the longest edge and its squared length
+template<typename float_t>
+std::pair<std::pair<int, int>, float_t> longest_edge(const std::array<Vector3<float_t>, 3>& triangle) {
+    std::pair<int, int> edge = {0, 1};
+    float_t longest = 0;
+    for (int i = 0; i < 3; ++i) {
+        const auto edge_vector = triangle[(i + 1) % 3] - triangle[i];
+        const auto length = edge_vector.dot(edge_vector);
+        if (length > longest) {
+            longest = length;
+            edge = {i, (i + 1) % 3};
+        }
+    }
+    return std::make_pair(edge, longest);
+}
+
+template<typename float_t>
+inline float_t snap_to_plane(float_t distance, float_t tolerance) {
+    return std::abs(distance) <= tolerance ? 0 : distance;
+}
+
+// Segment pq and triangle with nonzero normal, common point is written to point.
+// Segment lying in the plane of triangle gets its first point inside the triangle.
+template<typename float_t>
+bool segment_triangle_intersect(
+    const Vector3<float_t>& p,
+    const Vector3<float_t>& q,
+    const std::array<Vector3<float_t>, 3>& triangle,
+    const Vector3<float_t>& normal,
+    float_t tolerance,
+    Vector3<float_t>& point
+) {
+    const auto dp = snap_to_plane(normal.dot(p - triangle[0]), tolerance);
+    const auto dq = snap_to_plane(normal.dot(q - triangle[0]), tolerance);
+    if ((dp > 0 && dq > 0) || (dp < 0 && dq < 0)) {
+        return false;
+    }
+
+    const auto [u, v] = projection_axes(normal);
+    std::array<std::array<float_t, 2>, 3> t2;
+    for (int i = 0; i < 3; ++i) {
+        t2[i] = {triangle[i][u], triangle[i][v]};
+    }
+
+    if (dp != 0 || dq != 0) {
+        point = p + (q - p) * (dp / (dp - dq));
+        return point_in_triangle_2d<float_t>({point[u], point[v]}, t2);
+    }
+
+    const std::array<float_t, 2> p2 = {p[u], p[v]}, q2 = {q[u], q[v]};
+    if (point_in_triangle_2d(p2, t2)) {
+        point = p;
+        return true;
+    }
+    for (int i = 0; i < 3; ++i) {
+        float_t t;
+        if (segments_intersect_2d(p2, q2, t2[i], t2[(i + 1) % 3], t)) {
+            point = p + (q - p) * t;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Triangles in the same plane with given normal, common point is written to point
+template<typename float_t>
+bool coplanar_triangles_intersect(
+    const std::array<Vector3<float_t>, 3>& a,
+    const std::array<Vector3<float_t>, 3>& b,
+    const Vector3<float_t>& normal,
+    Vector3<float_t>& point
+) {
+    // projection to the coordinate plane, where triangles have largest area
+    const auto [u, v] = projection_axes(normal);
+
+    std::array<std::array<float_t, 2>, 3> a2, b2;
+    for (int i = 0; i < 3; ++i) {
+        a2[i] = {a[i][u], a[i][v]};
+        b2[i] = {b[i][u], b[i][v]};
+    }
+
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            float_t t;
+            if (segments_intersect_2d(a2[i], a2[(i + 1) % 3], b2[j], b2[(j + 1) % 3], t)) {
+                // crossing is lifted back to the edge of a, which lies in the common plane
+                point = a[i] + (a[(i + 1) % 3] - a[i]) * t;
+                return true;
+            }
+        }
+    }
+    if (point_in_triangle_2d(a2[0], b2)) {
+        point = a[0];
+        return true;
+    }
+    if (point_in_triangle_2d(b2[0], a2)) {
+        point = b[0];
+        return true;
+    }
+    return false;
+}
+
+template<typename Contact, typename NodeA, typename NodeB>
+void leaf_contacts(const NodeA& a, const NodeB& b, bool segments, std::vector<Contact>& output) {
+    using float_t = typename Contact::float_t;
+    using Triangle = std::array<Vector3<float_t>, 3>;
+
+    for (const auto& x : a) {
+        const Triangle first = {Vector3<float_t>(x.v1), Vector3<float_t>(x.v2), Vector3<float_t>(x.v3)};
+        const AABBox<float_t> first_box = {
+            Vector3<float_t>(
+                std::min({first[0].x(), first[1].x(), first[2].x()}),
+                std::min({first[0].y(), first[1].y(), first[2].y()}),
+                std::min({first[0].z(), first[1].z(), first[2].z()})
+            ),
+            Vector3<float_t>(
+                std::max({first[0].x(), first[1].x(), first[2].x()}),
+                std::max({first[0].y(), first[1].y(), first[2].y()}),
+                std::max({first[0].z(), first[1].z(), first[2].z()})
+            )
+        };
+        if (!boxes_touch<float_t>(first_box, b.box())) {
+            continue;
+        }
+
+        for (const auto& y : b) {
+            const Triangle second = {Vector3<float_t>(y.v1), Vector3<float_t>(y.v2), Vector3<float_t>(y.v3)};
+            Vector3<float_t> from, to;
+            if (triangles_intersect(first, second, from, to)) {
+                output.push_back({x.index, y.index, segments ? from : Vector3<float_t>(), segments ? to : Vector3<float_t>()});
+            }
+        }
+    }
+}
+
+template<typename NodeA, typename NodeB>
+inline bool split_first(const NodeA& a, const NodeB& b) {
+    if (a.is_leaf() || b.is_leaf()) {
+        return !a.is_leaf();
+    }
+    return a.box().area() >= b.box().area();
+}
+
+template<typename Contact, typename NodeA, typename NodeB>
+void recursive_contacts(const NodeA& a, const NodeB& b, bool segments, std::vector<Contact>& output) {
+    using float_t = typename Contact::float_t;
+    if (!boxes_touch<float_t>(a.box(), b.box())) {
+        return;
+    }
+    if (a.is_leaf() && b.is_leaf()) {
+        leaf_contacts(a, b, segments, output);
+    } else if (split_first(a, b)) {
+        recursive_contacts(a.left(), b, segments, output);
+        recursive_contacts(a.right(), b, segments, output);
+    } else {
+        recursive_contacts(a, b.left(), segments, output);
+        recursive_contacts(a, b.right(), segments, output);
+    }
+}
+
+#ifdef RMI_INCLUDE_POOL
+template<typename Contact, typename NodeA, typename NodeB>
+void pool_contacts(
+    parallel::TaskPool& pool,
+    int thread_id,
+    const NodeA& a,
+    const NodeB& b,
+    int depth,
+    bool segments,
+    std::vector<std::vector<Contact>>& outputs
+) {
+    using float_t = typename Contact::float_t;
+    if (depth >= parallel_contacts_depth || (a.is_leaf() && b.is_leaf())) {
+        recursive_contacts(a, b, segments, outputs[thread_id]);
+        return;
+    }
+    if (!boxes_touch<float_t>(a.box(), b.box())) {
+        return;
+    }
+
+    // the second pair may be stolen, the first one is traversed by this thread
+    if (split_first(a, b)) {
+        pool.spawn(thread_id, [&pool, &a, &b, depth, segments, &outputs](int thread_id) {
+            pool_contacts(pool, thread_id, a.right(), b, depth + 1, segments, outputs);
+        });
+        pool_contacts(pool, thread_id, a.left(), b, depth + 1, segments, outputs);
+    } else {
+        pool.spawn(thread_id, [&pool, &a, &b, depth, segments, &outputs](int thread_id) {
+            pool_contacts(pool, thread_id, a, b.right(), depth + 1, segments, outputs);
+        });
+        pool_contacts(pool, thread_id, a, b.left(), depth + 1, segments, outputs);
+    }
+}
+#endif
+
+} // namespace detail
+
+
+/*
+ * Read for details: Moller, A Fast Triangle-Triangle Intersection Test.
+ * Both triangles are cut by the plane of the other one, the cuts lie on the
+ * line of planes intersection and triangles intersect if the cuts overlap.
+ */
+template<typename float_t>
+bool triangles_intersect(
+    const std::array<Vector3<float_t>, 3>& a,
+    const std::array<Vector3<float_t>, 3>& b,
+    Vector3<float_t>& from,
+    Vector3<float_t>& to
+) {
+    const auto a_normal = (a[1] - a[0]).cross(a[2] - a[0]);
+    const auto b_normal = (b[1] - b[0]).cross(b[2] - b[0]);
+    const auto [a_edge, a_longest] = detail::longest_edge(a);
+    const auto [b_edge, b_longest] = detail::longest_edge(b);
+    const auto epsilon = detail::plane_epsilon<float_t>;
+    const bool a_degenerate = a_normal.length() <= epsilon * a_longest;
+    const bool b_degenerate = b_normal.length() <= epsilon * b_longest;
+    const auto size = std::sqrt(std::max(a_longest, b_longest));
+
+    // zero-area triangle is its longest edge, which is tested against the other triangle
+    if (a_degenerate && b_degenerate) {
+        return false;
+    }
+    if (a_degenerate || b_degenerate) {
+        const auto& segment = a_degenerate ? a : b;
+        const auto& edge = a_degenerate ? a_edge : b_edge;
+        const auto& normal = a_degenerate ? b_normal : a_normal;
+        if (!detail::segment_triangle_intersect(
+            segment[edge.first], segment[edge.second], a_degenerate ? b : a, normal, epsilon * normal.length() * size, from
+        )) {
+            return false;
+        }
+        to = from;
+        return true;
+    }
+
+    const auto b_tolerance = epsilon * b_normal.length() * size;
+    const std::array<float_t, 3> a_distances = {
+        detail::snap_to_plane(b_normal.dot(a[0] - b[0]), b_tolerance),
+        detail::snap_to_plane(b_normal.dot(a[1] - b[0]), b_tolerance),
+        detail::snap_to_plane(b_normal.dot(a[2] - b[0]), b_tolerance)
+    };
+    if ((a_distances[0] > 0 && a_distances[1] > 0 && a_distances[2] > 0) ||
+        (a_distances[0] < 0 && a_distances[1] < 0 && a_distances[2] < 0)) {
+        return false;
+    }
+
+    const auto a_tolerance = epsilon * a_normal.length() * size;
+    const std::array<float_t, 3> b_distances = {
+        detail::snap_to_plane(a_normal.dot(b[0] - a[0]), a_tolerance),
+        detail::snap_to_plane(a_normal.dot(b[1] - a[0]), a_tolerance),
+        detail::snap_to_plane(a_normal.dot(b[2] - a[0]), a_tolerance)
+    };
+    if ((b_distances[0] > 0 && b_distances[1] > 0 && b_distances[2] > 0) ||
+        (b_distances[0] < 0 && b_distances[1] < 0 && b_distances[2] < 0)) {
+        return false;
+    }
+
+    if (a_distances[0] == 0 && a_distances[1] == 0 && a_distances[2] == 0) {
+        if (!detail::coplanar_triangles_intersect(a, b, b_normal, from)) {
+            return false;
+        }
+        to = from;
+        return true;
+    }
+
+    std::array<Vector3<float_t>, 3> a_points, b_points;
+    const auto a_count = detail::plane_section(a, a_distances, a_points);
+    const auto b_count = detail::plane_section(b, b_distances, b_points);
+    if (a_count == 0 || b_count == 0) {
+        return false;
+    }
+
+    // cuts are compared by projections to the line of planes intersection
+    const auto direction = a_normal.cross(b_normal);
+    auto range = [&direction](const std::array<Vector3<float_t>, 3>& points, size_t count) {
+        size_t min = 0, max = 0;
+        for (size_t i = 1; i < count; ++i) {
+            if (direction.dot(points[i]) < direction.dot(points[min])) min = i;
+            if (direction.dot(points[i]) > direction.dot(points[max])) max = i;
+        }
+        return std::make_pair(min, max);
+    };
+    const auto [a_min, a_max] = range(a_points, a_count);
+    const auto [b_min, b_max] = range(b_points, b_count);
+
+    const auto& start = direction.dot(a_points[a_min]) > direction.dot(b_points[b_min]) ? a_points[a_min] : b_points[b_min];
+    const auto& end = direction.dot(a_points[a_max]) < direction.dot(b_points[b_max]) ? a_points[a_max] : b_points[b_max];
+    if (direction.dot(start) > direction.dot(end)) {
+        return false;
+    }
+    from = start;
+    to = end;
+    return true;
+}
+
+template<typename TreeA, typename TreeB>
+std::vector<contact_type<TreeA, TreeB>> mesh_intersections(
+    const TreeA& first,
+    const TreeB& second,
+    bool segments
+) {
+    std::vector<contact_type<TreeA, TreeB>> output;
+    detail::recursive_contacts(first.top(), second.top(), segments, output);
+    return output;
+}
+
+#ifdef RMI_INCLUDE_POOL
+template<typename TreeA, typename TreeB>
+std::vector<contact_type<TreeA, TreeB>> pool_mesh_intersections(
+    const TreeA& first,
+    const TreeB& second,
+    int threads_count,
+    bool segments
+) {
+    using Contact = contact_type<TreeA, TreeB>;
+    threads_count = std::max(1, threads_count);
+
+    // every thread appends to its own vector
+    std::vector<std::vector<Contact>> outputs(threads_count);
+    parallel::TaskPool pool(threads_count);
+    pool.run([&](int thread_id) {
+        detail::pool_contacts(pool, thread_id, first.top(), second.top(), 0, segments, outputs);
+    });
+
+    std::vector<Contact> output;
+    for (auto& part : outputs) {
+        output.insert(output.end(), part.begin(), part.end());
+    }
+    return output;
+}
+#endif
+
+} // namespace rmi
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#ifdef __linux__
+#    include <linux/perf_event.h>
+#    include <sys/ioctl.h>
+#    include <sys/syscall.h>
+#    include <unistd.h>
+#endif
+
+
+namespace rmi {
+
+// Counter values, empty when the event is not supported or not permitted
+struct PerfSample {
+    std::optional<uint64_t> cycles;
+    std::optional<uint64_t> instructions;
+    std::optional<uint64_t> l1d_misses;
+    std::optional<uint64_t> llc_misses;
+    std::optional<uint64_t> branch_misses;
+
+    std::optional<double> ipc() const;
+
+    // One line of all values divided by count (e.g. per ray), "n/a" for empty ones
+    std::string to_string(size_t count = 1) const;
+};
+
+
+/*
+ * Hardware performance counters of calling thread and threads it creates later
+ * (values of a thread are added when it exits, so persistent OMP workers are not counted).
+ *
+ * Uses Linux perf_event_open. Every event is opened separately, so unsupported
+ * ones (e.g. in virtual machines or containers with perf_event_paranoid > 2)
+ * are just left empty. On other systems nothing is available.
+ */
+class PerfCounters {
+public:
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    // Whether at least one event is counted
+    bool available() const;
+
+    void start();
+
+    // Values since the last start()
+    PerfSample stop();
+private:
+    static constexpr size_t events_count = 5;
+
+    std::array<int, events_count> descriptors;
+};
+
+
+inline std::optional<double> PerfSample::ipc() const {
+    if (!cycles || !instructions || *cycles == 0) {
+        return std::nullopt;
+    }
+    return static_cast<double>(*instructions) / *cycles;
+}
+
+inline std::string PerfSample::to_string(size_t count) const {
+    auto per = [count](const std::optional<uint64_t>& value) {
+        if (!value) {
+            return std::string("n/a");
+        }
+        return count == 1 ? std::to_string(*value) : std::to_string(static_cast<double>(*value) / count);
+    };
+    return per(cycles) + " cycles, "
+        + per(instructions) + " instructions, "
+        + "IPC " + (ipc() ? std::to_string(*ipc()) : std::string("n/a")) + ", "
+        + per(l1d_misses) + " L1D misses, "
+        + per(llc_misses) + " LLC misses, "
+        + per(branch_misses) + " branch misses";
+}
+
+#ifdef __linux__
+
+inline PerfCounters::PerfCounters() {
+    constexpr uint64_t l1d_read_miss = PERF_COUNT_HW_CACHE_L1D
+        | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+        | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+
+    const std::array<std::pair<uint32_t, uint64_t>, events_count> events = {{
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HW_CACHE, l1d_read_miss},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    }};
+
+    for (size_t i = 0; i < events_count; ++i) {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = events[i].first;
+        attr.config = events[i].second;
+        attr.disabled = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        descriptors[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+}
+
+inline PerfCounters::~PerfCounters() {
+    for (int fd : descriptors) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+inline bool PerfCounters::available() const {
+    for (int fd : descriptors) {
+        if (fd >= 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline void PerfCounters::start() {
+    for (int fd : descriptors) {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+inline PerfSample PerfCounters::stop() {
+    std::array<std::optional<uint64_t>, events_count> values;
+    for (size_t i = 0; i < events_count; ++i) {
+        if (descriptors[i] < 0) {
+            continue;
+        }
+        ioctl(descriptors[i], PERF_EVENT_IOC_DISABLE, 0);
+
+        uint64_t value;
+        if (read(descriptors[i], &value, sizeof(value)) == sizeof(value)) {
+            values[i] = value;
+        }
+    }
+    return {values[0], values[1], values[2], values[3], values[4]};
+}
+
+#else
+
+inline PerfCounters::PerfCounters() {
+    descriptors.fill(-1);
+}
+
+inline PerfCounters::~PerfCounters() {
+}
+
+inline bool PerfCounters::available() const {
+    return false;
+}
+
+inline void PerfCounters::start() {
+}
+
+inline PerfSample PerfCounters::stop() {
+    return {};
+}
+
+#endif
+
+} // namespace rmi
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "rmi.hpp"
+
+
+/*
+ * Inside / outside classification of points by parity of ray crossings.
+ * The mesh must be closed, otherwise the parity depends on the direction.
+ * Rays passing near edges or vertices, where a crossing may be counted twice
+ * or missed, are cast again in other directions.
+ */
+namespace rmi {
+
+template<typename Tree, typename float_t, typename T = typename Tree::mesh_type>
+bool is_inside(const Tree& tree, const Vector3<float_t>& p);
+
+// 1 for points inside the mesh, 0 for the rest
+template<typename Tree, typename float_t, typename T = typename Tree::mesh_type>
+std::vector<uint8_t> classify_points(const Tree& tree, const std::vector<Vector3<float_t>>& points);
+
+#ifdef RMI_INCLUDE_OMP
+template<typename Tree, typename float_t, typename T = typename Tree::mesh_type>
+std::vector<uint8_t> omp_classify_points(
+    const Tree& tree,
+    const std::vector<Vector3<float_t>>& points,
+    int threads_count
+);
+#endif
+
+#ifdef RMI_INCLUDE_POOL
+template<typename Tree, typename float_t, typename T = typename Tree::mesh_type>
+std::vector<uint8_t> pool_classify_points(
+    const Tree& tree,
+    const std::vector<Vector3<float_t>>& points,
+    int threads_count
+);
+#endif
+
+
+namespace detail {
+
+// Queries of one batch task
+constexpr size_t classify_grain = 256;
+
+// Directions with irrational ratios of coordinates, so rays don't go
+// along edges and faces of axis-aligned meshes
+template<typename float_t>
+const std::array<Vector3<float_t>, 5>& probe_directions() {
+    static const std::array<Vector3<float_t>, 5> directions = {
+        Vector3<float_t>(1, 1.618034, 2.718282),
+        Vector3<float_t>(-2.236068, 1, 1.414214),
+        Vector3<float_t>(1.732051, -2.645751, -1),
+        Vector3<float_t>(-1, -3.141593, 1.202057),
+        Vector3<float_t>(0.577216, 1.324718, -2.502908)
+    };
+    return directions;
+}
+
+} // namespace detail
+
+
+template<typename Tree, typename float_t, typename T>
+bool is_inside(const Tree& tree, const Vector3<float_t>& p) {
+    // rays go towards the nearest sides of the mesh box, so fewer nodes are crossed
+    const auto& box = tree.top().box();
+    float_t signs[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        signs[axis] = p[axis] - static_cast<float_t>(box.min[axis]) < static_cast<float_t>(box.max[axis]) - p[axis] ? -1 : 1;
+    }
+
+    int inside_votes = 0, votes = 0;
+    for (const auto& probe : detail::probe_directions<float_t>()) {
+        const Vector3<float_t> direction(
+            signs[0] * std::abs(probe.x()),
+            signs[1] * std::abs(probe.y()),
+            signs[2] * std::abs(probe.z())
+        );
+        const auto crossings = Ray<float_t>(p, direction).count_intersections(tree);
+        if (!crossings.degenerate) {
+            return crossings.odd();
+        }
+        inside_votes += crossings.odd();
+        ++votes;
+    }
+    // every ray passed near edges, majority decides
+    return 2 * inside_votes > votes;
+}
+
+template<typename Tree, typename float_t, typename T>
+std::vector<uint8_t> classify_points(const Tree& tree, const std::vector<Vector3<float_t>>& points) {
+    std::vector<uint8_t> result(points.size());
+    for (size_t i = 0; i < points.size(); ++i) {
+        result[i] = is_inside(tree, points[i]);
+    }
+    return result;
+}
+
+#ifdef RMI_INCLUDE_OMP
+template<typename Tree, typename float_t, typename T>
+std::vector<uint8_t> omp_classify_points(
+    const Tree& tree,
+    const std::vector<Vector3<float_t>>& points,
+    int threads_count
+) {
+    std::vector<uint8_t> result(points.size());
+
+    #pragma omp parallel for schedule(dynamic, detail::classify_grain) num_threads(threads_count)
+    for (size_t i = 0; i < points.size(); ++i) {
+        result[i] = is_inside(tree, points[i]);
+    }
+    return result;
+}
+#endif
+
+#ifdef RMI_INCLUDE_POOL
+template<typename Tree, typename float_t, typename T>
+std::vector<uint8_t> pool_classify_points(
+    const Tree& tree,
+    const std::vector<Vector3<float_t>>& points,
+    int threads_count
+) {
+    std::vector<uint8_t> result(points.size());
+    parallel::pool_for(threads_count, points.size(), detail::classify_grain, [&](size_t i) {
+        result[i] = is_inside(tree, points[i]);
+    });
+    return result;
+}
+#endif
+
+} // namespace rmi
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include <array>
+#include <type_traits>
+#include "rmi.hpp"
+
+
+namespace rmi {
+
+/*
+ * Compressed copy of a built KDTree.
+ *
+ * Nodes are stored in a flat depth-first array, the left child follows its parent.
+ * Instead of own box every node keeps boxes of both children quantized to
+ * quant_t relative to its own (decoded) box. Bounds are rounded outward,
+ * so decoded boxes always contain the original ones and traversal stays conservative.
+ */
+template<typename T, typename quant_t = uint8_t>
+class QuantizedKDTree {
+public:
+    static_assert(std::is_unsigned_v<quant_t>, "quant_t must be unsigned integer type");
+
+    using float_t = typename T::float_t;
+    using mesh_iterator = typename T::iterator;
+
+    struct Node {
+        static constexpr uint32_t internal = std::numeric_limits<uint32_t>::max();
+
+        inline bool is_leaf() const { return count != internal; }
+
+        // min and max of left child box followed by min and max of right one
+        std::array<quant_t, 12> children;
+        // index of right child for internal node, offset of first element for leaf
+        uint32_t first;
+        // elements count for leaf
+        uint32_t count;
+    };
+
+    static QuantizedKDTree from_tree(const KDTree<T>& tree);
+
+    template<typename ray_float_t>
+    std::vector<Vector3<ray_float_t>> intersects(
+        const Ray<ray_float_t>& ray,
+        ray_float_t epsilon = std::numeric_limits<ray_float_t>::epsilon()
+    ) const;
+
+    inline const AABBox<float_t>&    box()          const { return root_box; }
+    inline const std::vector<Node>&  nodes()        const { return m_nodes; }
+    inline size_t                    memory_usage() const { return m_nodes.size() * sizeof(Node); }
+private:
+    QuantizedKDTree(AABBox<float_t> root_box, mesh_iterator base): root_box(root_box), base(base) {}
+
+    static float_t decode(quant_t value, float_t min, float_t max);
+    static quant_t quantize_down(float_t value, float_t min, float_t max);
+    static quant_t quantize_up(float_t value, float_t min, float_t max);
+
+    static AABBox<float_t> decode(const quant_t* bounds, const AABBox<float_t>& parent);
+    static void            quantize(quant_t* bounds, const AABBox<float_t>& box, const AABBox<float_t>& parent);
+
+    uint32_t flatten(const typename KDTree<T>::Node& node, const AABBox<float_t>& box);
+
+    template<typename ray_float_t>
+    void recursive_intersects(
+        const Ray<ray_float_t>& ray,
+        uint32_t index,
+        const AABBox<float_t>& box,
+        std::vector<Vector3<ray_float_t>>& output,
+        ray_float_t epsilon
+    ) const;
+
+    static constexpr quant_t steps = std::numeric_limits<quant_t>::max();
+
+    AABBox<float_t>   root_box;
+    mesh_iterator     base;
+    std::vector<Node> m_nodes;
+};
+
+
+template<typename T, typename quant_t>
+inline typename T::float_t QuantizedKDTree<T, quant_t>::decode(
+    quant_t value,
+    float_t min,
+    float_t max
+) {
+    if (value == steps) {
+        return max;
+    }
+    return min + (max - min) * (static_cast<float_t>(value) / steps);
+}
+
+template<typename T, typename quant_t>
+quant_t QuantizedKDTree<T, quant_t>::quantize_down(float_t value, float_t min, float_t max) {
+    if (max <= min) {
+        return 0;
+    }
+    const float_t scaled = std::floor((value - min) / (max - min) * steps);
+    quant_t result = static_cast<quant_t>(std::clamp<float_t>(scaled, 0, steps));
+    while (result > 0 && decode(result, min, max) > value) {
+        --result;
+    }
+    return result;
+}
+
+template<typename T, typename quant_t>
+quant_t QuantizedKDTree<T, quant_t>::quantize_up(float_t value, float_t min, float_t max) {
+    if (max <= min) {
+        return steps;
+    }
+    const float_t scaled = std::ceil((value - min) / (max - min) * steps);
+    quant_t result = static_cast<quant_t>(std::clamp<float_t>(scaled, 0, steps));
+    while (result < steps && decode(result, min, max) < value) {
+        ++result;
+    }
+    return result;
+}
+
+template<typename T, typename quant_t>
+inline AABBox<typename T::float_t> QuantizedKDTree<T, quant_t>::decode(
+    const quant_t* bounds,
+    const AABBox<float_t>& parent
+) {
+    return {
+        Vector3<float_t>(
+            decode(bounds[0], parent.min.x(), parent.max.x()),
+            decode(bounds[1], parent.min.y(), parent.max.y()),
+            decode(bounds[2], parent.min.z(), parent.max.z())
+        ),
+        Vector3<float_t>(
+            decode(bounds[3], parent.min.x(), parent.max.x()),
+            decode(bounds[4], parent.min.y(), parent.max.y()),
+            decode(bounds[5], parent.min.z(), parent.max.z())
+        )
+    };
+}
+
+template<typename T, typename quant_t>
+void QuantizedKDTree<T, quant_t>::quantize(
+    quant_t* bounds,
+    const AABBox<float_t>& box,
+    const AABBox<float_t>& parent
+) {
+    for (int axis = 0; axis < 3; ++axis) {
+        bounds[axis]     = quantize_down(box.min[axis], parent.min[axis], parent.max[axis]);
+        bounds[axis + 3] = quantize_up(box.max[axis], parent.min[axis], parent.max[axis]);
+    }
+}
+
+
+template<typename T, typename quant_t>
+QuantizedKDTree<T, quant_t> QuantizedKDTree<T, quant_t>::from_tree(const KDTree<T>& tree) {
+    const auto& root = tree.top();
+
+    QuantizedKDTree<T, quant_t> result(root.box(), root.begin());
+    result.flatten(root, root.box());
+    return result;
+}
+
+template<typename T, typename quant_t>
+uint32_t QuantizedKDTree<T, quant_t>::flatten(
+    const typename KDTree<T>::Node& node,
+    const AABBox<float_t>& box
+) {
+    const auto index = static_cast<uint32_t>(m_nodes.size());
+    m_nodes.emplace_back();
+
+    if (node.is_leaf()) {
+        m_nodes[index].first = static_cast<uint32_t>(std::distance(base, node.begin()));
+        m_nodes[index].count = static_cast<uint32_t>(std::distance(node.begin(), node.end()));
+        return index;
+    }
+
+    std::array<quant_t, 12> children;
+    quantize(children.data(),     node.left().box(),  box);
+    quantize(children.data() + 6, node.right().box(), box);
+
+    m_nodes[index].children = children;
+    m_nodes[index].count = Node::internal;
+
+    // children are decoded from quantized values, so descendants are encoded
+    // relative to exactly the same boxes traversal will see
+    flatten(node.left(), decode(children.data(), box));
+    const auto right = flatten(node.right(), decode(children.data() + 6, box));
+    m_nodes[index].first = right;
+
+    return index;
+}
+
+
+template<typename T, typename quant_t>
+template<typename ray_float_t>
+void QuantizedKDTree<T, quant_t>::recursive_intersects(
+    const Ray<ray_float_t>& ray,
+    uint32_t index,
+    const AABBox<float_t>& box,
+    std::vector<Vector3<ray_float_t>>& output,
+    ray_float_t epsilon
+) const {
+    const Node& node = m_nodes[index];
+
+    if (node.is_leaf()) {
+        const auto begin = std::next(base, node.first);
+        const auto end = std::next(begin, node.count);
+        for (auto it = begin; it != end; ++it) {
+            if (auto intersection = ray.template intersects<T>(*it, epsilon); intersection) {
+                output.push_back(std::move(*intersection));
+            }
+        }
+    } else {
+        const auto left_box = decode(node.children.data(), box);
+        if (ray.is_intersects(left_box)) {
+            recursive_intersects(ray, index + 1, left_box, output, epsilon);
+        }
+        const auto right_box = decode(node.children.data() + 6, box);
+        if (ray.is_intersects(right_box)) {
+            recursive_intersects(ray, node.first, right_box, output, epsilon);
+        }
+    }
+}
+
+template<typename T, typename quant_t>
+template<typename ray_float_t>
+std::vector<Vector3<ray_float_t>> QuantizedKDTree<T, quant_t>::intersects(
+    const Ray<ray_float_t>& ray,
+    ray_float_t epsilon
+) const {
+    if (m_nodes.empty() || !ray.is_intersects(root_box)) {
+        return {};
+    }
+
+    std::vector<Vector3<ray_float_t>> output;
+    recursive_intersects(ray, 0, root_box, output, epsilon);
+    return output;
+}
+
+} // namespace rmi
@@ -34,6 +34,11 @@ public:
         return m_vertices;
     }
 
+    // vertices may be moved in place, tree should be refitted after that
+    std::vector<float_t>& vertices() {
+        return m_vertices;
+    }
+
     const std::vector<index_t>& indices() const {
         return m_indices;
     }
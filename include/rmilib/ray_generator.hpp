@@ -0,0 +1,317 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+#include "rmi.hpp"
+
+
+/*
+ * Reproducible ray workloads for benchmarks and batch queries. Coherent ones
+ * (camera, scanlines) have neighbouring rays visiting the same nodes, incoherent
+ * ones (secondary, segments, uniform) jump over the whole tree.
+ */
+namespace rmi {
+
+enum class Workload {
+    // pinhole camera grid looking at the mesh from outside
+    Camera,
+    // rays from random surface points along cosine-distributed directions around normal
+    Secondary,
+    // segments between two random surface points (visibility queries)
+    Segments,
+    // parallel rays along one axis through a jittered grid
+    Scanlines,
+    // random origins and directions inside the mesh box
+    Uniform
+};
+
+// Throws on unknown name
+Workload workload_from_string(const std::string& name);
+
+
+template<typename float_t>
+struct Segment {
+    // ray limited by the target point
+    Ray<float_t> ray;
+    // distance from ray origin to the target point
+    float_t      length;
+};
+
+
+// Image of width x height pixels, camera position on the sphere around box is chosen by seed
+template<typename float_t, typename box_float_t>
+std::vector<Ray<float_t>> camera_rays(
+    const AABBox<box_float_t>& box,
+    size_t width,
+    size_t height,
+    unsigned seed,
+    float_t fov = 0.8
+);
+
+// Throws on empty mesh
+template<typename float_t, typename T>
+std::vector<Ray<float_t>> secondary_rays(Mesh<T>& mesh, size_t count, unsigned seed);
+
+// Throws if surface points of the mesh can't be joined by segments (empty mesh,
+// all triangles in one point)
+template<typename float_t, typename T>
+std::vector<Segment<float_t>> segment_rays(Mesh<T>& mesh, size_t count, unsigned seed);
+
+// rows x columns grid on the box face perpendicular to axis (0 - x, 1 - y, 2 - z)
+template<typename float_t, typename box_float_t>
+std::vector<Ray<float_t>> scanline_rays(
+    const AABBox<box_float_t>& box,
+    int axis,
+    size_t rows,
+    size_t columns,
+    unsigned seed
+);
+
+template<typename float_t, typename box_float_t>
+std::vector<Ray<float_t>> uniform_rays(const AABBox<box_float_t>& box, size_t count, unsigned seed);
+
+// About count rays of any workload (camera and scanlines round it to a square grid)
+template<typename float_t, typename T>
+std::vector<Ray<float_t>> generate_rays(Workload workload, Mesh<T>& mesh, size_t count, unsigned seed);
+
+
+namespace detail {
+
+// Pairs of surface points closer than twice the offset are drawn again. After
+// this many such pairs in a row the offset is halved, at most max_offset_halvings times.
+constexpr int segment_attempts = 64;
+constexpr int max_offset_halvings = 32;
+
+template<typename float_t>
+Vector3<float_t> random_direction(std::mt19937& engine) {
+    std::normal_distribution<float_t> normal;
+    Vector3<float_t> direction;
+    do {
+        direction = Vector3<float_t>(normal(engine), normal(engine), normal(engine));
+    } while (direction.length() < std::numeric_limits<float_t>::epsilon());
+    return direction.ort();
+}
+
+// Uniformly distributed point of triangle and its unit normal
+template<typename float_t, typename T>
+std::pair<Vector3<float_t>, Vector3<float_t>> random_surface_point(Mesh<T>& mesh, std::mt19937& engine) {
+    const auto size = std::distance(mesh.begin(), mesh.end());
+    if (size == 0) {
+        throw std::string("Can't pick surface points of empty mesh");
+    }
+    std::uniform_int_distribution<decltype(size)> index(0, size - 1);
+    std::uniform_real_distribution<float_t> unit(0, 1);
+
+    const auto& triangle = *std::next(mesh.begin(), index(engine));
+    const Vector3<float_t> v1(triangle.v1), v2(triangle.v2), v3(triangle.v3);
+
+    float_t u = unit(engine), v = unit(engine);
+    if (u + v > 1) {
+        u = 1 - u;
+        v = 1 - v;
+    }
+    const auto normal = (v2 - v1).cross(v3 - v1);
+    return {
+        v1 + (v2 - v1) * u + (v3 - v1) * v,
+        normal.length() > 0 ? normal.ort() : Vector3<float_t>(0, 0, 1)
+    };
+}
+
+// Offset of ray origins from surface, so rays don't hit their own triangle
+template<typename float_t, typename T>
+float_t surface_offset(Mesh<T>& mesh) {
+    const auto box = get_bounding_box<T>(mesh.begin(), mesh.end());
+    return static_cast<float_t>(Vector3<float_t>(box.max - box.min).length()) * static_cast<float_t>(1e-4);
+}
+
+} // namespace detail
+
+
+inline Workload workload_from_string(const std::string& name) {
+    if (name == "camera") {
+        return Workload::Camera;
+    } else if (name == "secondary") {
+        return Workload::Secondary;
+    } else if (name == "segments") {
+        return Workload::Segments;
+    } else if (name == "scanlines") {
+        return Workload::Scanlines;
+    } else if (name == "uniform") {
+        return Workload::Uniform;
+    }
+    throw "Unknown workload " + name;
+}
+
+template<typename float_t, typename box_float_t>
+std::vector<Ray<float_t>> camera_rays(
+    const AABBox<box_float_t>& box,
+    size_t width,
+    size_t height,
+    unsigned seed,
+    float_t fov
+) {
+    std::mt19937 engine(seed);
+    const Vector3<float_t> min(box.min), max(box.max);
+    const auto center = (min + max) / 2;
+    const float_t radius = (max - min).length() / 2;
+
+    // distance at which the bounding sphere fills the field of view
+    const auto forward = detail::random_direction<float_t>(engine) * -1;
+    const auto eye = center - forward * (radius / std::tan(fov / 2));
+
+    const auto helper = std::abs(forward.z()) < 0.9 ? Vector3<float_t>(0, 0, 1) : Vector3<float_t>(1, 0, 0);
+    const auto right = forward.cross(helper).ort();
+    const auto up = right.cross(forward);
+
+    const float_t half_height = std::tan(fov / 2);
+    const float_t half_width = half_height * width / std::max<size_t>(height, 1);
+
+    std::vector<Ray<float_t>> rays;
+    rays.reserve(width * height);
+    for (size_t y = 0; y < height; ++y) {
+        for (size_t x = 0; x < width; ++x) {
+            const float_t sx = ((x + float_t(0.5)) / width * 2 - 1) * half_width;
+            const float_t sy = (1 - (y + float_t(0.5)) / height * 2) * half_height;
+            rays.emplace_back(eye, forward + right * sx + up * sy);
+        }
+    }
+    return rays;
+}
+
+template<typename float_t, typename T>
+std::vector<Ray<float_t>> secondary_rays(Mesh<T>& mesh, size_t count, unsigned seed) {
+    std::mt19937 engine(seed);
+    const auto offset = detail::surface_offset<float_t>(mesh);
+
+    std::vector<Ray<float_t>> rays;
+    rays.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        const auto [point, normal] = detail::random_surface_point<float_t>(mesh, engine);
+        // both sides of the surface
+        const auto side = engine() % 2 ? normal : normal * -1;
+        // cosine-weighted direction around normal
+        auto direction = side + detail::random_direction<float_t>(engine);
+        if (direction.length() < std::numeric_limits<float_t>::epsilon()) {
+            direction = side;
+        }
+        rays.emplace_back(point + side * offset, direction);
+    }
+    return rays;
+}
+
+template<typename float_t, typename T>
+std::vector<Segment<float_t>> segment_rays(Mesh<T>& mesh, size_t count, unsigned seed) {
+    std::mt19937 engine(seed);
+    auto offset = detail::surface_offset<float_t>(mesh);
+
+    std::vector<Segment<float_t>> segments;
+    segments.reserve(count);
+    int failures = 0, halvings = 0;
+    while (segments.size() < count) {
+        const auto from = detail::random_surface_point<float_t>(mesh, engine).first;
+        const auto to = detail::random_surface_point<float_t>(mesh, engine).first;
+        const auto length = (to - from).length();
+        if (length <= 2 * offset) {
+            // surface is too small for the offset, e.g. a single tiny or degenerate triangle
+            if (++failures == detail::segment_attempts) {
+                if (halvings++ == detail::max_offset_halvings) {
+                    throw std::string("Surface points of mesh are too close for segments");
+                }
+                offset /= 2;
+                failures = 0;
+            }
+            continue;
+        }
+        failures = 0;
+        const Ray<float_t> ray(from, to - from);
+        segments.push_back({Ray<float_t>(ray.at(offset), to - from, 0, length - 2 * offset), length - 2 * offset});
+    }
+    return segments;
+}
+
+template<typename float_t, typename box_float_t>
+std::vector<Ray<float_t>> scanline_rays(
+    const AABBox<box_float_t>& box,
+    int axis,
+    size_t rows,
+    size_t columns,
+    unsigned seed
+) {
+    std::mt19937 engine(seed);
+    std::uniform_real_distribution<float_t> jitter(0, 1);
+
+    const Vector3<float_t> min(box.min), max(box.max);
+    const auto extent = max - min;
+    const int u_axis = (axis + 1) % 3;
+    const int v_axis = (axis + 2) % 3;
+
+    std::vector<Ray<float_t>> rays;
+    rays.reserve(rows * columns);
+    for (size_t row = 0; row < rows; ++row) {
+        for (size_t column = 0; column < columns; ++column) {
+            std::array<float_t, 3> origin;
+            origin[axis] = min[axis] - (extent[axis] + 1) * float_t(0.01);
+            origin[u_axis] = min[u_axis] + extent[u_axis] * (row + jitter(engine)) / rows;
+            origin[v_axis] = min[v_axis] + extent[v_axis] * (column + jitter(engine)) / columns;
+
+            std::array<float_t, 3> direction = {0, 0, 0};
+            direction[axis] = 1;
+            rays.emplace_back(
+                Vector3<float_t>(origin[0], origin[1], origin[2]),
+                Vector3<float_t>(direction[0], direction[1], direction[2])
+            );
+        }
+    }
+    return rays;
+}
+
+template<typename float_t, typename box_float_t>
+std::vector<Ray<float_t>> uniform_rays(const AABBox<box_float_t>& box, size_t count, unsigned seed) {
+    std::mt19937 engine(seed);
+    std::uniform_real_distribution<float_t> unit(0, 1);
+    const Vector3<float_t> min(box.min), max(box.max);
+    const auto extent = max - min;
+
+    std::vector<Ray<float_t>> rays;
+    rays.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        const Vector3<float_t> origin(
+            min.x() + extent.x() * unit(engine),
+            min.y() + extent.y() * unit(engine),
+            min.z() + extent.z() * unit(engine)
+        );
+        rays.emplace_back(origin, detail::random_direction<float_t>(engine));
+    }
+    return rays;
+}
+
+template<typename float_t, typename T>
+std::vector<Ray<float_t>> generate_rays(Workload workload, Mesh<T>& mesh, size_t count, unsigned seed) {
+    const auto box = get_bounding_box<T>(mesh.begin(), mesh.end());
+    const auto side = std::max<size_t>(1, static_cast<size_t>(std::sqrt(static_cast<double>(count))));
+
+    switch (workload) {
+    case Workload::Camera:
+        return camera_rays<float_t>(box, side, side, seed);
+    case Workload::Secondary:
+        return secondary_rays<float_t>(mesh, count, seed);
+    case Workload::Segments: {
+        std::vector<Ray<float_t>> rays;
+        for (const auto& segment : segment_rays<float_t>(mesh, count, seed)) {
+            rays.push_back(segment.ray);
+        }
+        return rays;
+    }
+    case Workload::Scanlines:
+        return scanline_rays<float_t>(box, static_cast<int>(seed % 3), side, side, seed);
+    case Workload::Uniform:
+        return uniform_rays<float_t>(box, count, seed);
+    }
+    return {};
+}
+
+} // namespace rmi
@@ -0,0 +1,333 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <type_traits>
+#include <vector>
+#include "rmi.hpp"
+
+
+/*
+ * Triangles overlapping a box or a view frustum. Nodes outside of the region
+ * are skipped, nodes inside of it are reported without tests, triangles of
+ * other leaves are tested exactly. Trees must reference every triangle once
+ * (KDTree, DynamicTree), otherwise triangles may be reported several times.
+ */
+namespace rmi {
+
+// Points with non-negative distance are on the inner side
+template<typename float_t>
+struct Plane {
+    Vector3<float_t> normal;
+    float_t          offset;
+
+    inline float_t distance(const Vector3<float_t>& point) const { return normal.dot(point) + offset; }
+};
+
+template<typename float_t>
+struct Frustum {
+    // near, far, left, right, bottom, top
+    std::array<Plane<float_t>, 6> planes;
+
+    // fov_y and aspect (width / height) as in perspective projection matrices
+    static Frustum perspective(
+        const Vector3<float_t>& eye,
+        const Vector3<float_t>& forward,
+        const Vector3<float_t>& up,
+        float_t fov_y,
+        float_t aspect,
+        float_t near,
+        float_t far
+    );
+};
+
+enum class Overlap {
+    Outside,
+    Intersects,
+    Inside
+};
+
+
+// Exact separating axis test
+template<typename T, typename float_t>
+bool triangle_overlaps(const typename Mesh<T>::Element& triangle, const AABBox<float_t>& box);
+
+// Exact test by clipping of triangle with frustum planes
+template<typename T, typename float_t>
+bool triangle_overlaps(const typename Mesh<T>::Element& triangle, const Frustum<float_t>& frustum);
+
+template<typename float_t, typename box_float_t>
+Overlap box_overlap(const AABBox<box_float_t>& node_box, const AABBox<float_t>& box);
+
+template<typename float_t, typename box_float_t>
+Overlap box_overlap(const AABBox<box_float_t>& node_box, const Frustum<float_t>& frustum);
+
+
+// Visitor is called with every overlapping Mesh<T>::Element
+template<
+    typename Tree, typename float_t, typename Visitor, typename T = typename Tree::mesh_type,
+    typename = std::enable_if_t<std::is_invocable_v<Visitor&, const typename Mesh<T>::Element&>>
+>
+void query_box(const Tree& tree, const AABBox<float_t>& box, Visitor&& visitor);
+
+// Appends indices of overlapping triangles to output
+template<typename Tree, typename float_t, typename T = typename Tree::mesh_type>
+void query_box(const Tree& tree, const AABBox<float_t>& box, std::vector<typename T::index_t>& output);
+
+template<
+    typename Tree, typename float_t, typename Visitor, typename T = typename Tree::mesh_type,
+    typename = std::enable_if_t<std::is_invocable_v<Visitor&, const typename Mesh<T>::Element&>>
+>
+void query_frustum(const Tree& tree, const Frustum<float_t>& frustum, Visitor&& visitor);
+
+template<typename Tree, typename float_t, typename T = typename Tree::mesh_type>
+void query_frustum(const Tree& tree, const Frustum<float_t>& frustum, std::vector<typename T::index_t>& output);
+
+
+namespace detail {
+
+template<typename Node, typename Visitor>
+void visit_subtree(const Node& node, Visitor& visitor) {
+    if (node.is_leaf()) {
+        for (const auto& triangle : node) {
+            visitor(triangle);
+        }
+        return;
+    }
+    visit_subtree(node.left(), visitor);
+    visit_subtree(node.right(), visitor);
+}
+
+template<typename T, typename Node, typename Region, typename Visitor>
+void query_region(const Node& node, const Region& region, Visitor& visitor) {
+    switch (box_overlap(node.box(), region)) {
+    case Overlap::Outside:
+        return;
+    case Overlap::Inside:
+        visit_subtree(node, visitor);
+        return;
+    case Overlap::Intersects:
+        break;
+    }
+
+    if (node.is_leaf()) {
+        for (const auto& triangle : node) {
+            if (triangle_overlaps<T>(triangle, region)) {
+                visitor(triangle);
+            }
+        }
+        return;
+    }
+    query_region<T>(node.left(), region, visitor);
+    query_region<T>(node.right(), region, visitor);
+}
+
+// Sutherland-Hodgman step: part of polygon on the inner side of plane
+template<typename float_t, size_t N>
+size_t clip_polygon(
+    const std::array<Vector3<float_t>, N>& input,
+    size_t size,
+    const Plane<float_t>& plane,
+    std::array<Vector3<float_t>, N>& output
+) {
+    size_t result = 0;
+    for (size_t i = 0; i < size; ++i) {
+        const auto& current = input[i];
+        const auto& next = input[(i + 1) % size];
+        const auto current_distance = plane.distance(current);
+        const auto next_distance = plane.distance(next);
+        if (current_distance >= 0) {
+            output[result++] = current;
+        }
+        if ((current_distance >= 0) != (next_distance >= 0)) {
+            const auto t = current_distance / (current_distance - next_distance);
+            output[result++] = current + (next - current) * t;
+        }
+    }
+    return result;
+}
+
+} // namespace detail
+
+
+template<typename float_t>
+Frustum<float_t> Frustum<float_t>::perspective(
+    const Vector3<float_t>& eye,
+    const Vector3<float_t>& forward,
+    const Vector3<float_t>& up,
+    float_t fov_y,
+    float_t aspect,
+    float_t near,
+    float_t far
+) {
+    const auto f = forward.ort();
+    const auto r = f.cross(up).ort();
+    const auto u = r.cross(f);
+    const float_t half_height = std::tan(fov_y / 2);
+    const float_t half_width = half_height * aspect;
+
+    // side plane through eye and two of corner directions, turned to the view axis
+    auto side = [&](const Vector3<float_t>& a, const Vector3<float_t>& b) {
+        auto normal = a.cross(b).ort();
+        if (normal.dot(f) < 0) {
+            normal = normal * -1;
+        }
+        return Plane<float_t>{normal, -normal.dot(eye)};
+    };
+    const auto left = f - r * half_width;
+    const auto right = f + r * half_width;
+    const auto bottom = f - u * half_height;
+    const auto top = f + u * half_height;
+
+    return Frustum{{
+        Plane<float_t>{f, -f.dot(eye) - near},
+        Plane<float_t>{f * -1, f.dot(eye) + far},
+        side(left, u),
+        side(right, u),
+        side(bottom, r),
+        side(top, r)
+    }};
+}
+
+/*
+ * Read for details: Akenine-Moller, Fast 3D Triangle-Box Overlap Testing.
+ * Axes are box normals, triangle normal and cross products of box normals
+ * with triangle edges, projections are taken relative to the box center.
+ */
+template<typename T, typename float_t>
+bool triangle_overlaps(const typename Mesh<T>::Element& triangle, const AABBox<float_t>& box) {
+    const auto center = (box.min + box.max) / 2;
+    const auto half = (box.max - box.min) / 2;
+    const std::array<Vector3<float_t>, 3> v = {
+        Vector3<float_t>(triangle.v1) - center,
+        Vector3<float_t>(triangle.v2) - center,
+        Vector3<float_t>(triangle.v3) - center
+    };
+
+    auto separated = [&v, &half](const Vector3<float_t>& axis) {
+        const float_t p0 = axis.dot(v[0]), p1 = axis.dot(v[1]), p2 = axis.dot(v[2]);
+        const float_t radius = half.x() * std::abs(axis.x()) + half.y() * std::abs(axis.y()) + half.z() * std::abs(axis.z());
+        return std::min({p0, p1, p2}) > radius || std::max({p0, p1, p2}) < -radius;
+    };
+
+    for (int axis = 0; axis < 3; ++axis) {
+        if (std::min({v[0][axis], v[1][axis], v[2][axis]}) > half[axis] ||
+            std::max({v[0][axis], v[1][axis], v[2][axis]}) < -half[axis]) {
+            return false;
+        }
+    }
+
+    const std::array<Vector3<float_t>, 3> edges = {v[1] - v[0], v[2] - v[1], v[0] - v[2]};
+    if (separated(edges[0].cross(edges[1]))) {
+        return false;
+    }
+
+    const std::array<Vector3<float_t>, 3> normals = {
+        Vector3<float_t>(1, 0, 0), Vector3<float_t>(0, 1, 0), Vector3<float_t>(0, 0, 1)
+    };
+    for (const auto& edge : edges) {
+        for (const auto& normal : normals) {
+            if (separated(edge.cross(normal))) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+template<typename T, typename float_t>
+bool triangle_overlaps(const typename Mesh<T>::Element& triangle, const Frustum<float_t>& frustum) {
+    // triangle and planes' intersections make at most 3 + 6 vertices
+    std::array<Vector3<float_t>, 9> polygon, clipped;
+    polygon[0] = Vector3<float_t>(triangle.v1);
+    polygon[1] = Vector3<float_t>(triangle.v2);
+    polygon[2] = Vector3<float_t>(triangle.v3);
+
+    bool inside = true;
+    for (const auto& plane : frustum.planes) {
+        const float_t d0 = plane.distance(polygon[0]), d1 = plane.distance(polygon[1]), d2 = plane.distance(polygon[2]);
+        if (d0 < 0 && d1 < 0 && d2 < 0) {
+            return false;
+        }
+        inside = inside && d0 >= 0 && d1 >= 0 && d2 >= 0;
+    }
+    if (inside) {
+        return true;
+    }
+
+    size_t size = 3;
+    for (const auto& plane : frustum.planes) {
+        size = detail::clip_polygon(polygon, size, plane, clipped);
+        if (size == 0) {
+            return false;
+        }
+        std::swap(polygon, clipped);
+    }
+    return true;
+}
+
+template<typename float_t, typename box_float_t>
+Overlap box_overlap(const AABBox<box_float_t>& node_box, const AABBox<float_t>& box) {
+    bool inside = true;
+    for (int axis = 0; axis < 3; ++axis) {
+        const auto min = static_cast<float_t>(node_box.min[axis]);
+        const auto max = static_cast<float_t>(node_box.max[axis]);
+        if (min > box.max[axis] || max < box.min[axis]) {
+            return Overlap::Outside;
+        }
+        inside = inside && box.min[axis] <= min && max <= box.max[axis];
+    }
+    return inside ? Overlap::Inside : Overlap::Intersects;
+}
+
+template<typename float_t, typename box_float_t>
+Overlap box_overlap(const AABBox<box_float_t>& node_box, const Frustum<float_t>& frustum) {
+    const Vector3<float_t> min(node_box.min), max(node_box.max);
+    bool inside = true;
+    for (const auto& plane : frustum.planes) {
+        // corners farthest along and against the normal
+        const Vector3<float_t> positive(
+            plane.normal.x() >= 0 ? max.x() : min.x(),
+            plane.normal.y() >= 0 ? max.y() : min.y(),
+            plane.normal.z() >= 0 ? max.z() : min.z()
+        );
+        const Vector3<float_t> negative(
+            plane.normal.x() >= 0 ? min.x() : max.x(),
+            plane.normal.y() >= 0 ? min.y() : max.y(),
+            plane.normal.z() >= 0 ? min.z() : max.z()
+        );
+        if (plane.distance(positive) < 0) {
+            return Overlap::Outside;
+        }
+        inside = inside && plane.distance(negative) >= 0;
+    }
+    // boxes near frustum corners may be reported as intersecting, leaves test triangles exactly
+    return inside ? Overlap::Inside : Overlap::Intersects;
+}
+
+template<typename Tree, typename float_t, typename Visitor, typename T, typename>
+void query_box(const Tree& tree, const AABBox<float_t>& box, Visitor&& visitor) {
+    detail::query_region<T>(tree.top(), box, visitor);
+}
+
+template<typename Tree, typename float_t, typename T>
+void query_box(const Tree& tree, const AABBox<float_t>& box, std::vector<typename T::index_t>& output) {
+    query_box(tree, box, [&output](const typename Mesh<T>::Element& triangle) {
+        output.push_back(triangle.index);
+    });
+}
+
+template<typename Tree, typename float_t, typename Visitor, typename T, typename>
+void query_frustum(const Tree& tree, const Frustum<float_t>& frustum, Visitor&& visitor) {
+    detail::query_region<T>(tree.top(), frustum, visitor);
+}
+
+template<typename Tree, typename float_t, typename T>
+void query_frustum(const Tree& tree, const Frustum<float_t>& frustum, std::vector<typename T::index_t>& output) {
+    query_frustum(tree, frustum, [&output](const typename Mesh<T>::Element& triangle) {
+        output.push_back(triangle.index);
+    });
+}
+
+} // namespace rmi
@@ -9,10 +9,19 @@
 #include <memory>
 #include <array>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iterator>
+#include <string>
 #include <math.h>
 
+#include "arena.hpp"
+#include "simd.hpp"
+
 #ifdef RMI_INCLUDE_POOL
 #    include "wsq.hpp"
+#    include <functional>
 #    include <thread>
 #endif
 
@@ -20,6 +29,13 @@
 #    include <omp.h>
 #endif
 
+// Traversal counters cost nothing unless RMI_ENABLE_STATS is defined
+#ifdef RMI_ENABLE_STATS
+#    define RMI_STATS(statement) statement
+#else
+#    define RMI_STATS(statement)
+#endif
+
 
 namespace rmi {
 
@@ -29,6 +45,9 @@ public:
     constexpr Vector3();
     constexpr Vector3(T x, T y, T z);
 
+    template<typename U>
+    explicit Vector3(const Vector3<U>& other);
+
     void    operator+=(const Vector3& rhs);
     void    operator-=(const Vector3& rhs);
     Vector3 operator+ (const Vector3& rhs) const;
@@ -67,18 +86,29 @@ struct AABBox {
     AABBox();
     AABBox(Vector3<T> min, Vector3<T> max);
 
+    // Converts box to another precision. Bounds are rounded outward,
+    // so the result always contains the original box.
+    template<typename U>
+    AABBox(const AABBox<U>& box);
+
     void   operator+=(const AABBox<T>& box);
     AABBox operator+(const AABBox<T>& box) const;
     T      volume() const;
+    T      area() const;
+    T      overlap(const AABBox<T>& box) const;
 
     Vector3<T> min;
     Vector3<T> max;
 };
 
 
+// Nodes of at least parallel_threshold elements, split during OMP build,
+// are sorted and evaluated by several tasks. Smaller ones are split by one task.
 template<typename T>
 struct SAHSplitter {
-    SAHSplitter(int threshold = 16): threshold(threshold) {}
+    SAHSplitter(int threshold = 16, size_t parallel_threshold = 1 << 16):
+        threshold(threshold), parallel_threshold(parallel_threshold)
+    {}
 
     typename T::iterator operator()(
         typename T::iterator begin,
@@ -86,18 +116,24 @@ struct SAHSplitter {
         int depth
     ) const;
 
+    // Children are weighed by surface area of their boxes, so flat nodes, whose
+    // volume is zero, are split too
     std::pair<typename T::iterator, typename T::float_t> find_min_sah(
         typename T::iterator begin,
-        typename T::iterator end
+        typename T::iterator end,
+        bool parallel = false
     ) const;
 
-    int threshold;
+    int    threshold;
+    size_t parallel_threshold;
 };
 
 
 template<typename T>
 struct MedianSplitter {
-    MedianSplitter(int depth_limit = 16): depth_limit(depth_limit) {}
+    MedianSplitter(int depth_limit = 16, size_t parallel_threshold = 1 << 16):
+        depth_limit(depth_limit), parallel_threshold(parallel_threshold)
+    {}
 
     typename T::iterator operator()(
         typename T::iterator begin,
@@ -105,7 +141,64 @@ struct MedianSplitter {
         int depth
     ) const;
 
-    int depth_limit;
+    int    depth_limit;
+    size_t parallel_threshold;
+};
+
+
+// Durations of build phases in seconds
+struct BuildTimings {
+    double total = 0;
+    // time spent in splitter (sorting, cost evaluation), summed over threads for parallel build
+    double splitting = 0;
+};
+
+
+struct TreeStats {
+    size_t nodes_count = 0;
+    size_t leaves_count = 0;
+    // leaves count at every depth
+    std::vector<size_t> depth_histogram;
+    // i-th bucket counts leaves of size in [2^i, 2^(i+1)), empty leaves are counted in the 0-th one
+    std::vector<size_t> leaf_size_histogram;
+    // surface area heuristic with unit costs of node traversal and triangle test
+    double sah_cost = 0;
+    // summed volume of sibling boxes intersections
+    double overlap = 0;
+    size_t nodes_bytes = 0;
+    size_t elements_bytes = 0;
+    BuildTimings timings;
+};
+
+
+// Work done by tree queries, collected only when RMI_ENABLE_STATS is defined
+struct TraversalStats {
+    size_t rays = 0;
+    size_t nodes_visited = 0;
+    size_t box_tests = 0;
+    size_t triangle_tests = 0;
+    size_t hits = 0;
+    size_t max_stack_depth = 0;
+
+    // Sums counters, keeps the deepest stack
+    void operator+=(const TraversalStats& other);
+
+    std::string to_json() const;
+};
+
+// Counters of tree queries made by the calling thread, including work of helper
+// threads of parallel queries. Reset it before query or batch and read it after.
+TraversalStats& traversal_stats();
+
+
+// Hits counted by Ray::count_intersections
+struct Crossings {
+    size_t count = 0;
+    // ray passed near an edge or a vertex of hit triangle, so the hit may be
+    // counted by both neighbours or by none of them
+    bool   degenerate = false;
+
+    inline bool odd() const { return count % 2 == 1; }
 };
 
 
@@ -116,11 +209,14 @@ public:
         Element(
             Vector3<typename T::float_t> v1,
             Vector3<typename T::float_t> v2,
-            Vector3<typename T::float_t> v3
-        ): v1(v1), v2(v2), v3(v3), center((v1 + v2 + v3) / 3)
+            Vector3<typename T::float_t> v3,
+            typename T::index_t index
+        ): v1(v1), v2(v2), v3(v3), center((v1 + v2 + v3) / 3), index(index)
         {}
 
         Vector3<typename T::float_t> v1, v2, v3, center;
+        // index of triangle in wrapped mesh
+        typename T::index_t index;
     };
 
     using iterator = typename std::vector<Element>::iterator;
@@ -129,24 +225,39 @@ public:
     inline iterator end()   { return elements.end(); }
 
     void setup(typename std::vector<Element>::size_type size);
+
+    // Re-reads vertices of elements in range, keeping their order
+    void update(iterator begin, iterator end);
 private:
     std::vector<Element> elements;
 };
 
 
+#ifdef RMI_INCLUDE_POOL
+namespace parallel {
+class TaskPool;
+}
+#endif
+
+
 template<typename T>
 class KDTree {
 public:
+    using mesh_type = T;
     using mesh_iterator = typename T::iterator;
 
+    class Node;
+    // nodes are allocated in tree's arena, nodes of rebuilt subtrees are given back to it
+    using node_ptr = std::unique_ptr<Node, ArenaDeleter>;
+
     class Node {
     public:
         friend KDTree;
 
         Node(
             AABBox<typename T::float_t> box,
-            std::unique_ptr<Node>&& left,
-            std::unique_ptr<Node>&& right
+            node_ptr&& left,
+            node_ptr&& right
         ): bounding_box(box), m_begin(left->begin()), m_end(right->end()), m_left(std::move(left)), m_right(std::move(right)) {}
 
         Node(
@@ -161,22 +272,70 @@ public:
         inline const AABBox<typename T::float_t>& box()     const { return bounding_box; }
         inline mesh_iterator                      begin()   const { return m_begin; }
         inline mesh_iterator                      end()     const { return m_end; }
+
+        // Whether hit of element found in leaf should be reported. Trees, that
+        // reference one triangle from several leaves, use it to skip duplicates.
+        template<typename U>
+        inline bool accepts(const typename Mesh<T>::Element&, const Vector3<U>&) const { return true; }
     private:
+        void refit(Mesh<T>& mesh);
+
         template<typename Splitter>
-        static std::unique_ptr<Node> build(
+        void rebuild_degraded(int depth, typename T::float_t max_overlap, const Splitter& splitter, Arena& arena);
+
+        // Gives nodes of subtree back to arena for reuse by following builds
+        static void release(node_ptr&& node, Arena& arena);
+
+        // Moves rebuilt subtree into this node, replaced nodes are given back to arena
+        void replace(node_ptr&& rebuilt, Arena& arena);
+
+        template<typename Splitter>
+        static node_ptr build(
             mesh_iterator begin,
             mesh_iterator end,
             int depth,
-            const Splitter& splitter
+            const Splitter& splitter,
+            Arena& arena
         );
 
 #ifdef RMI_INCLUDE_OMP
         template<typename Splitter>
-        static std::unique_ptr<Node> omp_build(
+        static node_ptr omp_build(
+            mesh_iterator begin,
+            mesh_iterator end,
+            int depth,
+            const Splitter& splitter,
+            Arena& arena
+        );
+
+        void omp_refit(Mesh<T>& mesh);
+
+        template<typename Splitter>
+        void omp_rebuild_degraded(int depth, typename T::float_t max_overlap, const Splitter& splitter, Arena& arena);
+#endif
+
+#ifdef RMI_INCLUDE_POOL
+        // Children of node built by pool, thread finishing the last of them creates the node
+        struct PoolJoin {
+            node_ptr        left;
+            node_ptr        right;
+            std::atomic_int remaining;
+            node_ptr&       output;
+            PoolJoin*       parent;
+        };
+
+        // Builds subtree to output, right children are left to be stolen by other threads
+        template<typename Splitter>
+        static void pool_build(
+            parallel::TaskPool& pool,
+            int thread_id,
             mesh_iterator begin,
             mesh_iterator end,
             int depth,
-            const Splitter& splitter
+            const Splitter& splitter,
+            Arena& arena,
+            node_ptr& output,
+            PoolJoin* parent
         );
 #endif
 
@@ -185,37 +344,119 @@ public:
         mesh_iterator               m_begin;
         mesh_iterator               m_end;
 
-        std::unique_ptr<Node>       m_left;
-        std::unique_ptr<Node>       m_right;
+        node_ptr                    m_left;
+        node_ptr                    m_right;
     };
 
-    KDTree(std::unique_ptr<Node>&& root): root(std::move(root)) {}
+    KDTree(std::unique_ptr<Arena>&& arena, node_ptr&& root, BuildTimings timings = {}):
+        arena(std::move(arena)), root(std::move(root)), timings(timings)
+    {}
 
     template<typename Splitter = SAHSplitter<T>>
-    static KDTree<T> for_mesh(Mesh<T>& mesh, const Splitter& splitter = Splitter());
+    static KDTree<T> for_mesh(Mesh<T>& mesh, const Splitter& splitter = Splitter(), ArenaOptions arena_options = {});
 
 #ifdef RMI_INCLUDE_OMP
     template<typename Splitter = SAHSplitter<T>>
-    static KDTree<T> for_mesh(Mesh<T>& mesh, int threads_count, const Splitter& splitter = Splitter());
+    static KDTree<T> for_mesh(
+        Mesh<T>& mesh,
+        int threads_count,
+        const Splitter& splitter = Splitter(),
+        ArenaOptions arena_options = {}
+    );
+#endif
+
+#ifdef RMI_INCLUDE_POOL
+    // Parallel build without OpenMP, subtrees are tasks of work-stealing pool
+    template<typename Splitter = SAHSplitter<T>>
+    static KDTree<T> pool_for_mesh(
+        Mesh<T>& mesh,
+        int threads_count,
+        const Splitter& splitter = Splitter(),
+        ArenaOptions arena_options = {}
+    );
+#endif
+
+    // Re-reads vertices through mesh's accessor and recomputes boxes bottom-up.
+    // Mesh topology must stay the same since the tree was built.
+    void refit(Mesh<T>& mesh);
+
+    // Refits tree and then rebuilds subtrees, whose children boxes overlap
+    // by more than max_overlap fraction of their parent's volume.
+    // Replaced nodes are reused, so refitting every frame doesn't grow memory.
+    template<typename Splitter>
+    void refit(Mesh<T>& mesh, typename T::float_t max_overlap, const Splitter& splitter);
+
+#ifdef RMI_INCLUDE_OMP
+    void refit(Mesh<T>& mesh, int threads_count);
+
+    template<typename Splitter>
+    void refit(Mesh<T>& mesh, int threads_count, typename T::float_t max_overlap, const Splitter& splitter);
 #endif
 
     inline const Node& top() const {
         return *root;
     }
+
+    // Memory reserved for nodes
+    inline size_t reserved_bytes() const {
+        return arena->reserved_bytes();
+    }
+
+    // Walks the tree, timings are of the last for_mesh call
+    TreeStats stats() const;
 private:
-    std::unique_ptr<Node> root;
+    // Adds time spent in wrapped splitter to counter shared by copies
+    template<typename Splitter>
+    class TimedSplitter {
+    public:
+        TimedSplitter(const Splitter& splitter, std::atomic<long long>& nanoseconds):
+            splitter(splitter), nanoseconds(&nanoseconds)
+        {}
+
+        typename T::iterator operator()(typename T::iterator begin, typename T::iterator end, int depth) const;
+    private:
+        const Splitter&         splitter;
+        std::atomic<long long>* nanoseconds;
+    };
+
+    // declared before root, so nodes are released after the last use
+    std::unique_ptr<Arena> arena;
+    node_ptr               root;
+    BuildTimings           timings;
 };
 
 
+// Statistics of any tree with KDTree-like nodes
+template<typename Node>
+TreeStats get_tree_stats(const Node& top);
+
+
 template<typename float_t>
 class Ray {
 public:
-    Ray(Vector3<float_t> origin, Vector3<float_t> direction);
+    // Only points at distances from t_min to t_max along the ray are reported,
+    // nodes outside of this interval are not visited
+    Ray(
+        Vector3<float_t> origin,
+        Vector3<float_t> direction,
+        float_t t_min = 0,
+        float_t t_max = std::numeric_limits<float_t>::infinity()
+    );
+
+    // Ray limited by the segment between two points
+    static Ray segment(const Vector3<float_t>& from, const Vector3<float_t>& to);
 
     Vector3<float_t> at(float_t t) const;
 
+    inline const Vector3<float_t>& origin()    const { return m_origin; }
+    // normalized direction
+    inline const Vector3<float_t>& direction() const { return m_direction; }
+    inline float_t t_min() const { return m_t_min; }
+    inline float_t t_max() const { return m_t_max; }
+
     bool is_intersects(const AABBox<float_t>& box) const;
 
+    // Entry and exit distances clipped by [t_min, t_max], first > second if box is missed
     std::pair<float_t, float_t> intersects(const AABBox<float_t>& box) const;
 
     template<typename T>
@@ -230,21 +471,57 @@ public:
         float_t epsilon = std::numeric_limits<float_t>::epsilon()
     ) const;
 
-    template<typename T>
+    // Tree is any hierarchy with KDTree-like nodes (KDTree, DynamicTree)
+    template<typename Tree, typename T = typename Tree::mesh_type>
     std::vector<Vector3<float_t>> intersects(
-        const KDTree<T>& tree,
+        const Tree& tree,
+        float_t epsilon = std::numeric_limits<float_t>::epsilon()
+    ) const;
+
+    // Appends intersections to output, so one buffer may be reused by many queries without allocations
+    template<typename Tree, typename T = typename Tree::mesh_type>
+    void intersects(
+        const Tree& tree,
+        std::vector<Vector3<float_t>>& output,
+        float_t epsilon = std::numeric_limits<float_t>::epsilon()
+    ) const;
+
+    // Calls visitor with every triangle of leaf crossed by the ray and the hit point.
+    // Float rays test 4 triangles at once when RMI_SIMD128 is defined.
+    template<typename T, typename Node, typename Visitor>
+    void intersects_leaf(const Node& leaf, float_t epsilon, Visitor&& visitor) const;
+
+    // Counts hits without storing them, e.g. for inside / outside tests by parity
+    template<typename Tree, typename T = typename Tree::mesh_type>
+    Crossings count_intersections(
+        const Tree& tree,
+        float_t epsilon = std::numeric_limits<float_t>::epsilon()
+    ) const;
+
+    // Nearest hit: children are visited nearest first and t_max shrinks with every hit,
+    // so boxes behind the nearest hit found so far are skipped
+    template<typename Tree, typename T = typename Tree::mesh_type>
+    std::optional<Vector3<float_t>> closest_intersection(
+        const Tree& tree,
+        float_t epsilon = std::numeric_limits<float_t>::epsilon()
+    ) const;
+
+    // Whether anything is hit in [t_min, t_max], traversal stops at the first leaf with a hit
+    template<typename Tree, typename T = typename Tree::mesh_type>
+    bool intersects_any(
+        const Tree& tree,
         float_t epsilon = std::numeric_limits<float_t>::epsilon()
     ) const;
 
 #ifdef RMI_INCLUDE_POOL
-    template<typename T>
-    std::vector<Vector3<float_t>> pool_intersects(const KDTree<T>& tree, int threads_count) const;
+    template<typename Tree, typename T = typename Tree::mesh_type>
+    std::vector<Vector3<float_t>> pool_intersects(const Tree& tree, int threads_count) const;
 #endif
 
 #ifdef RMI_INCLUDE_OMP
-    template<typename T>
+    template<typename Tree, typename T = typename Tree::mesh_type>
     std::vector<Vector3<float_t>> omp_intersects(
-        const KDTree<T>& tree,
+        const Tree& tree,
         int threads_count,
         float_t epsilon = std::numeric_limits<float_t>::epsilon()
     ) const;
@@ -258,16 +535,38 @@ public:
 #endif
 
 private:
-    template<typename T>
+    template<typename T, typename Node>
     void recursive_intersects(
-        const typename KDTree<T>::Node& node,
+        const Node& node,
         std::vector<Vector3<float_t>>& output,
-        float_t epsilon = std::numeric_limits<float_t>::epsilon()
+        float_t epsilon = std::numeric_limits<float_t>::epsilon(),
+        size_t depth = 1
+    ) const;
+
+    template<typename T, typename Node>
+    void recursive_count(const Node& node, Crossings& crossings, float_t epsilon, size_t depth = 1) const;
+
+    // Shrinks m_t_max of this copy of the ray to the nearest hit
+    template<typename T, typename Node>
+    void recursive_closest(const Node& node, std::optional<Vector3<float_t>>& closest, float_t epsilon, size_t depth = 1);
+
+    template<typename T, typename Node>
+    bool recursive_any(const Node& node, float_t epsilon, size_t depth = 1) const;
+
+    // Distance to triangle hit, near_edge is set if the hit or miss is decided
+    // by barycentric coordinates close to zero
+    template<typename T>
+    std::optional<float_t> crosses(
+        const typename Mesh<T>::Element& triangle,
+        float_t epsilon,
+        bool& near_edge
     ) const;
 
-    Vector3<float_t> origin;
-    Vector3<float_t> vector;
-    Vector3<float_t> inv_vector;
+    Vector3<float_t> m_origin;
+    Vector3<float_t> m_direction;
+    Vector3<float_t> m_inv_direction;
+    float_t          m_t_min;
+    float_t          m_t_max;
 };
 
 } // namespace rmi
@@ -285,6 +584,15 @@ template<typename T>
 inline constexpr Vector3<T>::Vector3(T x, T y, T z): coords({x, y, z}) {
 }
 
+template<typename T>
+template<typename U>
+inline Vector3<T>::Vector3(const Vector3<U>& other): coords({
+    static_cast<T>(other.x()),
+    static_cast<T>(other.y()),
+    static_cast<T>(other.z())
+}) {
+}
+
 template<typename T>
 inline Vector3<T> Vector3<T>::operator+(const Vector3<T>& rhs) const {
     return Vector3<T>(
@@ -395,6 +703,20 @@ AABBox<typename T::float_t> get_bounding_box(
     typename T::iterator begin,
     typename T::iterator end
 ) {
+#ifdef RMI_SIMD128
+    if constexpr (std::is_same_v<typename T::float_t, float>) {
+        simd::Bounds bounds;
+        for (auto it = begin; it != end; ++it) {
+            bounds.add(simd::float4{it->v1.x(), it->v1.y(), it->v1.z(), 0});
+            bounds.add(simd::float4{it->v2.x(), it->v2.y(), it->v2.z(), 0});
+            bounds.add(simd::float4{it->v3.x(), it->v3.y(), it->v3.z(), 0});
+        }
+        return {
+            Vector3<float>(bounds.min[0], bounds.min[1], bounds.min[2]),
+            Vector3<float>(bounds.max[0], bounds.max[1], bounds.max[2])
+        };
+    }
+#endif
     AABBox<typename T::float_t> box;
     for (auto it = begin; it != end; ++it) {
         box += get_bounding_box<T>(*it);
@@ -408,9 +730,28 @@ inline T AABBox<T>::volume() const {
     return dim.x() * dim.y() * dim.z();
 }
 
+template<typename T>
+inline T AABBox<T>::area() const {
+    const auto dim = max - min;
+    return 2 * (dim.x() * dim.y() + dim.y() * dim.z() + dim.z() * dim.x());
+}
+
+template<typename T>
+inline T AABBox<T>::overlap(const AABBox<T>& box) const {
+    const auto dim = Vector3<T>(
+        std::min(max.x(), box.max.x()) - std::max(min.x(), box.min.x()),
+        std::min(max.y(), box.max.y()) - std::max(min.y(), box.min.y()),
+        std::min(max.z(), box.max.z()) - std::max(min.z(), box.min.z())
+    );
+    if (dim.x() <= 0 || dim.y() <= 0 || dim.z() <= 0) {
+        return 0;
+    }
+    return dim.x() * dim.y() * dim.z();
+}
+
 template<typename T>
 AABBox<T>::AABBox() {
-    T mn = std::numeric_limits<T>::min();
+    T mn = std::numeric_limits<T>::lowest();
     T mx = std::numeric_limits<T>::max();
 
     min = Vector3<T>(mx, mx, mx);
@@ -421,6 +762,32 @@ template<typename T>
 AABBox<T>::AABBox(Vector3<T> min, Vector3<T> max): min(min), max(max) {
 }
 
+template<typename T, typename U>
+inline T round_down(U value) {
+    T result = static_cast<T>(value);
+    if (static_cast<U>(result) > value) {
+        result = std::nextafter(result, std::numeric_limits<T>::lowest());
+    }
+    return result;
+}
+
+template<typename T, typename U>
+inline T round_up(U value) {
+    T result = static_cast<T>(value);
+    if (static_cast<U>(result) < value) {
+        result = std::nextafter(result, std::numeric_limits<T>::max());
+    }
+    return result;
+}
+
+template<typename T>
+template<typename U>
+AABBox<T>::AABBox(const AABBox<U>& box):
+    min(round_down<T>(box.min.x()), round_down<T>(box.min.y()), round_down<T>(box.min.z())),
+    max(round_up<T>(box.max.x()), round_up<T>(box.max.y()), round_up<T>(box.max.z()))
+{
+}
+
 template<typename T>
 AABBox<T> AABBox<T>::operator+(const AABBox<T>& box) const {
     return {
@@ -460,23 +827,95 @@ void Mesh<T>::setup(typename std::vector<typename Mesh<T>::Element>::size_type s
     elements.reserve(size);
     for (typename T::index_t i = 0; i < size; ++i) {
         elements.emplace_back(
-            mesh->template v<0>(i),
-            mesh->template v<1>(i),
-            mesh->template v<2>(i)
+            Vector3<typename T::float_t>(mesh->template v<0>(i)),
+            Vector3<typename T::float_t>(mesh->template v<1>(i)),
+            Vector3<typename T::float_t>(mesh->template v<2>(i)),
+            i
+        );
+    }
+}
+
+template<typename T>
+void Mesh<T>::update(iterator begin, iterator end) {
+    auto mesh = static_cast<T*>(this);
+    for (auto it = begin; it != end; ++it) {
+        *it = Element(
+            Vector3<typename T::float_t>(mesh->template v<0>(it->index)),
+            Vector3<typename T::float_t>(mesh->template v<1>(it->index)),
+            Vector3<typename T::float_t>(mesh->template v<2>(it->index)),
+            it->index
         );
     }
 }
 
 
+// TraversalStats implementation
+namespace traversal {
+
+// Counters receiving increments on this thread: its own ones or slot of parallel query
+inline TraversalStats*& sink() {
+    thread_local TraversalStats* current = &traversal_stats();
+    return current;
+}
+
+inline TraversalStats& current() {
+    return *sink();
+}
+
+// Redirects counters of this thread to slot until the end of scope
+class Redirect {
+public:
+    Redirect(TraversalStats& slot): previous(sink()) { sink() = &slot; }
+    ~Redirect() { sink() = previous; }
+private:
+    TraversalStats* previous;
+};
+
+} // namespace traversal
+
+inline TraversalStats& traversal_stats() {
+    thread_local TraversalStats stats;
+    return stats;
+}
+
+inline void TraversalStats::operator+=(const TraversalStats& other) {
+    rays += other.rays;
+    nodes_visited += other.nodes_visited;
+    box_tests += other.box_tests;
+    triangle_tests += other.triangle_tests;
+    hits += other.hits;
+    max_stack_depth = std::max(max_stack_depth, other.max_stack_depth);
+}
+
+inline std::string TraversalStats::to_json() const {
+    return "{\"rays\": " + std::to_string(rays)
+        + ", \"nodes_visited\": " + std::to_string(nodes_visited)
+        + ", \"box_tests\": " + std::to_string(box_tests)
+        + ", \"triangle_tests\": " + std::to_string(triangle_tests)
+        + ", \"hits\": " + std::to_string(hits)
+        + ", \"max_stack_depth\": " + std::to_string(max_stack_depth) + "}";
+}
+
+
 // Tree implementation
 
 template<typename T>
 template<typename Splitter>
 inline KDTree<T> KDTree<T>::for_mesh(
     Mesh<T>& mesh,
-    const Splitter& splitter
+    const Splitter& splitter,
+    ArenaOptions arena_options
 ) {
-    return KDTree<T>(Node::build(mesh.begin(), mesh.end(), 0, splitter));
+    const auto start = std::chrono::steady_clock::now();
+    std::atomic<long long> splitting(0);
+    // a tree of n triangles has less than 2n nodes
+    const auto triangles = static_cast<size_t>(std::distance(mesh.begin(), mesh.end()));
+    auto arena = std::make_unique<Arena>(arena_options.sized_for(2 * triangles, sizeof(Node)));
+
+    auto root = Node::build(mesh.begin(), mesh.end(), 0, TimedSplitter<Splitter>(splitter, splitting), *arena);
+
+    const std::chrono::duration<double> total = std::chrono::steady_clock::now() - start;
+    return KDTree<T>(std::move(arena), std::move(root), {total.count(), splitting.load() * 1e-9});
 }
 
 
@@ -486,38 +925,272 @@ template<typename Splitter>
 inline KDTree<T> KDTree<T>::for_mesh(
     Mesh<T>& mesh,
     int threads_count,
-    const Splitter& splitter
+    const Splitter& splitter,
+    ArenaOptions arena_options
 ) {
-    std::unique_ptr<typename KDTree<T>::Node> node;
-    #pragma omp parallel num_threads(threads_count) shared(node, mesh)
+    const auto start = std::chrono::steady_clock::now();
+    std::atomic<long long> splitting(0);
+    const TimedSplitter<Splitter> timed(splitter, splitting);
+    // a tree of n triangles has less than 2n nodes
+    const auto triangles = static_cast<size_t>(std::distance(mesh.begin(), mesh.end()));
+    auto arena = std::make_unique<Arena>(arena_options.sized_for(2 * triangles, sizeof(Node)));
+
+    node_ptr node;
+    #pragma omp parallel num_threads(threads_count) shared(node, mesh, timed, arena)
     #pragma omp single
-    node = std::move(Node::omp_build(mesh.begin(), mesh.end(), 0, splitter));
+    node = Node::omp_build(mesh.begin(), mesh.end(), 0, timed, *arena);
 
-    return KDTree<T>(std::move(node));
+    const std::chrono::duration<double> total = std::chrono::steady_clock::now() - start;
+    return KDTree<T>(std::move(arena), std::move(node), {total.count(), splitting.load() * 1e-9});
 }
 #endif
 
 
+template<typename T>
+template<typename Splitter>
+inline typename T::iterator KDTree<T>::TimedSplitter<Splitter>::operator()(
+    typename T::iterator begin,
+    typename T::iterator end,
+    int depth
+) const {
+    const auto start = std::chrono::steady_clock::now();
+    auto split = splitter(begin, end, depth);
+    *nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start
+    ).count();
+    return split;
+}
+
+template<typename T>
+inline TreeStats KDTree<T>::stats() const {
+    auto stats = get_tree_stats(*root);
+    stats.timings = timings;
+    return stats;
+}
+
+
+template<typename Node>
+void collect_tree_stats(const Node& node, size_t depth, double root_area, TreeStats& stats) {
+    const double area_ratio = root_area > 0 ? node.box().area() / root_area : 1;
+    ++stats.nodes_count;
+
+    if (!node.is_leaf()) {
+        stats.sah_cost += area_ratio;
+        stats.overlap += node.left().box().overlap(node.right().box());
+        collect_tree_stats(node.left(), depth + 1, root_area, stats);
+        collect_tree_stats(node.right(), depth + 1, root_area, stats);
+        return;
+    }
+
+    const auto size = static_cast<size_t>(std::distance(node.begin(), node.end()));
+    ++stats.leaves_count;
+    stats.sah_cost += area_ratio * size;
+    stats.elements_bytes += size * sizeof(*node.begin());
+
+    if (stats.depth_histogram.size() <= depth) {
+        stats.depth_histogram.resize(depth + 1);
+    }
+    ++stats.depth_histogram[depth];
+
+    size_t bucket = 0;
+    while ((size >> (bucket + 1)) > 0) {
+        ++bucket;
+    }
+    if (stats.leaf_size_histogram.size() <= bucket) {
+        stats.leaf_size_histogram.resize(bucket + 1);
+    }
+    ++stats.leaf_size_histogram[bucket];
+}
+
+template<typename Node>
+TreeStats get_tree_stats(const Node& top) {
+    TreeStats stats;
+    collect_tree_stats(top, 0, top.box().area(), stats);
+    stats.nodes_bytes = stats.nodes_count * sizeof(Node);
+    return stats;
+}
+
+
+namespace detail {
+
+// Subtrees smaller than this are built by one OMP task
+constexpr std::ptrdiff_t sequential_build_cutoff = 4096;
+
+// Longest node, that uses thread's scratch memory for split evaluation
+constexpr std::ptrdiff_t max_scratch_length = 1 << 14;
+
+// Vectors reused by consequent splits in the same thread
+template<typename U>
+std::vector<U>& thread_scratch(size_t slot) {
+    static thread_local std::array<std::vector<U>, 2> scratch;
+    return scratch[slot];
+}
+
+// Whether splitter runs inside OMP build and node is large enough to share its work
+inline bool split_in_parallel([[maybe_unused]] std::ptrdiff_t length, [[maybe_unused]] size_t threshold) {
+#ifdef RMI_INCLUDE_OMP
+    return omp_in_parallel() && static_cast<size_t>(length) >= threshold;
+#else
+    return false;
+#endif
+}
+
+#ifdef RMI_INCLUDE_OMP
+// Calls function(chunk_begin, chunk_end) for about equal chunks of [0, length) as OMP tasks
+template<typename Function>
+void omp_for_chunks(std::ptrdiff_t length, std::ptrdiff_t chunks, const Function& function) {
+    const auto chunk = (length + chunks - 1) / chunks;
+    for (std::ptrdiff_t first = 0; first < length; first += chunk) {
+        #pragma omp task shared(function)
+        function(first, std::min(first + chunk, length));
+    }
+    #pragma omp taskwait
+}
+
+// Merges sorted [begin1, end1) and [begin2, end2) to output, halves of the longer range are merged by tasks
+template<typename Iterator, typename Output, typename Compare>
+void omp_merge(
+    Iterator begin1, Iterator end1,
+    Iterator begin2, Iterator end2,
+    Output output,
+    const Compare& compare,
+    std::ptrdiff_t grain
+) {
+    const auto length1 = std::distance(begin1, end1);
+    const auto length2 = std::distance(begin2, end2);
+    if (length1 + length2 <= grain) {
+        std::merge(
+            std::make_move_iterator(begin1), std::make_move_iterator(end1),
+            std::make_move_iterator(begin2), std::make_move_iterator(end2),
+            output, compare
+        );
+        return;
+    }
+    if (length1 < length2) {
+        const auto mid2 = std::next(begin2, length2 / 2);
+        const auto mid1 = std::lower_bound(begin1, end1, *mid2, compare);
+        const auto output_mid = std::next(output, std::distance(begin1, mid1) + length2 / 2);
+        #pragma omp task shared(compare)
+        omp_merge(begin1, mid1, begin2, mid2, output, compare, grain);
+        omp_merge(mid1, end1, mid2, end2, output_mid, compare, grain);
+    } else {
+        const auto mid1 = std::next(begin1, length1 / 2);
+        const auto mid2 = std::upper_bound(begin2, end2, *mid1, compare);
+        const auto output_mid = std::next(output, length1 / 2 + std::distance(begin2, mid2));
+        #pragma omp task shared(compare)
+        omp_merge(begin1, mid1, begin2, mid2, output, compare, grain);
+        omp_merge(mid1, end1, mid2, end2, output_mid, compare, grain);
+    }
+    #pragma omp taskwait
+}
+
+// Merge sort, sorts halves and merges them by tasks, buffer is at least as long as the range
+template<typename Iterator, typename Buffer, typename Compare>
+void omp_sort(Iterator begin, Iterator end, Buffer buffer, const Compare& compare, std::ptrdiff_t grain) {
+    const auto length = std::distance(begin, end);
+    if (length <= grain) {
+        std::sort(begin, end, compare);
+        return;
+    }
+
+    const auto mid = std::next(begin, length / 2);
+    #pragma omp task shared(compare)
+    omp_sort(begin, mid, buffer, compare, grain);
+    omp_sort(mid, end, std::next(buffer, length / 2), compare, grain);
+    #pragma omp taskwait
+
+    omp_merge(begin, mid, mid, end, buffer, compare, grain);
+    omp_for_chunks(length, std::max<std::ptrdiff_t>(1, length / grain), [&](auto first, auto last) {
+        std::move(std::next(buffer, first), std::next(buffer, last), std::next(begin, first));
+    });
+}
+#endif
+
+// Sorts by centers along axis. Sort is parallel, when buffer for elements of node is given.
+template<typename T>
+void sort_by_axis(
+    typename T::iterator begin,
+    typename T::iterator end,
+    int axis,
+    [[maybe_unused]] std::vector<typename Mesh<T>::Element>* buffer
+) {
+    const auto compare = [axis](const auto& it1, const auto& it2) {
+        return it1.center[axis] < it2.center[axis];
+    };
+#ifdef RMI_INCLUDE_OMP
+    if (buffer) {
+        const auto length = std::distance(begin, end);
+        const auto grain = std::max<std::ptrdiff_t>(4096, length / (8 * omp_get_num_threads()));
+        omp_sort(begin, end, buffer->begin(), compare, grain);
+        return;
+    }
+#endif
+    std::sort(begin, end, compare);
+}
+
+} // namespace detail
+
+
 template<typename T>
 std::pair<typename T::iterator, typename T::float_t> SAHSplitter<T>::find_min_sah(
     typename T::iterator begin,
-    typename T::iterator end
+    typename T::iterator end,
+    [[maybe_unused]] bool parallel
 ) const {
+    using Box = AABBox<typename T::float_t>;
     const auto length = std::distance(begin, end);
 
-    std::vector<AABBox<typename T::float_t>> pref(length + 1);
-    std::vector<AABBox<typename T::float_t>> suf(length + 1);
+    // bounds of small nodes are kept in thread's scratch, large nodes are rare and use own memory
+    const bool reuse = !parallel && length <= detail::max_scratch_length;
+    std::vector<Box> own_pref, own_suf;
+    auto& pref = reuse ? detail::thread_scratch<Box>(0) : own_pref;
+    auto& suf = reuse ? detail::thread_scratch<Box>(1) : own_suf;
+    pref.resize(length + 1);
+    suf.resize(length + 1);
+    pref[0] = suf[0] = Box();
 
-    typename T::iterator::difference_type i = 0;
-    for (auto it = begin, rit = std::prev(end); it != end; ++it, ++i, --rit) {
-        pref[i + 1] = pref[i] + get_bounding_box<T>(*it);
-        suf[i + 1] = suf[i] + get_bounding_box<T>(*rit);
+#ifdef RMI_INCLUDE_OMP
+    if (parallel) {
+        // prefix bounds inside chunks, then boxes of preceding chunks are added to them
+        const std::ptrdiff_t chunks = 4 * omp_get_num_threads();
+        const auto chunk = (length + chunks - 1) / chunks;
+        auto local_bounds = [&](auto first, auto last) {
+            pref[first + 1] = get_bounding_box<T>(*std::next(begin, first));
+            suf[first + 1] = get_bounding_box<T>(*std::prev(end, first + 1));
+            for (auto i = first + 1; i < last; ++i) {
+                pref[i + 1] = pref[i] + get_bounding_box<T>(*std::next(begin, i));
+                suf[i + 1] = suf[i] + get_bounding_box<T>(*std::prev(end, i + 1));
+            }
+        };
+        detail::omp_for_chunks(length, chunks, local_bounds);
+
+        std::vector<AABBox<typename T::float_t>> pref_carry(chunks + 1), suf_carry(chunks + 1);
+        for (std::ptrdiff_t c = 0; c * chunk < length; ++c) {
+            const auto last = std::min((c + 1) * chunk, length);
+            pref_carry[c + 1] = pref_carry[c] + pref[last];
+            suf_carry[c + 1] = suf_carry[c] + suf[last];
+        }
+        detail::omp_for_chunks(length, chunks, [&](auto first, auto last) {
+            const auto c = first / chunk;
+            for (auto i = first + 1; i <= last; ++i) {
+                pref[i] += pref_carry[c];
+                suf[i] += suf_carry[c];
+            }
+        });
+    } else
+#endif
+    {
+        typename T::iterator::difference_type i = 0;
+        for (auto it = begin, rit = std::prev(end); it != end; ++it, ++i, --rit) {
+            pref[i + 1] = pref[i] + get_bounding_box<T>(*it);
+            suf[i + 1] = suf[i] + get_bounding_box<T>(*rit);
+        }
     }
 
     auto mid = length;
-    auto min_sah = length * pref[length].volume();
-    for (i = 1; i < length; ++i) {
-        const auto sah = i * pref[i].volume() + (length - i) * suf[length - i].volume();
+    auto min_sah = length * pref[length].area();
+    for (typename T::iterator::difference_type i = 1; i < length; ++i) {
+        const auto sah = i * pref[i].area() + (length - i) * suf[length - i].area();
         if (sah < min_sah) {
             min_sah = sah;
             mid = i;
@@ -540,15 +1213,19 @@ typename T::iterator SAHSplitter<T>::operator()(
         return end;
     }
 
+    const bool parallel = detail::split_in_parallel(std::distance(begin, end), parallel_threshold);
+    std::vector<typename Mesh<T>::Element> buffer;
+    if (parallel) {
+        buffer.assign(begin, end);
+    }
+
     int splitting_axis = 0;
     auto min_sah = std::numeric_limits<typename T::float_t>::max();
     auto split = end;
     for (int axis = 0; axis < 3; ++axis) {
-        std::sort(begin, end, [axis](const auto& it1, const auto& it2) {
-            return it1.center[axis] < it2.center[axis];
-        });
+        detail::sort_by_axis<T>(begin, end, axis, parallel ? &buffer : nullptr);
 
-        if (const auto [mid, sah] = find_min_sah(begin, end); sah < min_sah) {
+        if (const auto [mid, sah] = find_min_sah(begin, end, parallel); sah < min_sah) {
             min_sah = sah;
             splitting_axis = axis;
             split = mid;
@@ -556,9 +1233,7 @@ typename T::iterator SAHSplitter<T>::operator()(
     }
 
     if (splitting_axis != 2) {
-        std::sort(begin, end, [splitting_axis](const auto& it1, const auto& it2) {
-            return it1.center[splitting_axis] < it2.center[splitting_axis];
-        });
+        detail::sort_by_axis<T>(begin, end, splitting_axis, parallel ? &buffer : nullptr);
     }
     return split;
 }
@@ -576,10 +1251,11 @@ typename T::iterator MedianSplitter<T>::operator()(
         return end;
     }
 
-    int axis = depth % 3;
-    std::sort(begin, end, [axis](const auto& it1, const auto& it2) {
-        return it1.center[axis] < it2.center[axis];
-    });
+    std::vector<typename Mesh<T>::Element> buffer;
+    if (detail::split_in_parallel(length, parallel_threshold)) {
+        buffer.assign(begin, end);
+    }
+    detail::sort_by_axis<T>(begin, end, depth % 3, buffer.empty() ? nullptr : &buffer);
 
     return std::next(begin, length / 2);
 }
@@ -587,52 +1263,194 @@ typename T::iterator MedianSplitter<T>::operator()(
 
 template<typename T>
 template<typename Splitter>
-std::unique_ptr<typename KDTree<T>::Node> KDTree<T>::Node::build(
+typename KDTree<T>::node_ptr KDTree<T>::Node::build(
     typename T::iterator begin,
     typename T::iterator end,
     int depth,
-    const Splitter& splitter
+    const Splitter& splitter,
+    Arena& arena
 ) {
     auto split = splitter(begin, end, depth);
     if (split == end) {
-        return std::make_unique<Node>(get_bounding_box<T>(begin, end), begin, end);
+        return node_ptr(arena.create<Node>(get_bounding_box<T>(begin, end), begin, end));
     }
 
-    auto left = build(begin, split, depth + 1, splitter);
-    auto right = build(split, end, depth + 1, splitter);
+    auto left = build(begin, split, depth + 1, splitter, arena);
+    auto right = build(split, end, depth + 1, splitter, arena);
 
-    return std::make_unique<Node>(
+    return node_ptr(arena.create<Node>(
         left->box() + right->box(),
         std::move(left), std::move(right)
-    );
+    ));
 }
 
 #ifdef RMI_INCLUDE_OMP
 template<typename T>
 template<typename Splitter>
-std::unique_ptr<typename KDTree<T>::Node> KDTree<T>::Node::omp_build(
+typename KDTree<T>::node_ptr KDTree<T>::Node::omp_build(
     typename T::iterator begin,
     typename T::iterator end,
     int depth,
-    const Splitter& splitter
+    const Splitter& splitter,
+    Arena& arena
 ) {
+    if (std::distance(begin, end) < detail::sequential_build_cutoff) {
+        return build(begin, end, depth, splitter, arena);
+    }
+
     auto split = splitter(begin, end, depth);
     if (split == end) {
-        return std::make_unique<typename KDTree<T>::Node>(get_bounding_box<T>(begin, end), begin, end);
+        return node_ptr(arena.create<Node>(get_bounding_box<T>(begin, end), begin, end));
     }
-    std::unique_ptr<typename KDTree<T>::Node> left;
-    std::unique_ptr<typename KDTree<T>::Node> right;
+    node_ptr left;
+    node_ptr right;
 
-    #pragma omp task shared(left)
-    left = omp_build(begin, split, depth + 1, splitter);
-    #pragma omp task shared(right)
-    right = omp_build(split, end, depth + 1, splitter);
+    #pragma omp task shared(left, arena)
+    left = omp_build(begin, split, depth + 1, splitter, arena);
+    #pragma omp task shared(right, arena)
+    right = omp_build(split, end, depth + 1, splitter, arena);
     #pragma omp taskwait
 
-    return std::make_unique<typename KDTree<T>::Node>(
+    return node_ptr(arena.create<Node>(
         left->box() + right->box(),
         std::move(left), std::move(right)
-    );
+    ));
+}
+#endif
+
+
+template<typename T>
+void KDTree<T>::Node::refit(Mesh<T>& mesh) {
+    if (is_leaf()) {
+        mesh.update(m_begin, m_end);
+        bounding_box = get_bounding_box<T>(m_begin, m_end);
+        return;
+    }
+
+    m_left->refit(mesh);
+    m_right->refit(mesh);
+    bounding_box = m_left->box() + m_right->box();
+}
+
+template<typename T>
+template<typename Splitter>
+void KDTree<T>::Node::rebuild_degraded(
+    int depth,
+    typename T::float_t max_overlap,
+    const Splitter& splitter,
+    Arena& arena
+) {
+    if (is_leaf()) {
+        return;
+    }
+
+    if (m_left->box().overlap(m_right->box()) > max_overlap * bounding_box.volume()) {
+        release(std::move(m_left), arena);
+        release(std::move(m_right), arena);
+        replace(build(m_begin, m_end, depth, splitter, arena), arena);
+    } else {
+        m_left->rebuild_degraded(depth + 1, max_overlap, splitter, arena);
+        m_right->rebuild_degraded(depth + 1, max_overlap, splitter, arena);
+    }
+}
+
+template<typename T>
+void KDTree<T>::Node::release(node_ptr&& node, Arena& arena) {
+    if (!node) {
+        return;
+    }
+    release(std::move(node->m_left), arena);
+    release(std::move(node->m_right), arena);
+    arena.destroy(node.release());
+}
+
+template<typename T>
+void KDTree<T>::Node::replace(node_ptr&& rebuilt, Arena& arena) {
+    // children of the old node must be released before, only the rebuilt root is left
+    *this = std::move(*rebuilt);
+    arena.destroy(rebuilt.release());
+}
+
+template<typename T>
+inline void KDTree<T>::refit(Mesh<T>& mesh) {
+    root->refit(mesh);
+}
+
+template<typename T>
+template<typename Splitter>
+inline void KDTree<T>::refit(
+    Mesh<T>& mesh,
+    typename T::float_t max_overlap,
+    const Splitter& splitter
+) {
+    root->refit(mesh);
+    root->rebuild_degraded(0, max_overlap, splitter, *arena);
+}
+
+#ifdef RMI_INCLUDE_OMP
+template<typename T>
+void KDTree<T>::Node::omp_refit(Mesh<T>& mesh) {
+    if (is_leaf()) {
+        mesh.update(m_begin, m_end);
+        bounding_box = get_bounding_box<T>(m_begin, m_end);
+        return;
+    }
+
+    #pragma omp task shared(mesh)
+    m_left->omp_refit(mesh);
+    #pragma omp task shared(mesh)
+    m_right->omp_refit(mesh);
+    #pragma omp taskwait
+
+    bounding_box = m_left->box() + m_right->box();
+}
+
+template<typename T>
+template<typename Splitter>
+void KDTree<T>::Node::omp_rebuild_degraded(
+    int depth,
+    typename T::float_t max_overlap,
+    const Splitter& splitter,
+    Arena& arena
+) {
+    if (is_leaf()) {
+        return;
+    }
+
+    if (m_left->box().overlap(m_right->box()) > max_overlap * bounding_box.volume()) {
+        release(std::move(m_left), arena);
+        release(std::move(m_right), arena);
+        replace(omp_build(m_begin, m_end, depth, splitter, arena), arena);
+    } else {
+        #pragma omp task shared(arena)
+        m_left->omp_rebuild_degraded(depth + 1, max_overlap, splitter, arena);
+        #pragma omp task shared(arena)
+        m_right->omp_rebuild_degraded(depth + 1, max_overlap, splitter, arena);
+        #pragma omp taskwait
+    }
+}
+
+template<typename T>
+inline void KDTree<T>::refit(Mesh<T>& mesh, int threads_count) {
+    #pragma omp parallel num_threads(threads_count) shared(mesh)
+    #pragma omp single
+    root->omp_refit(mesh);
+}
+
+template<typename T>
+template<typename Splitter>
+inline void KDTree<T>::refit(
+    Mesh<T>& mesh,
+    int threads_count,
+    typename T::float_t max_overlap,
+    const Splitter& splitter
+) {
+    #pragma omp parallel num_threads(threads_count) shared(mesh)
+    #pragma omp single
+    {
+        root->omp_refit(mesh);
+        root->omp_rebuild_degraded(0, max_overlap, splitter, *arena);
+    }
 }
 #endif
 
@@ -641,27 +1459,38 @@ std::unique_ptr<typename KDTree<T>::Node> KDTree<T>::Node::omp_build(
 template<typename float_t>
 inline Vector3<float_t> Ray<float_t>::at(float_t t) const {
     return Vector3<float_t>(
-        origin.x() + vector.x() * t,
-        origin.y() + vector.y() * t,
-        origin.z() + vector.z() * t
+        m_origin.x() + m_direction.x() * t,
+        m_origin.y() + m_direction.y() * t,
+        m_origin.z() + m_direction.z() * t
     );
 }
 
 template<typename float_t>
-Ray<float_t>::Ray(Vector3<float_t> origin, Vector3<float_t> direction):
-    origin(origin),
-    vector(direction.ort())
+Ray<float_t>::Ray(Vector3<float_t> origin, Vector3<float_t> direction, float_t t_min, float_t t_max):
+    m_origin(origin),
+    m_direction(direction.ort()),
+    m_t_min(t_min),
+    m_t_max(t_max)
 {
-    inv_vector = Vector3<float_t>(
-        1.0 / vector.x(),
-        1.0 / vector.y(),
-        1.0 / vector.z()
+    m_inv_direction = Vector3<float_t>(
+        1.0 / m_direction.x(),
+        1.0 / m_direction.y(),
+        1.0 / m_direction.z()
     );
 }
 
+template<typename float_t>
+inline Ray<float_t> Ray<float_t>::segment(const Vector3<float_t>& from, const Vector3<float_t>& to) {
+    const auto direction = to - from;
+    return Ray(from, direction, 0, direction.length());
+}
+
 /*
  * Read for details:
  * https://en.wikipedia.org/wiki/M%C3%B6ller%E2%80%93Trumbore_intersection_algorithm
+ *
+ * Vertices are converted to the ray's precision first, so triangles
+ * stored in float can be tested in double.
  */
 template<typename float_t>
 template<typename T>
@@ -669,9 +1498,13 @@ std::optional<Vector3<float_t>> Ray<float_t>::intersects(
     const typename Mesh<T>::Element& triangle,
     float_t epsilon
 ) const {
-    Vector3 edge1 = triangle.v2 - triangle.v1;
-    Vector3 edge2 = triangle.v3 - triangle.v1;
-    Vector3 ray_cross_e2 = vector.cross(edge2);
+    const Vector3<float_t> v1(triangle.v1);
+    const Vector3<float_t> v2(triangle.v2);
+    const Vector3<float_t> v3(triangle.v3);
+
+    Vector3 edge1 = v2 - v1;
+    Vector3 edge2 = v3 - v1;
+    Vector3 ray_cross_e2 = m_direction.cross(edge2);
 
     float_t det = edge1.dot(ray_cross_e2);
     if (-epsilon <= det && det <= epsilon) {
@@ -679,20 +1512,20 @@ std::optional<Vector3<float_t>> Ray<float_t>::intersects(
     }
     float_t inv_det = 1.0 / det;
 
-    Vector3 s = origin - triangle.v1;
+    Vector3 s = m_origin - v1;
     float_t u = inv_det * s.dot(ray_cross_e2);
     if (u < 0.0 || u > 1.0) {
         return std::nullopt;
     }
 
     Vector3 s_cross_e1 = s.cross(edge1);
-    float_t v = inv_det * vector.dot(s_cross_e1);
+    float_t v = inv_det * m_direction.dot(s_cross_e1);
     if (v < 0.0 || u + v > 1.0) {
         return std::nullopt;
     }
 
     float_t t = inv_det * edge2.dot(s_cross_e1);
-    if (t <= epsilon) {
+    if (t <= epsilon || t < m_t_min || t > m_t_max) {
         return std::nullopt;
     }
 
@@ -701,46 +1534,310 @@ std::optional<Vector3<float_t>> Ray<float_t>::intersects(
 
 
 template<typename float_t>
-template<typename T>
+template<typename T, typename Node, typename Visitor>
+void Ray<float_t>::intersects_leaf(const Node& leaf, float_t epsilon, Visitor&& visitor) const {
+#ifdef RMI_SIMD128
+    if constexpr (std::is_same_v<float_t, float>) {
+        // triangles are gathered by 4, the rest of lanes stays degenerate and never hits
+        const float origin[3] = {m_origin.x(), m_origin.y(), m_origin.z()};
+        const float direction[3] = {m_direction.x(), m_direction.y(), m_direction.z()};
+        const typename Mesh<T>::Element* batch[4];
+        auto test = [&](int count) {
+            simd::Triangles4 triangles = {};
+            simd::float4 v2[3] = {}, v3[3] = {};
+            for (int i = 0; i < count; ++i) {
+                const Vector3<float> a(batch[i]->v1), b(batch[i]->v2), c(batch[i]->v3);
+                for (int axis = 0; axis < 3; ++axis) {
+                    triangles.v1[axis][i] = a[axis];
+                    v2[axis][i] = b[axis];
+                    v3[axis][i] = c[axis];
+                }
+            }
+            for (int axis = 0; axis < 3; ++axis) {
+                triangles.edge1[axis] = v2[axis] - triangles.v1[axis];
+                triangles.edge2[axis] = v3[axis] - triangles.v1[axis];
+            }
+
+            simd::float4 t;
+            const auto mask = simd::intersect(origin, direction, triangles, epsilon, m_t_min, m_t_max, t);
+            if (!simd::any(mask)) {
+                return;
+            }
+            for (int i = 0; i < count; ++i) {
+                if (mask[i]) {
+                    auto intersection = at(t[i]);
+                    visitor(*batch[i], intersection);
+                }
+            }
+        };
+
+        int count = 0;
+        for (const auto& triangle : leaf) {
+            batch[count++] = &triangle;
+            if (count == 4) {
+                test(count);
+                count = 0;
+            }
+        }
+        if (count > 0) {
+            test(count);
+        }
+        return;
+    }
+#endif
+    for (const auto& triangle : leaf) {
+        if (auto intersection = intersects<T>(triangle, epsilon); intersection) {
+            visitor(triangle, *intersection);
+        }
+    }
+}
+
+template<typename float_t>
+template<typename T, typename Node>
 void Ray<float_t>::recursive_intersects(
-    const typename KDTree<T>::Node& node,
+    const Node& node,
     std::vector<Vector3<float_t>>& output,
-    float_t epsilon
+    float_t epsilon,
+    [[maybe_unused]] size_t depth
 ) const {
+    RMI_STATS(auto& counters = traversal::current());
+    RMI_STATS(++counters.nodes_visited);
+    RMI_STATS(counters.max_stack_depth = std::max(counters.max_stack_depth, depth));
+
     if (node.is_leaf()) {
-        for (const auto& triangle : node) {
-            if (auto intersection = intersects<T>(triangle, epsilon); intersection) {
-                output.push_back(std::move(*intersection));
+        RMI_STATS(counters.triangle_tests += std::distance(node.begin(), node.end()));
+        intersects_leaf<T>(node, epsilon, [&](const auto& triangle, Vector3<float_t>& intersection) {
+            if (node.accepts(triangle, intersection)) {
+                RMI_STATS(++counters.hits);
+                output.push_back(std::move(intersection));
             }
-        }
+        });
     } else {
+        RMI_STATS(counters.box_tests += 2);
         if (is_intersects(node.left().box())) {
-            recursive_intersects<T>(node.left(), output, epsilon);
+            recursive_intersects<T>(node.left(), output, epsilon, depth + 1);
         }
         if (is_intersects(node.right().box())) {
-            recursive_intersects<T>(node.right(), output, epsilon);
+            recursive_intersects<T>(node.right(), output, epsilon, depth + 1);
         }
     }
 }
 
 
 template<typename float_t>
-template<typename T>
+template<typename Tree, typename T>
 std::vector<Vector3<float_t>> Ray<float_t>::intersects(
-    const KDTree<T>& tree,
+    const Tree& tree,
+    float_t epsilon
+) const {
+    std::vector<Vector3<float_t>> output;
+    intersects(tree, output, epsilon);
+    return output;
+}
+
+template<typename float_t>
+template<typename Tree, typename T>
+void Ray<float_t>::intersects(
+    const Tree& tree,
+    std::vector<Vector3<float_t>>& output,
     float_t epsilon
 ) const {
     const auto& node = tree.top();
+    RMI_STATS(++traversal::current().rays);
+    RMI_STATS(++traversal::current().box_tests);
     if (!is_intersects(node.box())) {
-        return {};
+        return;
     }
 
-    std::vector<Vector3<float_t>> output;
     recursive_intersects<T>(node, output, epsilon);
-    return output;
 }
 
 
+template<typename float_t>
+template<typename T>
+inline std::optional<float_t> Ray<float_t>::crosses(
+    const typename Mesh<T>::Element& triangle,
+    float_t epsilon,
+    bool& near_edge
+) const {
+    // relative to barycentric coordinates, which are scale-free
+    constexpr float_t tolerance = 64 * std::numeric_limits<float_t>::epsilon();
+
+    const Vector3<float_t> v1(triangle.v1);
+    const Vector3<float_t> v2(triangle.v2);
+    const Vector3<float_t> v3(triangle.v3);
+
+    const auto edge1 = v2 - v1;
+    const auto edge2 = v3 - v1;
+    const auto ray_cross_e2 = m_direction.cross(edge2);
+
+    const float_t det = edge1.dot(ray_cross_e2);
+    if (-epsilon <= det && det <= epsilon) {
+        return std::nullopt;
+    }
+    const float_t inv_det = 1.0 / det;
+
+    const auto s = m_origin - v1;
+    const float_t u = inv_det * s.dot(ray_cross_e2);
+    if (u < -tolerance || u > 1 + tolerance) {
+        return std::nullopt;
+    }
+
+    const auto s_cross_e1 = s.cross(edge1);
+    const float_t v = inv_det * m_direction.dot(s_cross_e1);
+    if (v < -tolerance || u + v > 1 + tolerance) {
+        return std::nullopt;
+    }
+
+    const float_t t = inv_det * edge2.dot(s_cross_e1);
+    if (t <= epsilon || t < m_t_min || t > m_t_max) {
+        return std::nullopt;
+    }
+
+    if (u <= tolerance || v <= tolerance || u + v >= 1 - tolerance) {
+        near_edge = true;
+    }
+    if (u < 0 || v < 0 || u + v > 1) {
+        return std::nullopt;
+    }
+    return t;
+}
+
+template<typename float_t>
+template<typename T, typename Node>
+void Ray<float_t>::recursive_count(
+    const Node& node,
+    Crossings& crossings,
+    float_t epsilon,
+    [[maybe_unused]] size_t depth
+) const {
+    RMI_STATS(auto& counters = traversal::current());
+    RMI_STATS(++counters.nodes_visited);
+    RMI_STATS(counters.max_stack_depth = std::max(counters.max_stack_depth, depth));
+
+    if (node.is_leaf()) {
+        for (const auto& triangle : node) {
+            RMI_STATS(++counters.triangle_tests);
+            if (const auto t = crosses<T>(triangle, epsilon, crossings.degenerate); t && node.accepts(triangle, at(*t))) {
+                RMI_STATS(++counters.hits);
+                ++crossings.count;
+            }
+        }
+    } else {
+        RMI_STATS(counters.box_tests += 2);
+        if (is_intersects(node.left().box())) {
+            recursive_count<T>(node.left(), crossings, epsilon, depth + 1);
+        }
+        if (is_intersects(node.right().box())) {
+            recursive_count<T>(node.right(), crossings, epsilon, depth + 1);
+        }
+    }
+}
+
+template<typename float_t>
+template<typename Tree, typename T>
+Crossings Ray<float_t>::count_intersections(const Tree& tree, float_t epsilon) const {
+    Crossings crossings;
+    const auto& node = tree.top();
+    RMI_STATS(++traversal::current().rays);
+    RMI_STATS(++traversal::current().box_tests);
+    if (is_intersects(node.box())) {
+        recursive_count<T>(node, crossings, epsilon);
+    }
+    return crossings;
+}
+
+
+template<typename float_t>
+template<typename T, typename Node>
+void Ray<float_t>::recursive_closest(
+    const Node& node,
+    std::optional<Vector3<float_t>>& closest,
+    float_t epsilon,
+    [[maybe_unused]] size_t depth
+) {
+    RMI_STATS(auto& counters = traversal::current());
+    RMI_STATS(++counters.nodes_visited);
+    RMI_STATS(counters.max_stack_depth = std::max(counters.max_stack_depth, depth));
+
+    if (node.is_leaf()) {
+        RMI_STATS(counters.triangle_tests += std::distance(node.begin(), node.end()));
+        intersects_leaf<T>(node, epsilon, [&](const auto& triangle, Vector3<float_t>& intersection) {
+            const float_t t = (intersection - m_origin).dot(m_direction);
+            if (t <= m_t_max && node.accepts(triangle, intersection)) {
+                RMI_STATS(++counters.hits);
+                m_t_max = t;
+                closest = intersection;
+            }
+        });
+        return;
+    }
+
+    RMI_STATS(counters.box_tests += 2);
+    const auto left = intersects(node.left().box());
+    const auto right = intersects(node.right().box());
+    const bool right_first = right.first < left.first;
+    const auto& near = right_first ? node.right() : node.left();
+    const auto& far = right_first ? node.left() : node.right();
+    const auto near_box = right_first ? right : left;
+    const auto far_box = right_first ? left : right;
+
+    if (near_box.first <= near_box.second) {
+        recursive_closest<T>(near, closest, epsilon, depth + 1);
+    }
+    // hits in the near child may have moved t_max before the far box
+    if (far_box.first <= std::min(far_box.second, m_t_max)) {
+        recursive_closest<T>(far, closest, epsilon, depth + 1);
+    }
+}
+
+template<typename float_t>
+template<typename Tree, typename T>
+std::optional<Vector3<float_t>> Ray<float_t>::closest_intersection(const Tree& tree, float_t epsilon) const {
+    std::optional<Vector3<float_t>> closest;
+    const auto& node = tree.top();
+    RMI_STATS(++traversal::current().rays);
+    RMI_STATS(++traversal::current().box_tests);
+    if (is_intersects(node.box())) {
+        Ray limited(*this);
+        limited.template recursive_closest<T>(node, closest, epsilon);
+    }
+    return closest;
+}
+
+template<typename float_t>
+template<typename T, typename Node>
+bool Ray<float_t>::recursive_any(const Node& node, float_t epsilon, [[maybe_unused]] size_t depth) const {
+    RMI_STATS(auto& counters = traversal::current());
+    RMI_STATS(++counters.nodes_visited);
+    RMI_STATS(counters.max_stack_depth = std::max(counters.max_stack_depth, depth));
+
+    if (node.is_leaf()) {
+        bool found = false;
+        RMI_STATS(counters.triangle_tests += std::distance(node.begin(), node.end()));
+        intersects_leaf<T>(node, epsilon, [&](const auto& triangle, const Vector3<float_t>& intersection) {
+            if (!found && node.accepts(triangle, intersection)) {
+                RMI_STATS(++counters.hits);
+                found = true;
+            }
+        });
+        return found;
+    }
+
+    RMI_STATS(counters.box_tests += 2);
+    return (is_intersects(node.left().box()) && recursive_any<T>(node.left(), epsilon, depth + 1)) ||
+        (is_intersects(node.right().box()) && recursive_any<T>(node.right(), epsilon, depth + 1));
+}
+
+template<typename float_t>
+template<typename Tree, typename T>
+bool Ray<float_t>::intersects_any(const Tree& tree, float_t epsilon) const {
+    const auto& node = tree.top();
+    RMI_STATS(++traversal::current().rays);
+    RMI_STATS(++traversal::current().box_tests);
+    return is_intersects(node.box()) && recursive_any<T>(node, epsilon);
+}
+
 /*
  * Simple iterative intersection search
  */
@@ -763,19 +1860,33 @@ std::vector<Vector3<float_t>> Ray<float_t>::intersects(
 
 template<typename float_t>
 inline std::pair<float_t, float_t> Ray<float_t>::intersects(const AABBox<float_t>& box) const {
-    Vector3 t1 = (box.min - origin) * inv_vector;
-    Vector3 t2 = (box.max - origin) * inv_vector;
+#ifdef RMI_SIMD128
+    if constexpr (std::is_same_v<float_t, float>) {
+        return simd::slabs(
+            simd::float4{m_origin.x(), m_origin.y(), m_origin.z(), 0},
+            simd::float4{m_inv_direction.x(), m_inv_direction.y(), m_inv_direction.z(), 0},
+            simd::float4{box.min.x(), box.min.y(), box.min.z(), 0},
+            simd::float4{box.max.x(), box.max.y(), box.max.z(), 0},
+            m_t_min,
+            m_t_max
+        );
+    }
+#endif
+    Vector3 t1 = (box.min - m_origin) * m_inv_direction;
+    Vector3 t2 = (box.max - m_origin) * m_inv_direction;
 
     return std::make_pair(
         std::max({
             std::min(t1.x(), t2.x()),
             std::min(t1.y(), t2.y()),
-            std::min(t1.z(), t2.z())
+            std::min(t1.z(), t2.z()),
+            m_t_min
         }),
         std::min({
             std::max(t1.x(), t2.x()),
             std::max(t1.y(), t2.y()),
-            std::max(t1.z(), t2.z())
+            std::max(t1.z(), t2.z()),
+            m_t_max
         })
     );
 }
@@ -783,18 +1894,17 @@ inline std::pair<float_t, float_t> Ray<float_t>::intersects(const AABBox<float_t
 template<typename float_t>
 inline bool Ray<float_t>::is_intersects(const AABBox<float_t>& box) const {
     auto [tmin, tmax] = intersects(box);
-    return tmax >= 0.0 && tmin <= tmax;
+    return tmin <= tmax;
 }
 
 #ifdef RMI_INCLUDE_POOL
 namespace parallel {
 
-template<typename T>
+template<typename Tree, typename float_t>
 class ThreadPool {
 public:
-    using Node = typename KDTree<T>::Node;
-    using float_t = typename T::float_t;
-    using index_t = typename T::index_t;
+    using T = typename Tree::mesh_type;
+    using Node = typename Tree::Node;
 
     ThreadPool(
         const Ray<float_t>& ray,
@@ -804,6 +1914,7 @@ public:
         threads(threads_count), queues(threads_count), results(threads_count),
         counter(0), threads_count(threads_count), ray(ray)
     {
+        RMI_STATS(thread_stats.resize(threads_count));
         distribute_load(root);
 
         for (int i = 0; i < threads_count; ++i) {
@@ -816,6 +1927,7 @@ public:
         for (int id = 0; id < threads_count; ++id) {
             threads[id].join();
             std::copy(results[id].begin(), results[id].end(), std::back_inserter(result));
+            RMI_STATS(traversal::current() += thread_stats[id]);
         }
         return result;
     }
@@ -844,19 +1956,24 @@ private:
     }
 
     void worker_thread(int thread_id) {
+        RMI_STATS(auto& local = thread_stats[thread_id]);
         std::optional<const Node*> next = pop_node(thread_id);
 
         while(next) {
             auto cur = *next;
+            RMI_STATS(++local.nodes_visited);
 
             if (cur->is_leaf()) {
-                for (const auto& triangle : *cur) {
-                    if (auto intersection = ray.template intersects<T>(triangle); intersection) {
-                        results[thread_id].push_back(std::move(*intersection));
+                RMI_STATS(local.triangle_tests += std::distance(cur->begin(), cur->end()));
+                ray.template intersects_leaf<T>(*cur, std::numeric_limits<float_t>::epsilon(), [&](const auto& triangle, Vector3<float_t>& intersection) {
+                    if (cur->accepts(triangle, intersection)) {
+                        RMI_STATS(++local.hits);
+                        results[thread_id].push_back(std::move(intersection));
                     }
-                }
+                });
                 next = pop_node(thread_id);
             } else {
+                RMI_STATS(local.box_tests += 2);
                 bool intersects_left  = ray.is_intersects(cur->left().box());
                 bool intersects_right = ray.is_intersects(cur->right().box());
 
@@ -867,6 +1984,7 @@ private:
                 case 0b11:
                     next = &cur->left();
                     queues[thread_id].push(&cur->right());
+                    RMI_STATS(local.max_stack_depth = std::max(local.max_stack_depth, queues[thread_id].size()));
                     break;
                 }
             }
@@ -876,6 +1994,8 @@ private:
     std::vector<std::thread> threads;
     std::vector<WorkStealingQueue<const Node*>> queues;
     std::vector<std::vector<Vector3<float_t>>> results;
+    // work of every thread, added to caller's counters in wait_result
+    RMI_STATS(std::vector<TraversalStats> thread_stats;)
 
     std::atomic_int counter;
     int threads_count;
@@ -883,21 +2003,163 @@ private:
     const Ray<float_t>& ray;
 };
 
+
+// Runs tasks, that may spawn more tasks, on threads with work-stealing queues
+class TaskPool {
+public:
+    // Task gets id of thread running it
+    using Task = std::function<void(int)>;
+
+    explicit TaskPool(int threads_count): queues(threads_count), pending(0), threads_count(threads_count) {}
+
+    // Runs task on calling thread and threads_count - 1 new ones, returns when all spawned tasks are finished
+    void run(Task task) {
+        pending = 1;
+        queues[0].push(new Task(std::move(task)));
+
+        std::vector<std::thread> threads;
+        for (int i = 1; i < threads_count; ++i) {
+            threads.emplace_back(&TaskPool::worker_thread, this, i);
+        }
+        worker_thread(0);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    // Called by running task with its thread id, new task may be stolen by other threads
+    void spawn(int thread_id, Task task) {
+        ++pending;
+        queues[thread_id].push(new Task(std::move(task)));
+    }
+private:
+    void worker_thread(int thread_id) {
+        while (pending > 0) {
+            auto next = queues[thread_id].pop();
+            for (int i = 1; !next && i < threads_count; ++i) {
+                next = queues[(thread_id + i) % threads_count].steal();
+            }
+            if (!next) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            std::unique_ptr<Task> task(*next);
+            (*task)(thread_id);
+            // tasks spawned by this one are already counted
+            --pending;
+        }
+    }
+
+    std::vector<WorkStealingQueue<Task*>> queues;
+    std::atomic_size_t pending;
+    int threads_count;
+};
+
+template<typename F>
+void pool_for_range(TaskPool& pool, int thread_id, size_t begin, size_t end, size_t grain, const F& f) {
+    // halves are given away, so idle threads steal big ranges first
+    while (end - begin > grain) {
+        const auto middle = begin + (end - begin) / 2;
+        pool.spawn(thread_id, [&pool, middle, end, grain, &f](int thread_id) {
+            pool_for_range(pool, thread_id, middle, end, grain, f);
+        });
+        end = middle;
+    }
+    for (auto i = begin; i < end; ++i) {
+        f(i);
+    }
+}
+
+// Calls f(i) for every i from 0 to count, ranges of at most grain indices run on one thread
+template<typename F>
+void pool_for(int threads_count, size_t count, size_t grain, const F& f) {
+    TaskPool pool(std::max(1, threads_count));
+    pool.run([&](int thread_id) {
+        pool_for_range(pool, thread_id, 0, count, std::max<size_t>(grain, 1), f);
+    });
+}
+
 } // namespace parallel
 
 
-template<typename float_t>
 template<typename T>
+template<typename Splitter>
+inline KDTree<T> KDTree<T>::pool_for_mesh(
+    Mesh<T>& mesh,
+    int threads_count,
+    const Splitter& splitter,
+    ArenaOptions arena_options
+) {
+    const auto start = std::chrono::steady_clock::now();
+    std::atomic<long long> splitting(0);
+    const TimedSplitter<Splitter> timed(splitter, splitting);
+    // a tree of n triangles has less than 2n nodes
+    const auto triangles = static_cast<size_t>(std::distance(mesh.begin(), mesh.end()));
+    auto arena = std::make_unique<Arena>(arena_options.sized_for(2 * triangles, sizeof(Node)));
+
+    node_ptr root;
+    parallel::TaskPool pool(std::max(1, threads_count));
+    pool.run([&](int thread_id) {
+        Node::pool_build(pool, thread_id, mesh.begin(), mesh.end(), 0, timed, *arena, root, nullptr);
+    });
+
+    const std::chrono::duration<double> total = std::chrono::steady_clock::now() - start;
+    return KDTree<T>(std::move(arena), std::move(root), {total.count(), splitting.load() * 1e-9});
+}
+
+template<typename T>
+template<typename Splitter>
+void KDTree<T>::Node::pool_build(
+    parallel::TaskPool& pool,
+    int thread_id,
+    typename T::iterator begin,
+    typename T::iterator end,
+    int depth,
+    const Splitter& splitter,
+    Arena& arena,
+    node_ptr& output,
+    PoolJoin* parent
+) {
+    if (std::distance(begin, end) < detail::sequential_build_cutoff) {
+        output = build(begin, end, depth, splitter, arena);
+    } else if (auto split = splitter(begin, end, depth); split == end) {
+        output = node_ptr(arena.create<Node>(get_bounding_box<T>(begin, end), begin, end));
+    } else {
+        auto join = new PoolJoin{nullptr, nullptr, {2}, output, parent};
+        pool.spawn(thread_id, [&pool, &arena, split, end, depth, splitter, join](int thread_id) {
+            pool_build(pool, thread_id, split, end, depth + 1, splitter, arena, join->right, join);
+        });
+        // the node is finished by whichever child completes last
+        pool_build(pool, thread_id, begin, split, depth + 1, splitter, arena, join->left, join);
+        return;
+    }
+
+    while (parent && --parent->remaining == 0) {
+        parent->output = node_ptr(arena.create<Node>(
+            parent->left->box() + parent->right->box(),
+            std::move(parent->left), std::move(parent->right)
+        ));
+        std::unique_ptr<PoolJoin> finished(parent);
+        parent = finished->parent;
+    }
+}
+
+
+template<typename float_t>
+template<typename Tree, typename T>
 std::vector<Vector3<float_t>> Ray<float_t>::pool_intersects(
-    const KDTree<T>& tree,
+    const Tree& tree,
     int threads_count
 ) const {
     const auto& root = tree.top();
+    RMI_STATS(++traversal::current().rays);
+    RMI_STATS(++traversal::current().box_tests);
     if (!is_intersects(root.box())) {
         return {};
     }
 
-    parallel::ThreadPool<T> pool(*this, &root, threads_count);
+    parallel::ThreadPool<Tree, float_t> pool(*this, &root, threads_count);
     return pool.wait_result();
 }
 
@@ -926,53 +2188,68 @@ std::vector<Vector3<float_t>> Ray<float_t>::omp_intersects(
     return intersections;
 }
 
-template<typename T>
+template<typename T, typename Node, typename float_t>
 void omp_recursive_intersects(
-    const Ray<typename T::float_t>& ray,
-    const typename KDTree<T>::Node& node,
-    std::vector<Vector3<typename T::float_t>>& output,
-    double epsilon
+    const Ray<float_t>& ray,
+    const Node& node,
+    std::vector<Vector3<float_t>>& output,
+    float_t epsilon,
+    [[maybe_unused]] size_t depth = 1
 ) {
+    RMI_STATS(auto& counters = traversal::current());
+    RMI_STATS(++counters.nodes_visited);
+    RMI_STATS(counters.max_stack_depth = std::max(counters.max_stack_depth, depth));
+
     if (node.is_leaf()) {
-        for (const auto& cur : node) {
-            if (auto intersection = ray.template intersects<T>(cur, epsilon); intersection) {
+        RMI_STATS(counters.triangle_tests += std::distance(node.begin(), node.end()));
+        ray.template intersects_leaf<T>(node, epsilon, [&](const auto& cur, Vector3<float_t>& intersection) {
+            if (node.accepts(cur, intersection)) {
+                RMI_STATS(++counters.hits);
                 #pragma omp critical
-                output.push_back(std::move(*intersection));
+                output.push_back(std::move(intersection));
             }
-        }
+        });
     } else {
+        RMI_STATS(counters.box_tests += 2);
         if (ray.is_intersects(node.left().box())) {
             #pragma omp task shared(output, node)
-            omp_recursive_intersects<T>(ray, node.left(), output, epsilon);
+            omp_recursive_intersects<T>(ray, node.left(), output, epsilon, depth + 1);
         }
 
         if (ray.is_intersects(node.right().box())) {
             #pragma omp task shared(output, node)
-            omp_recursive_intersects<T>(ray, node.right(), output, epsilon);
+            omp_recursive_intersects<T>(ray, node.right(), output, epsilon, depth + 1);
         }
     }
 }
 
 
 template<typename float_t>
-template<typename T>
+template<typename Tree, typename T>
 std::vector<Vector3<float_t>> Ray<float_t>::omp_intersects(
-    const KDTree<T>& tree,
+    const Tree& tree,
     int threads_count,
     float_t epsilon
 ) const {
     const auto& root = tree.top();
+    RMI_STATS(++traversal::current().rays);
+    RMI_STATS(++traversal::current().box_tests);
     if (!is_intersects(root.box())) {
         return {};
     }
 
     std::vector<Vector3<float_t>> output;
+    RMI_STATS(std::vector<TraversalStats> slots(threads_count));
 
     #pragma omp parallel shared(output, root) num_threads(threads_count)
-    #pragma omp single
-    omp_recursive_intersects<T>(*this, root, output, epsilon);
-    #pragma omp taskwait
+    {
+        // tasks are finished at the barrier ending single, before counters are restored
+        RMI_STATS(traversal::Redirect redirect(slots[omp_get_thread_num()]));
+        #pragma omp single
+        omp_recursive_intersects<T>(*this, root, output, epsilon);
+    }
 
+    RMI_STATS(for (const auto& slot : slots) traversal::current() += slot);
     return output;
 }
 
@@ -0,0 +1,339 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "rmi.hpp"
+
+
+namespace rmi {
+
+// Affine transform: linear part (row-major 3x3 matrix) followed by translation
+template<typename T>
+class Transform {
+public:
+    Transform();
+    Transform(std::array<T, 9> linear, Vector3<T> translation);
+
+    static Transform translation(Vector3<T> offset);
+    static Transform scaling(Vector3<T> factors);
+    static Transform rotation(Vector3<T> axis, T angle);
+
+    // Composition, rhs is applied first
+    Transform operator*(const Transform& rhs) const;
+    Transform inverse() const;
+
+    template<typename U>
+    Vector3<U> point(const Vector3<U>& p) const;
+
+    template<typename U>
+    Vector3<U> vector(const Vector3<U>& v) const;
+
+    // Box bounding transformed box
+    AABBox<T> box(const AABBox<T>& box) const;
+private:
+    std::array<T, 9> m;
+    Vector3<T> t;
+};
+
+
+template<typename float_t>
+struct InstanceHit {
+    Vector3<float_t> point;
+    size_t           instance;
+};
+
+
+/*
+ * Two-level hierarchy: top-level tree over instances, each referencing shared
+ * bottom-level KDTree and affine transform. Rays are transformed into object
+ * space of every instance they reach, so memory and build time depend on
+ * unique geometry only.
+ *
+ * Scene doesn't own referenced trees, they (and their meshes) must outlive it.
+ */
+template<typename T>
+class Scene {
+public:
+    using float_t = typename T::float_t;
+
+    struct Instance {
+        const KDTree<T>*   tree;
+        Transform<float_t> transform;
+        Transform<float_t> inverse;
+        // bounds in world space
+        AABBox<float_t>    box;
+    };
+
+    // Returns id of instance reported in hits. build() should be called after adding instances.
+    size_t add(const KDTree<T>& tree, const Transform<float_t>& transform);
+
+    // Builds top-level tree
+    void build();
+
+    template<typename ray_float_t>
+    std::vector<InstanceHit<ray_float_t>> intersects(
+        const Ray<ray_float_t>& ray,
+        ray_float_t epsilon = std::numeric_limits<ray_float_t>::epsilon()
+    ) const;
+
+    inline const std::vector<Instance>& instances() const { return m_instances; }
+private:
+    struct Node {
+        AABBox<float_t> box;
+        // index of right child for internal node, first instance position in order for leaf
+        uint32_t first;
+        // instances count in leaf, zero for internal node
+        uint32_t count;
+    };
+
+    static constexpr uint32_t leaf_size = 2;
+
+    uint32_t build(uint32_t begin, uint32_t end);
+
+    template<typename ray_float_t>
+    void recursive_intersects(
+        const Ray<ray_float_t>& ray,
+        uint32_t index,
+        std::vector<InstanceHit<ray_float_t>>& output,
+        ray_float_t epsilon
+    ) const;
+
+    std::vector<Instance> m_instances;
+    std::vector<uint32_t> order;
+    std::vector<Node>     nodes;
+};
+
+
+// Transform implementation
+template<typename T>
+Transform<T>::Transform(): m({1, 0, 0, 0, 1, 0, 0, 0, 1}), t(0, 0, 0) {
+}
+
+template<typename T>
+Transform<T>::Transform(std::array<T, 9> linear, Vector3<T> translation): m(linear), t(translation) {
+}
+
+template<typename T>
+Transform<T> Transform<T>::translation(Vector3<T> offset) {
+    return Transform<T>({1, 0, 0, 0, 1, 0, 0, 0, 1}, offset);
+}
+
+template<typename T>
+Transform<T> Transform<T>::scaling(Vector3<T> factors) {
+    return Transform<T>({factors.x(), 0, 0, 0, factors.y(), 0, 0, 0, factors.z()}, Vector3<T>());
+}
+
+/*
+ * Rodrigues' rotation formula, angle in radians
+ */
+template<typename T>
+Transform<T> Transform<T>::rotation(Vector3<T> axis, T angle) {
+    const auto u = axis.ort();
+    const T c = std::cos(angle);
+    const T s = std::sin(angle);
+    const T k = 1 - c;
+
+    return Transform<T>({
+        c + u.x() * u.x() * k,         u.x() * u.y() * k - u.z() * s, u.x() * u.z() * k + u.y() * s,
+        u.y() * u.x() * k + u.z() * s, c + u.y() * u.y() * k,         u.y() * u.z() * k - u.x() * s,
+        u.z() * u.x() * k - u.y() * s, u.z() * u.y() * k + u.x() * s, c + u.z() * u.z() * k
+    }, Vector3<T>());
+}
+
+template<typename T>
+Transform<T> Transform<T>::operator*(const Transform<T>& rhs) const {
+    std::array<T, 9> linear;
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            linear[3*i + j] = m[3*i] * rhs.m[j] + m[3*i + 1] * rhs.m[3 + j] + m[3*i + 2] * rhs.m[6 + j];
+        }
+    }
+    return Transform<T>(linear, point(rhs.t));
+}
+
+template<typename T>
+Transform<T> Transform<T>::inverse() const {
+    const T det =
+        m[0] * (m[4] * m[8] - m[5] * m[7]) -
+        m[1] * (m[3] * m[8] - m[5] * m[6]) +
+        m[2] * (m[3] * m[7] - m[4] * m[6]);
+    if (det == 0) {
+        throw std::string("Transform is not invertible");
+    }
+    const T inv_det = 1 / det;
+
+    std::array<T, 9> linear = {
+        (m[4] * m[8] - m[5] * m[7]) * inv_det,
+        (m[2] * m[7] - m[1] * m[8]) * inv_det,
+        (m[1] * m[5] - m[2] * m[4]) * inv_det,
+        (m[5] * m[6] - m[3] * m[8]) * inv_det,
+        (m[0] * m[8] - m[2] * m[6]) * inv_det,
+        (m[2] * m[3] - m[0] * m[5]) * inv_det,
+        (m[3] * m[7] - m[4] * m[6]) * inv_det,
+        (m[1] * m[6] - m[0] * m[7]) * inv_det,
+        (m[0] * m[4] - m[1] * m[3]) * inv_det
+    };
+    Transform<T> result(linear, Vector3<T>());
+    result.t = result.vector(t) * -1;
+    return result;
+}
+
+template<typename T>
+template<typename U>
+inline Vector3<U> Transform<T>::vector(const Vector3<U>& v) const {
+    return Vector3<U>(
+        static_cast<U>(m[0]) * v.x() + static_cast<U>(m[1]) * v.y() + static_cast<U>(m[2]) * v.z(),
+        static_cast<U>(m[3]) * v.x() + static_cast<U>(m[4]) * v.y() + static_cast<U>(m[5]) * v.z(),
+        static_cast<U>(m[6]) * v.x() + static_cast<U>(m[7]) * v.y() + static_cast<U>(m[8]) * v.z()
+    );
+}
+
+template<typename T>
+template<typename U>
+inline Vector3<U> Transform<T>::point(const Vector3<U>& p) const {
+    return vector(p) + Vector3<U>(t);
+}
+
+/*
+ * Read for details:
+ * Arvo J. "Transforming Axis-Aligned Bounding Boxes", Graphics Gems, 1990
+ */
+template<typename T>
+AABBox<T> Transform<T>::box(const AABBox<T>& box) const {
+    std::array<T, 3> min = {t.x(), t.y(), t.z()};
+    std::array<T, 3> max = min;
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            const T a = m[3*i + j] * box.min[j];
+            const T b = m[3*i + j] * box.max[j];
+            min[i] += std::min(a, b);
+            max[i] += std::max(a, b);
+        }
+    }
+    return {Vector3<T>(min[0], min[1], min[2]), Vector3<T>(max[0], max[1], max[2])};
+}
+
+
+// Scene implementation
+template<typename T>
+size_t Scene<T>::add(const KDTree<T>& tree, const Transform<float_t>& transform) {
+    m_instances.push_back({&tree, transform, transform.inverse(), transform.box(tree.top().box())});
+    return m_instances.size() - 1;
+}
+
+template<typename T>
+void Scene<T>::build() {
+    nodes.clear();
+    order.resize(m_instances.size());
+    std::iota(order.begin(), order.end(), 0);
+
+    if (!m_instances.empty()) {
+        build(0, static_cast<uint32_t>(order.size()));
+    }
+}
+
+template<typename T>
+uint32_t Scene<T>::build(uint32_t begin, uint32_t end) {
+    const auto index = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+
+    AABBox<float_t> box;
+    AABBox<float_t> centers;
+    for (auto i = begin; i < end; ++i) {
+        const auto& instance_box = m_instances[order[i]].box;
+        const auto center = (instance_box.min + instance_box.max) / 2;
+        box += instance_box;
+        centers += AABBox<float_t>(center, center);
+    }
+    nodes[index].box = box;
+
+    if (end - begin <= leaf_size) {
+        nodes[index].first = begin;
+        nodes[index].count = end - begin;
+        return index;
+    }
+
+    const auto extent = centers.max - centers.min;
+    int axis = 0;
+    if (extent.y() > extent[axis]) axis = 1;
+    if (extent.z() > extent[axis]) axis = 2;
+
+    const auto mid = begin + (end - begin) / 2;
+    std::nth_element(
+        std::next(order.begin(), begin),
+        std::next(order.begin(), mid),
+        std::next(order.begin(), end),
+        [this, axis](uint32_t lhs, uint32_t rhs) {
+            const auto& l = m_instances[lhs].box;
+            const auto& r = m_instances[rhs].box;
+            return l.min[axis] + l.max[axis] < r.min[axis] + r.max[axis];
+        }
+    );
+
+    build(begin, mid);
+    const auto right = build(mid, end);
+    nodes[index].first = right;
+    nodes[index].count = 0;
+
+    return index;
+}
+
+template<typename T>
+template<typename ray_float_t>
+void Scene<T>::recursive_intersects(
+    const Ray<ray_float_t>& ray,
+    uint32_t index,
+    std::vector<InstanceHit<ray_float_t>>& output,
+    ray_float_t epsilon
+) const {
+    const Node& node = nodes[index];
+
+    if (node.count == 0) {
+        if (ray.is_intersects(nodes[index + 1].box)) {
+            recursive_intersects(ray, index + 1, output, epsilon);
+        }
+        if (ray.is_intersects(nodes[node.first].box)) {
+            recursive_intersects(ray, node.first, output, epsilon);
+        }
+        return;
+    }
+
+    for (auto i = node.first; i < node.first + node.count; ++i) {
+        const auto& instance = m_instances[order[i]];
+        if (node.count > 1 && !ray.is_intersects(instance.box)) {
+            continue;
+        }
+
+        // local direction is normalized again, so the interval is scaled with it
+        const auto local_direction = instance.inverse.vector(ray.direction());
+        const auto scale = local_direction.length();
+        const Ray<ray_float_t> local(
+            instance.inverse.point(ray.origin()),
+            local_direction,
+            ray.t_min() * scale,
+            ray.t_max() * scale
+        );
+        for (const auto& point : local.intersects(*instance.tree, epsilon)) {
+            output.push_back({instance.transform.point(point), order[i]});
+        }
+    }
+}
+
+template<typename T>
+template<typename ray_float_t>
+std::vector<InstanceHit<ray_float_t>> Scene<T>::intersects(
+    const Ray<ray_float_t>& ray,
+    ray_float_t epsilon
+) const {
+    if (nodes.empty() || !ray.is_intersects(nodes[0].box)) {
+        return {};
+    }
+
+    std::vector<InstanceHit<ray_float_t>> output;
+    recursive_intersects(ray, 0, output, epsilon);
+    return output;
+}
+
+} // namespace rmi
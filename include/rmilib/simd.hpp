@@ -0,0 +1,133 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+
+/*
+ * 4-wide float kernels for the hot paths of float meshes: ray-box slab test,
+ * ray against 4 triangles of a leaf, bounding box reduction. Written with
+ * GCC / Clang vector extensions, which emscripten lowers to WASM SIMD128
+ * when built with -msimd128 (RMI_WASM_SIMD option of web build).
+ * Scalar code is used when RMI_SIMD128 is not defined.
+ */
+#if defined(__wasm_simd128__) && !defined(RMI_DISABLE_SIMD128)
+#    define RMI_SIMD128
+#endif
+
+#ifdef RMI_SIMD128
+namespace rmi::simd {
+
+typedef float   float4 __attribute__((vector_size(16)));
+typedef int32_t int4   __attribute__((vector_size(16)));
+
+inline float4 splat(float value) {
+    return float4{value, value, value, value};
+}
+
+// Lanes of a where mask is set, lanes of b otherwise
+inline float4 select(int4 mask, float4 a, float4 b) {
+    return reinterpret_cast<float4>((mask & reinterpret_cast<int4>(a)) | (~mask & reinterpret_cast<int4>(b)));
+}
+
+inline float4 min(float4 a, float4 b) { return select(a < b, a, b); }
+inline float4 max(float4 a, float4 b) { return select(a > b, a, b); }
+
+inline int any(int4 mask) {
+    return mask[0] | mask[1] | mask[2] | mask[3];
+}
+
+
+// Slab test, lanes 0..2 hold x, y, z. Lanes are reduced in the same order
+// as by the scalar test, so both give the same distances.
+inline std::pair<float, float> slabs(
+    float4 origin,
+    float4 inv_direction,
+    float4 min,
+    float4 max,
+    float t_min,
+    float t_max
+) {
+    const float4 t1 = (min - origin) * inv_direction;
+    const float4 t2 = (max - origin) * inv_direction;
+    const float4 near = select(t2 < t1, t2, t1);
+    const float4 far = select(t1 < t2, t2, t1);
+    return std::make_pair(
+        std::max({near[0], near[1], near[2], t_min}),
+        std::min({far[0], far[1], far[2], t_max})
+    );
+}
+
+
+// 4 triangles in structure of arrays layout, unused lanes are degenerate
+struct Triangles4 {
+    float4 v1[3];
+    float4 edge1[3];
+    float4 edge2[3];
+};
+
+inline void cross(const float4 a[3], const float4 b[3], float4 out[3]) {
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+inline float4 dot(const float4 a[3], const float4 b[3]) {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+/*
+ * Moller-Trumbore test of one ray against 4 triangles with the same rules
+ * as the scalar one. Returns lanes mask of hits, distances are written to t.
+ */
+inline int4 intersect(
+    const float origin[3],
+    const float direction[3],
+    const Triangles4& triangles,
+    float epsilon,
+    float t_min,
+    float t_max,
+    float4& t
+) {
+    const float4 d[3] = {splat(direction[0]), splat(direction[1]), splat(direction[2])};
+    float4 ray_cross_e2[3];
+    cross(d, triangles.edge2, ray_cross_e2);
+
+    const float4 det = dot(triangles.edge1, ray_cross_e2);
+    int4 mask = (det < -epsilon) | (det > epsilon);
+    const float4 inv_det = splat(1) / select(mask, det, splat(1));
+
+    const float4 s[3] = {
+        splat(origin[0]) - triangles.v1[0],
+        splat(origin[1]) - triangles.v1[1],
+        splat(origin[2]) - triangles.v1[2]
+    };
+    const float4 u = inv_det * dot(s, ray_cross_e2);
+    mask &= (u >= 0) & (u <= 1);
+
+    float4 s_cross_e1[3];
+    cross(s, triangles.edge1, s_cross_e1);
+    const float4 v = inv_det * dot(d, s_cross_e1);
+    mask &= (v >= 0) & (u + v <= 1);
+
+    t = inv_det * dot(triangles.edge2, s_cross_e1);
+    mask &= (t > epsilon) & (t >= t_min) & (t <= t_max);
+    return mask;
+}
+
+
+// Running bounds of points, the 4th lane is unused
+struct Bounds {
+    float4 min = splat(std::numeric_limits<float>::max());
+    float4 max = splat(std::numeric_limits<float>::lowest());
+
+    inline void add(float4 point) {
+        min = simd::min(min, point);
+        max = simd::max(max, point);
+    }
+};
+
+} // namespace rmi::simd
+#endif
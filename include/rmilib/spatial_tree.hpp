@@ -0,0 +1,502 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include "rmi.hpp"
+
+
+namespace rmi {
+
+template<typename T>
+struct SpatialSplitter {
+    SpatialSplitter(int threshold = 4, double budget = 0.5, int bins = 32, double alpha = 1e-5):
+        threshold(threshold), budget(budget), bins(bins), alpha(alpha)
+    {}
+
+    // maximum leaf size
+    int threshold;
+    // maximum number of duplicated references relative to triangles count
+    double budget;
+    // number of candidate planes along each axis is bins - 1
+    int bins;
+    // spatial splits are tried only when object split children overlap
+    // by more than alpha of the root surface area
+    double alpha;
+};
+
+
+/*
+ * Bounding volume hierarchy built with spatial splits. Read for details:
+ * Stich M., Friedrich H., Dietrich A. "Spatial Splits in Bounding Volume Hierarchies", 2009
+ *
+ * Besides object partitioning, node may be split by plane. Triangles crossing
+ * the plane are referenced from both children with boxes clipped to their side,
+ * which removes overlap of children produced by long, thin triangles.
+ * Tree owns copies of referenced elements. Nodes have the same interface as
+ * KDTree nodes, so all Ray query methods accept the tree.
+ */
+template<typename T>
+class SpatialTree {
+public:
+    using mesh_type = T;
+    using float_t = typename T::float_t;
+    using Element = typename Mesh<T>::Element;
+    using reference_iterator = typename std::vector<Element>::const_iterator;
+
+    class Node {
+    public:
+        friend SpatialTree;
+
+        Node(
+            AABBox<float_t> box,
+            std::unique_ptr<Node>&& left,
+            std::unique_ptr<Node>&& right
+        ): bounding_box(box), regions(nullptr), m_left(std::move(left)), m_right(std::move(right)) {}
+
+        Node(
+            AABBox<float_t> box,
+            reference_iterator begin,
+            reference_iterator end,
+            const AABBox<float_t>* regions
+        ): bounding_box(box), m_begin(begin), m_end(end), regions(regions) {}
+
+        inline bool                   is_leaf() const { return !m_left && !m_right; }
+        inline const Node&            left()    const { return *m_left; }
+        inline const Node&            right()   const { return *m_right; }
+        inline const AABBox<float_t>& box()     const { return bounding_box; }
+        inline reference_iterator     begin()   const { return m_begin; }
+        inline reference_iterator     end()     const { return m_end; }
+
+        // Triangle referenced from several leaves is reported only by the reference
+        // which region contains hit point
+        template<typename U>
+        bool accepts(const Element& element, const Vector3<U>& point) const;
+    private:
+        AABBox<float_t>        bounding_box;
+        reference_iterator     m_begin;
+        reference_iterator     m_end;
+        // regions of leaf references, parallel to [m_begin, m_end)
+        const AABBox<float_t>* regions;
+
+        std::unique_ptr<Node> m_left;
+        std::unique_ptr<Node> m_right;
+    };
+
+    static SpatialTree<T> for_mesh(Mesh<T>& mesh, const SpatialSplitter<T>& splitter = SpatialSplitter<T>());
+
+    inline const Node&                 top()        const { return *root; }
+    inline const std::vector<Element>& references() const { return m_references; }
+private:
+    struct Reference {
+        typename T::iterator element;
+        // bounds of the part of triangle inside region
+        AABBox<float_t>      box;
+        // half-open cell [min, max) produced by spatial splits, regions
+        // of all references of one triangle don't intersect
+        AABBox<float_t>      region;
+    };
+
+    struct Split {
+        float_t cost;
+        int axis;
+        // position of plane for spatial split, references count in left child for object split
+        float_t position;
+        bool spatial;
+    };
+
+    SpatialTree(const SpatialSplitter<T>& splitter, size_t max_references):
+        splitter(splitter), max_references(max_references)
+    {}
+
+    std::unique_ptr<Node> build(std::vector<Reference>& refs, int depth);
+
+    Split find_object_split(std::vector<Reference>& refs, AABBox<float_t>& left, AABBox<float_t>& right) const;
+    Split find_spatial_split(const std::vector<Reference>& refs, const AABBox<float_t>& box) const;
+
+    void split_spatially(
+        std::vector<Reference>& refs,
+        const Split& split,
+        std::vector<Reference>& left,
+        std::vector<Reference>& right
+    );
+
+    std::unique_ptr<Node> make_leaf(const std::vector<Reference>& refs);
+
+    static AABBox<float_t> clip(const Element& triangle, int axis, float_t min, float_t max);
+    static AABBox<float_t> intersection(const AABBox<float_t>& lhs, const AABBox<float_t>& rhs);
+    static bool            is_empty(const AABBox<float_t>& box);
+    static void            set_coord(Vector3<float_t>& vector, int axis, float_t value);
+
+    static constexpr int max_depth = 64;
+
+    SpatialSplitter<T>    splitter;
+    size_t                max_references;
+    size_t                references_count = 0;
+    float_t               root_area = 0;
+
+    std::vector<Element>         m_references;
+    std::vector<AABBox<float_t>> m_regions;
+    std::unique_ptr<Node>        root;
+};
+
+
+template<typename T>
+template<typename U>
+bool SpatialTree<T>::Node::accepts(const Element& element, const Vector3<U>& point) const {
+    const auto& region = regions[&element - &*m_begin];
+    for (int axis = 0; axis < 3; ++axis) {
+        if (point[axis] < region.min[axis] || !(point[axis] < region.max[axis])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+template<typename T>
+SpatialTree<T> SpatialTree<T>::for_mesh(Mesh<T>& mesh, const SpatialSplitter<T>& splitter) {
+    const auto size = static_cast<size_t>(std::distance(mesh.begin(), mesh.end()));
+
+    SpatialTree<T> tree(splitter, size + static_cast<size_t>(splitter.budget * size));
+    // references never exceed the budget, so iterators to them stay valid during build
+    tree.m_references.reserve(tree.max_references);
+    tree.m_regions.reserve(tree.max_references);
+
+    const auto inf = std::numeric_limits<float_t>::infinity();
+    const AABBox<float_t> space(Vector3<float_t>(-inf, -inf, -inf), Vector3<float_t>(inf, inf, inf));
+
+    std::vector<Reference> refs;
+    refs.reserve(size);
+    AABBox<float_t> box;
+    for (auto it = mesh.begin(); it != mesh.end(); ++it) {
+        refs.push_back({it, get_bounding_box<T>(*it), space});
+        box += refs.back().box;
+    }
+    tree.root_area = box.area();
+    tree.references_count = refs.size();
+    tree.root = tree.build(refs, 0);
+
+    return tree;
+}
+
+template<typename T>
+std::unique_ptr<typename SpatialTree<T>::Node> SpatialTree<T>::build(std::vector<Reference>& refs, int depth) {
+    if (refs.size() <= static_cast<size_t>(splitter.threshold) || depth >= max_depth) {
+        return make_leaf(refs);
+    }
+
+    AABBox<float_t> box;
+    for (const auto& ref : refs) {
+        box += ref.box;
+    }
+
+    AABBox<float_t> left_box, right_box;
+    auto split = find_object_split(refs, left_box, right_box);
+
+    if (const auto overlap = intersection(left_box, right_box);
+        !is_empty(overlap) && overlap.area() > splitter.alpha * root_area) {
+        if (auto spatial = find_spatial_split(refs, box); spatial.cost < split.cost) {
+            split = spatial;
+        }
+    }
+
+    std::vector<Reference> left, right;
+    if (split.spatial) {
+        split_spatially(refs, split, left, right);
+    } else {
+        const auto axis = split.axis;
+        std::sort(refs.begin(), refs.end(), [axis](const Reference& lhs, const Reference& rhs) {
+            return lhs.box.min[axis] + lhs.box.max[axis] < rhs.box.min[axis] + rhs.box.max[axis];
+        });
+        const auto mid = std::next(refs.begin(), static_cast<size_t>(split.position));
+        left.assign(refs.begin(), mid);
+        right.assign(mid, refs.end());
+    }
+
+    if (left.empty() || right.empty()) {
+        return make_leaf(refs);
+    }
+    std::vector<Reference>().swap(refs);
+
+    auto left_node = build(left, depth + 1);
+    auto right_node = build(right, depth + 1);
+
+    return std::make_unique<Node>(
+        left_node->box() + right_node->box(),
+        std::move(left_node), std::move(right_node)
+    );
+}
+
+template<typename T>
+std::unique_ptr<typename SpatialTree<T>::Node> SpatialTree<T>::make_leaf(const std::vector<Reference>& refs) {
+    const auto begin = m_references.size();
+
+    AABBox<float_t> box;
+    for (const auto& ref : refs) {
+        m_references.push_back(*ref.element);
+        m_regions.push_back(ref.region);
+        box += ref.box;
+    }
+
+    return std::make_unique<Node>(
+        box,
+        std::next(m_references.cbegin(), begin),
+        m_references.cend(),
+        m_regions.data() + begin
+    );
+}
+
+/*
+ * Surface area heuristic over references sorted by box center
+ */
+template<typename T>
+typename SpatialTree<T>::Split SpatialTree<T>::find_object_split(
+    std::vector<Reference>& refs,
+    AABBox<float_t>& left,
+    AABBox<float_t>& right
+) const {
+    const auto length = refs.size();
+    Split best = {std::numeric_limits<float_t>::max(), 0, static_cast<float_t>(length), false};
+
+    std::vector<AABBox<float_t>> suf(length + 1);
+    for (int axis = 0; axis < 3; ++axis) {
+        std::sort(refs.begin(), refs.end(), [axis](const Reference& lhs, const Reference& rhs) {
+            return lhs.box.min[axis] + lhs.box.max[axis] < rhs.box.min[axis] + rhs.box.max[axis];
+        });
+
+        for (size_t i = 0; i < length; ++i) {
+            suf[i + 1] = suf[i] + refs[length - i - 1].box;
+        }
+
+        AABBox<float_t> pref;
+        for (size_t i = 1; i < length; ++i) {
+            pref += refs[i - 1].box;
+            const auto cost = i * pref.area() + (length - i) * suf[length - i].area();
+            if (cost < best.cost) {
+                best = {cost, axis, static_cast<float_t>(i), false};
+                left = pref;
+                right = suf[length - i];
+            }
+        }
+    }
+
+    return best;
+}
+
+/*
+ * Chopped binning: every reference is clipped to all bins it spans
+ */
+template<typename T>
+typename SpatialTree<T>::Split SpatialTree<T>::find_spatial_split(
+    const std::vector<Reference>& refs,
+    const AABBox<float_t>& box
+) const {
+    Split best = {std::numeric_limits<float_t>::max(), 0, 0, true};
+
+    const auto bins = static_cast<size_t>(splitter.bins);
+    std::vector<AABBox<float_t>> bin_boxes(bins);
+    std::vector<size_t> enter(bins), exit(bins);
+    std::vector<AABBox<float_t>> suf(bins + 1);
+
+    for (int axis = 0; axis < 3; ++axis) {
+        const float_t origin = box.min[axis];
+        const float_t width = (box.max[axis] - origin) / bins;
+        if (width <= 0) {
+            continue;
+        }
+
+        std::fill(bin_boxes.begin(), bin_boxes.end(), AABBox<float_t>());
+        std::fill(enter.begin(), enter.end(), 0);
+        std::fill(exit.begin(), exit.end(), 0);
+
+        auto bin_of = [origin, width, bins](float_t value) {
+            const auto bin = static_cast<long long>((value - origin) / width);
+            return static_cast<size_t>(std::clamp<long long>(bin, 0, bins - 1));
+        };
+
+        for (const auto& ref : refs) {
+            const auto first = bin_of(ref.box.min[axis]);
+            const auto last = bin_of(ref.box.max[axis]);
+
+            if (first == last) {
+                bin_boxes[first] += ref.box;
+            } else {
+                for (auto bin = first; bin <= last; ++bin) {
+                    const auto part = intersection(
+                        clip(*ref.element, axis, origin + bin * width, origin + (bin + 1) * width),
+                        ref.box
+                    );
+                    if (!is_empty(part)) {
+                        bin_boxes[bin] += part;
+                    }
+                }
+            }
+            ++enter[first];
+            ++exit[last];
+        }
+
+        suf[bins] = AABBox<float_t>();
+        for (size_t i = bins; i > 0; --i) {
+            suf[i - 1] = suf[i] + bin_boxes[i - 1];
+        }
+
+        AABBox<float_t> pref;
+        size_t left_count = 0;
+        size_t right_count = refs.size();
+        for (size_t i = 1; i < bins; ++i) {
+            pref += bin_boxes[i - 1];
+            left_count += enter[i - 1];
+            right_count -= exit[i - 1];
+            if (left_count == 0 || right_count == 0) {
+                continue;
+            }
+
+            const auto cost = left_count * pref.area() + right_count * suf[i].area();
+            if (cost < best.cost) {
+                best = {cost, axis, origin + i * width, true};
+            }
+        }
+    }
+
+    return best;
+}
+
+template<typename T>
+void SpatialTree<T>::split_spatially(
+    std::vector<Reference>& refs,
+    const Split& split,
+    std::vector<Reference>& left,
+    std::vector<Reference>& right
+) {
+    const auto axis = split.axis;
+    const auto plane = split.position;
+
+    size_t straddling = 0;
+    for (const auto& ref : refs) {
+        straddling += ref.box.min[axis] < plane && plane < ref.box.max[axis];
+    }
+
+    for (const auto& ref : refs) {
+        if (ref.box.max[axis] <= plane) {
+            left.push_back(ref);
+        } else if (ref.box.min[axis] >= plane) {
+            right.push_back(ref);
+        } else if (references_count + straddling > max_references) {
+            // out of budget: keep reference whole on the side of its center
+            (ref.box.min[axis] + ref.box.max[axis] < 2 * plane ? left : right).push_back(ref);
+        } else {
+            const auto left_part = intersection(clip(*ref.element, axis, ref.box.min[axis], plane), ref.box);
+            const auto right_part = intersection(clip(*ref.element, axis, plane, ref.box.max[axis]), ref.box);
+
+            if (is_empty(left_part)) {
+                right.push_back(ref);
+            } else if (is_empty(right_part)) {
+                left.push_back(ref);
+            } else {
+                Reference left_ref = {ref.element, left_part, ref.region};
+                Reference right_ref = {ref.element, right_part, ref.region};
+                set_coord(left_ref.region.max, axis, plane);
+                set_coord(right_ref.region.min, axis, plane);
+                left.push_back(left_ref);
+                right.push_back(right_ref);
+            }
+        }
+    }
+
+    references_count += left.size() + right.size() - refs.size();
+}
+
+/*
+ * Bounds of the part of triangle between planes min <= p[axis] <= max
+ * (Sutherland–Hodgman polygon clipping)
+ */
+template<typename T>
+AABBox<typename T::float_t> SpatialTree<T>::clip(
+    const Element& triangle,
+    int axis,
+    float_t min,
+    float_t max
+) {
+    using Point = std::array<float_t, 3>;
+    std::array<Point, 9> polygon = {
+        Point{triangle.v1.x(), triangle.v1.y(), triangle.v1.z()},
+        Point{triangle.v2.x(), triangle.v2.y(), triangle.v2.z()},
+        Point{triangle.v3.x(), triangle.v3.y(), triangle.v3.z()}
+    };
+    std::array<Point, 9> clipped;
+    size_t size = 3;
+
+    auto clip_plane = [&](float_t position, bool keep_greater) {
+        size_t clipped_size = 0;
+        for (size_t i = 0; i < size; ++i) {
+            const auto& a = polygon[i];
+            const auto& b = polygon[(i + 1) % size];
+            const bool a_inside = keep_greater ? a[axis] >= position : a[axis] <= position;
+            const bool b_inside = keep_greater ? b[axis] >= position : b[axis] <= position;
+
+            if (a_inside) {
+                clipped[clipped_size++] = a;
+            }
+            if (a_inside != b_inside) {
+                const float_t t = (position - a[axis]) / (b[axis] - a[axis]);
+                Point point;
+                for (int j = 0; j < 3; ++j) {
+                    point[j] = a[j] + (b[j] - a[j]) * t;
+                }
+                point[axis] = position;
+                clipped[clipped_size++] = point;
+            }
+        }
+        polygon = clipped;
+        size = clipped_size;
+    };
+
+    clip_plane(min, true);
+    clip_plane(max, false);
+
+    AABBox<float_t> box;
+    for (size_t i = 0; i < size; ++i) {
+        box += AABBox<float_t>(
+            Vector3<float_t>(polygon[i][0], polygon[i][1], polygon[i][2]),
+            Vector3<float_t>(polygon[i][0], polygon[i][1], polygon[i][2])
+        );
+    }
+    return box;
+}
+
+template<typename T>
+inline AABBox<typename T::float_t> SpatialTree<T>::intersection(
+    const AABBox<float_t>& lhs,
+    const AABBox<float_t>& rhs
+) {
+    return {
+        Vector3<float_t>(
+            std::max(lhs.min.x(), rhs.min.x()),
+            std::max(lhs.min.y(), rhs.min.y()),
+            std::max(lhs.min.z(), rhs.min.z())
+        ),
+        Vector3<float_t>(
+            std::min(lhs.max.x(), rhs.max.x()),
+            std::min(lhs.max.y(), rhs.max.y()),
+            std::min(lhs.max.z(), rhs.max.z())
+        )
+    };
+}
+
+template<typename T>
+inline bool SpatialTree<T>::is_empty(const AABBox<float_t>& box) {
+    return box.min.x() > box.max.x() || box.min.y() > box.max.y() || box.min.z() > box.max.z();
+}
+
+template<typename T>
+inline void SpatialTree<T>::set_coord(Vector3<float_t>& vector, int axis, float_t value) {
+    switch (axis) {
+    case 0: vector.set_x(value); break;
+    case 1: vector.set_y(value); break;
+    case 2: vector.set_z(value); break;
+    }
+}
+
+} // namespace rmi
@@ -0,0 +1,130 @@
+#include <catch2/catch.hpp>
+
+#include <set>
+#include <thread>
+#include "rmilib/arena.hpp"
+#include "rmilib/rmi.hpp"
+#include "rmilib/raw_mesh.hpp"
+#include "rmilib/mesh_generator.hpp"
+
+
+TEST_CASE("Arena allocation", "[arena]") {
+    rmi::Arena arena(rmi::ArenaOptions{4096, false});
+
+    WHEN("Allocating objects of different alignment") {
+        std::vector<void*> pointers;
+        for (size_t i = 0; i < 1000; ++i) {
+            const size_t alignment = size_t(1) << (i % 5);
+            auto pointer = arena.allocate(i % 7 + 1, alignment);
+            REQUIRE(reinterpret_cast<uintptr_t>(pointer) % alignment == 0);
+            pointers.push_back(pointer);
+        }
+        THEN("They should not overlap and share few blocks") {
+            REQUIRE(std::set<void*>(pointers.begin(), pointers.end()).size() == pointers.size());
+            REQUIRE(arena.refills_count() <= 3);
+            REQUIRE(arena.reserved_bytes() == 4096 * arena.refills_count());
+        }
+    }
+
+    WHEN("Allocating object larger than block") {
+        auto values = static_cast<double*>(arena.allocate(10000 * sizeof(double), alignof(double)));
+        std::fill(values, values + 10000, 1.0);
+        THEN("It should get own block") {
+            REQUIRE(arena.reserved_bytes() >= 10000 * sizeof(double));
+        }
+    }
+
+    WHEN("Objects are given back") {
+        std::vector<double*> first;
+        for (int i = 0; i < 100; ++i) {
+            first.push_back(arena.create<double>(i));
+        }
+        for (auto value : first) {
+            arena.destroy(value);
+        }
+        const auto reserved = arena.reserved_bytes();
+        std::set<double*> second;
+        for (int i = 0; i < 100; ++i) {
+            second.insert(arena.create<double>(i));
+        }
+        THEN("Their memory should be reused by objects of the same size") {
+            REQUIRE(second == std::set<double*>(first.begin(), first.end()));
+            REQUIRE(arena.reserved_bytes() == reserved);
+        }
+    }
+
+    WHEN("Several threads create objects") {
+        std::vector<std::vector<int*>> created(4);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&arena, &created, t] {
+                for (int i = 0; i < 10000; ++i) {
+                    created[t].push_back(arena.create<int>(t * 10000 + i));
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        THEN("Every thread should get its own memory") {
+            for (int t = 0; t < 4; ++t) {
+                for (int i = 0; i < 10000; ++i) {
+                    REQUIRE(*created[t][i] == t * 10000 + i);
+                }
+            }
+            // a block holds about 1000 ints, so lock is taken once per block
+            REQUIRE(arena.refills_count() <= 4 * (10000 * sizeof(int) / 4096 + 2));
+        }
+    }
+}
+
+
+TEST_CASE("Tree nodes in arena", "[arena][kdtree]") {
+    auto mesh = generate_soup_mesh<double, size_t>(5000, 1);
+    const rmi::Ray<double> ray(rmi::Vector3d(-2, 0.1, 0.2), rmi::Vector3d(1, 0, 0));
+    const auto expected = ray.intersects(mesh);
+
+    for (bool huge_pages : {false, true}) {
+        const auto tree = rmi::KDTree<TriangularMesh>::for_mesh(
+            mesh, rmi::SAHSplitter<TriangularMesh>(), rmi::ArenaOptions{size_t(1) << 16, huge_pages}
+        );
+        REQUIRE_THAT(ray.intersects(tree), Catch::Matchers::UnorderedEquals(expected));
+
+        std::vector<rmi::Vector3d> buffer = {rmi::Vector3d(1, 2, 3)};
+        ray.intersects(tree, buffer);
+        REQUIRE(buffer.size() == expected.size() + 1);
+        REQUIRE(buffer.front() == rmi::Vector3d(1, 2, 3));
+    }
+
+    GIVEN("Default options") {
+        auto small = generate_soup_mesh<double, size_t>(20, 2);
+        const auto tree = rmi::KDTree<TriangularMesh>::for_mesh(small);
+        THEN("Blocks should be sized by triangles count") {
+            REQUIRE(tree.reserved_bytes() < (size_t(64) << 10));
+        }
+    }
+}
+
+TEST_CASE("Nodes of rebuilt subtrees", "[arena][kdtree][refit]") {
+    auto mesh = generate_sphere_mesh<double, size_t>(20000);
+    auto tree = rmi::KDTree<TriangularMesh>::for_mesh(mesh);
+
+    // every inner node overlaps, so every refit rebuilds the whole tree
+    tree.refit(mesh, 0.0, rmi::SAHSplitter<TriangularMesh>());
+    const auto reserved = tree.reserved_bytes();
+    for (int frame = 0; frame < 20; ++frame) {
+        tree.refit(mesh, 0.0, rmi::SAHSplitter<TriangularMesh>());
+    }
+    REQUIRE(tree.reserved_bytes() == reserved);
+
+    const rmi::Ray<double> ray(rmi::Vector3d(-2, 0.1, 0.2), rmi::Vector3d(1, 0, 0));
+    REQUIRE_THAT(ray.intersects(tree), Catch::Matchers::UnorderedEquals(ray.intersects(mesh)));
+
+#ifdef RMI_INCLUDE_OMP
+    for (int frame = 0; frame < 20; ++frame) {
+        tree.refit(mesh, 2, 0.0, rmi::SAHSplitter<TriangularMesh>());
+    }
+    REQUIRE(tree.reserved_bytes() <= 2 * reserved);
+    REQUIRE_THAT(ray.intersects(tree), Catch::Matchers::UnorderedEquals(ray.intersects(mesh)));
+#endif
+}
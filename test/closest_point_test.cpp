@@ -0,0 +1,124 @@
+#include <catch2/catch.hpp>
+
+#include <random>
+#include "rmilib/rmi.hpp"
+#include "rmilib/raw_mesh.hpp"
+#include "rmilib/mesh_generator.hpp"
+#include "rmilib/closest_point.hpp"
+#include "rmilib/dynamic_tree.hpp"
+
+#define EPSILON 0.00001
+
+
+std::vector<rmi::Vector3d> random_points(int count, int seed) {
+    std::default_random_engine engine(seed);
+    std::uniform_real_distribution<> dist(-1.5, 1.5);
+    std::vector<rmi::Vector3d> points;
+    for (int i = 0; i < count; ++i) {
+        points.emplace_back(dist(engine), dist(engine), dist(engine));
+    }
+    return points;
+}
+
+double brute_force_distance(TriangularMesh& mesh, const rmi::Vector3d& p) {
+    double result = std::numeric_limits<double>::infinity();
+    for (const auto& triangle : mesh) {
+        result = std::min(result, (rmi::closest_point<TriangularMesh>(triangle, p) - p).length());
+    }
+    return result;
+}
+
+
+TEST_CASE("Closest point of triangle", "[closest]") {
+    TriangularMesh mesh({0, 0, 0,  2, 0, 0,  0, 2, 0}, {0, 1, 2});
+    const auto& triangle = *mesh.begin();
+
+    const std::pair<rmi::Vector3d, rmi::Vector3d> cases[] = {
+        {rmi::Vector3d(0.5, 0.5, 3), rmi::Vector3d(0.5, 0.5, 0)},   // face
+        {rmi::Vector3d(-1, -1, 1), rmi::Vector3d(0, 0, 0)},         // vertex
+        {rmi::Vector3d(3, -0.5, 0), rmi::Vector3d(2, 0, 0)},        // vertex
+        {rmi::Vector3d(1, -1, -1), rmi::Vector3d(1, 0, 0)},         // edge
+        {rmi::Vector3d(-2, 1, 0), rmi::Vector3d(0, 1, 0)},          // edge
+        {rmi::Vector3d(2, 2, 5), rmi::Vector3d(1, 1, 0)}            // hypotenuse
+    };
+    for (const auto& [p, expected] : cases) {
+        const auto point = rmi::closest_point<TriangularMesh>(triangle, p);
+        REQUIRE(point.x() == Approx(expected.x()).margin(EPSILON));
+        REQUIRE(point.y() == Approx(expected.y()).margin(EPSILON));
+        REQUIRE(point.z() == Approx(expected.z()).margin(EPSILON));
+    }
+}
+
+TEST_CASE("Closest point of mesh", "[closest][kdtree]") {
+    GIVEN("Random triangles soup and query points") {
+        TriangularMesh mesh = generate_soup_mesh<double, size_t>(2000, 5);
+        const auto points = random_points(300, 6);
+
+        WHEN("Searching in kdtree") {
+            const auto tree = rmi::KDTree<TriangularMesh>::for_mesh(mesh);
+            THEN("Result should match brute force search") {
+                for (const auto& p : points) {
+                    const auto result = rmi::closest_point(tree, p);
+                    REQUIRE(result.has_value());
+                    REQUIRE(result->distance == Approx(brute_force_distance(mesh, p)).margin(EPSILON));
+                    REQUIRE((result->point - p).length() == Approx(result->distance).margin(EPSILON));
+
+                    const auto& triangle = *std::find_if(mesh.begin(), mesh.end(), [&](const auto& element) {
+                        return element.index == result->triangle;
+                    });
+                    const auto nearest = rmi::closest_point<TriangularMesh>(triangle, p);
+                    REQUIRE((nearest - result->point).length() == Approx(0).margin(EPSILON));
+                }
+            }
+        }
+
+        WHEN("Searching in dynamic tree") {
+            const auto tree = rmi::DynamicTree<TriangularMesh>::for_mesh(mesh);
+            THEN("Result should match brute force search") {
+                for (const auto& p : points) {
+                    const auto result = rmi::closest_point(tree, p);
+                    REQUIRE(result.has_value());
+                    REQUIRE(result->distance == Approx(brute_force_distance(mesh, p)).margin(EPSILON));
+                }
+            }
+        }
+
+        WHEN("Limiting search distance") {
+            const auto tree = rmi::KDTree<TriangularMesh>::for_mesh(mesh);
+            THEN("Points farther than limit should not be found") {
+                for (const auto& p : points) {
+                    const auto distance = brute_force_distance(mesh, p);
+                    REQUIRE(rmi::closest_point(tree, p, distance * 0.99).has_value() == false);
+                    REQUIRE(rmi::closest_point(tree, p, distance * 1.01).has_value());
+                }
+            }
+        }
+
+        WHEN("Searching a batch of points") {
+            const auto tree = rmi::KDTree<TriangularMesh>::for_mesh(mesh);
+            const auto expected = rmi::closest_points(tree, points);
+            REQUIRE(expected.size() == points.size());
+
+            const auto require_same = [&expected](const auto& actual) {
+                REQUIRE(actual.size() == expected.size());
+                for (size_t i = 0; i < actual.size(); ++i) {
+                    REQUIRE(actual[i].has_value());
+                    REQUIRE(actual[i]->triangle == expected[i]->triangle);
+                    REQUIRE(actual[i]->distance == expected[i]->distance);
+                }
+            };
+
+            #ifdef RMI_INCLUDE_OMP
+            THEN("OMP search should return the same points") {
+                require_same(rmi::omp_closest_points(tree, points, 4));
+            }
+            #endif
+
+            #ifdef RMI_INCLUDE_POOL
+            THEN("Pool search should return the same points") {
+                require_same(rmi::pool_closest_points(tree, points, 4));
+            }
+            #endif
+        }
+    }
+}
@@ -0,0 +1,130 @@
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <sstream>
+#include <tuple>
+#include "rmilib/rmi.hpp"
+#include "rmilib/raw_mesh.hpp"
+#include "rmilib/mesh_generator.hpp"
+#include "rmilib/ray_generator.hpp"
+#include "rmilib/dispatcher.hpp"
+
+
+std::vector<rmi::Vector3d> sorted_points(std::vector<rmi::Vector3d> points) {
+    std::sort(points.begin(), points.end(), [](const rmi::Vector3d& a, const rmi::Vector3d& b) {
+        return std::make_tuple(a.x(), a.y(), a.z()) < std::make_tuple(b.x(), b.y(), b.z());
+    });
+    return points;
+}
+
+
+TEST_CASE("Dispatch profile", "[dispatcher]") {
+    GIVEN("Routes measured for small and large meshes") {
+        rmi::DispatchProfile profile;
+        profile.add({100, 1, {rmi::Backend::Brute, 1}, 1e-6});
+        profile.add({100, 1000, {rmi::Backend::Tree, 1}, 1e-7});
+        profile.add({1000000, 1, {rmi::Backend::Tree, 1}, 1e-6});
+        profile.add({1000000, 1000, {rmi::Backend::Pool, 4}, 1e-7});
+
+        THEN("Route of the nearest mesh and batch sizes should be chosen") {
+            REQUIRE(profile.route(80, 1).backend == rmi::Backend::Brute);
+            REQUIRE(profile.route(80, 5000).backend == rmi::Backend::Tree);
+            REQUIRE(profile.route(500000, 2).backend == rmi::Backend::Tree);
+            REQUIRE(profile.route(500000, 600).backend == rmi::Backend::Pool);
+            REQUIRE(profile.route(500000, 600).threads == 4);
+        }
+
+        WHEN("Entry for the same sizes is added") {
+            profile.add({100, 1, {rmi::Backend::Tree, 1}, 1e-7});
+            THEN("It should replace the old one") {
+                REQUIRE(profile.entries().size() == 4);
+                REQUIRE(profile.route(100, 1).backend == rmi::Backend::Tree);
+            }
+        }
+
+        WHEN("Profile is saved and loaded") {
+            std::stringstream stream;
+            profile.save(stream);
+            const auto loaded = rmi::DispatchProfile::load(stream);
+            THEN("Entries should be the same") {
+                REQUIRE(loaded.entries().size() == profile.entries().size());
+                for (size_t i = 0; i < loaded.entries().size(); ++i) {
+                    const auto& expected = profile.entries()[i];
+                    const auto& actual = loaded.entries()[i];
+                    REQUIRE(actual.triangles == expected.triangles);
+                    REQUIRE(actual.batch == expected.batch);
+                    REQUIRE(actual.route.backend == expected.route.backend);
+                    REQUIRE(actual.route.threads == expected.route.threads);
+                    REQUIRE(actual.seconds_per_ray == Approx(expected.seconds_per_ray));
+                }
+            }
+        }
+    }
+
+    GIVEN("Empty profile") {
+        THEN("Tree search should be used") {
+            REQUIRE(rmi::DispatchProfile().route(1000, 1).backend == rmi::Backend::Tree);
+        }
+    }
+
+    GIVEN("Malformed profile") {
+        std::stringstream stream("100 1 gpu 1 0.5\n");
+        THEN("Loading should fail") {
+            REQUIRE_THROWS(rmi::DispatchProfile::load(stream));
+        }
+    }
+}
+
+TEST_CASE("Dispatching ray queries", "[dispatcher][ray]") {
+    GIVEN("Sphere mesh and its tree") {
+        TriangularMesh mesh = generate_sphere_mesh<double, size_t>(2000);
+        const auto tree = rmi::KDTree<TriangularMesh>::for_mesh(mesh);
+        const auto rays = rmi::uniform_rays<double>(tree.top().box(), 200, 3);
+
+        std::vector<std::vector<rmi::Vector3d>> expected;
+        for (const auto& ray : rays) {
+            expected.push_back(sorted_points(ray.intersects(tree)));
+        }
+
+        WHEN("Batch is run by every backend") {
+            rmi::Dispatcher<rmi::KDTree<TriangularMesh>> dispatcher(mesh, tree);
+            THEN("Hits should match tree search") {
+                for (auto backend : {rmi::Backend::Brute, rmi::Backend::Tree, rmi::Backend::Omp, rmi::Backend::Pool}) {
+                    const auto hits = dispatcher.intersects(rays, rmi::Route{backend, 3});
+                    REQUIRE(hits.size() == rays.size());
+                    for (size_t i = 0; i < rays.size(); ++i) {
+                        REQUIRE(sorted_points(hits[i]) == expected[i]);
+                    }
+                    // single rays are split between threads by subtrees
+                    const auto single = dispatcher.intersects({rays[0]}, rmi::Route{backend, 3});
+                    REQUIRE(sorted_points(single[0]) == expected[0]);
+                }
+            }
+        }
+
+        WHEN("Dispatcher is calibrated") {
+            rmi::Dispatcher<rmi::KDTree<TriangularMesh>> dispatcher(mesh, tree);
+            rmi::CalibrationOptions options;
+            options.batches = {1, 32};
+            options.threads = {2};
+            options.rays = 64;
+            dispatcher.calibrate(options);
+
+            THEN("Route should be stored for every batch size") {
+                REQUIRE(dispatcher.profile().entries().size() == 2);
+                for (const auto& entry : dispatcher.profile().entries()) {
+                    REQUIRE(entry.triangles == mesh.size());
+                    REQUIRE(rmi::is_available(entry.route.backend));
+                }
+            }
+
+            THEN("Hits should match tree search") {
+                const auto hits = dispatcher.intersects(rays);
+                for (size_t i = 0; i < rays.size(); ++i) {
+                    REQUIRE(sorted_points(hits[i]) == expected[i]);
+                }
+                REQUIRE(sorted_points(dispatcher.intersects(rays[1])) == expected[1]);
+            }
+        }
+    }
+}
@@ -0,0 +1,90 @@
+#include <catch2/catch.hpp>
+
+#include <random>
+#include "rmilib/rmi.hpp"
+#include "rmilib/raw_mesh.hpp"
+#include "rmilib/mesh_generator.hpp"
+#include "rmilib/dynamic_tree.hpp"
+
+
+// Brute force search over elements with even index
+std::vector<rmi::Vector3d> even_intersections(const rmi::Ray<double>& ray, TriangularMesh& mesh) {
+    std::vector<rmi::Vector3d> result;
+    for (const auto& element : mesh) {
+        if (element.index % 2 == 0) {
+            if (auto intersection = ray.intersects<TriangularMesh>(element); intersection) {
+                result.push_back(*intersection);
+            }
+        }
+    }
+    return result;
+}
+
+std::vector<rmi::Ray<double>> random_rays(int count, int seed) {
+    std::default_random_engine engine(seed);
+    std::uniform_real_distribution<> dist(-1, 1);
+    std::vector<rmi::Ray<double>> rays;
+    for (int i = 0; i < count; ++i) {
+        rays.emplace_back(
+            rmi::Vector3d(dist(engine), dist(engine), dist(engine)),
+            rmi::Vector3d(dist(engine), dist(engine), dist(engine))
+        );
+    }
+    return rays;
+}
+
+
+TEST_CASE("Dynamic tree editing", "[dynamic][ray]") {
+    GIVEN("Random triangles soup") {
+        TriangularMesh mesh = generate_soup_mesh<double, size_t>(2000, 13);
+        auto tree = rmi::DynamicTree<TriangularMesh>::for_mesh(mesh);
+        REQUIRE(tree.size() == mesh.size());
+
+        WHEN("Finding intersections with all triangles inserted") {
+            THEN("Result should match brute force search") {
+                for (const auto& ray : random_rays(100, 1)) {
+                    REQUIRE_THAT(ray.intersects(tree), Catch::Matchers::UnorderedEquals(ray.intersects(mesh)));
+                }
+            }
+        }
+
+        WHEN("Removing triangles with odd index") {
+            rmi::DynamicTree<TriangularMesh> edited;
+            std::vector<rmi::DynamicTree<TriangularMesh>::handle> odd;
+            for (const auto& element : mesh) {
+                auto leaf = edited.insert(element);
+                if (element.index % 2 == 1) {
+                    odd.push_back(leaf);
+                }
+            }
+            for (auto leaf : odd) {
+                edited.remove(leaf);
+            }
+
+            THEN("Tree should find intersections only with remaining triangles") {
+                REQUIRE(edited.size() == mesh.size() - odd.size());
+
+                for (const auto& ray : random_rays(100, 2)) {
+                    const auto expected = even_intersections(ray, mesh);
+                    REQUIRE_THAT(ray.intersects(edited), Catch::Matchers::UnorderedEquals(expected));
+                    #ifdef RMI_INCLUDE_POOL
+                    REQUIRE_THAT(ray.pool_intersects(edited, 2), Catch::Matchers::UnorderedEquals(expected));
+                    #endif
+                    #ifdef RMI_INCLUDE_OMP
+                    REQUIRE_THAT(ray.omp_intersects(edited, 2), Catch::Matchers::UnorderedEquals(expected));
+                    #endif
+                }
+            }
+        }
+
+        WHEN("Removing all triangles") {
+            auto empty = rmi::DynamicTree<TriangularMesh>();
+            auto leaf = empty.insert(*mesh.begin());
+            empty.remove(leaf);
+            THEN("Tree should be empty") {
+                REQUIRE(empty.empty());
+                REQUIRE(random_rays(1, 3)[0].intersects(empty).empty());
+            }
+        }
+    }
+}
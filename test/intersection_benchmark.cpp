@@ -10,6 +10,11 @@
 #include "rmilib/raw_mesh.hpp"
 #include "rmilib/reader.hpp"
 #include "rmilib/rmi.hpp"
+#include "rmilib/quantized_tree.hpp"
+#include "rmilib/dynamic_tree.hpp"
+#include "rmilib/perf_counters.hpp"
+#include "rmilib/ray_generator.hpp"
+#include "rmilib/mesh_intersection.hpp"
 
 
 const std::string filename = "../../data/Fantasy_Castle.stl";
@@ -47,6 +52,52 @@ std::string concat(const Args&... args) {
 }
 
 
+// Prints traversal counters averaged per ray and resets them, does nothing without RMI_ENABLE_STATS
+void print_traversal_stats([[maybe_unused]] const std::string& name) {
+#ifdef RMI_ENABLE_STATS
+    auto& stats = rmi::traversal_stats();
+    const double rays = std::max<size_t>(stats.rays, 1);
+    std::cout << name << " per ray: "
+              << stats.nodes_visited / rays << " nodes visited, "
+              << stats.box_tests / rays << " box tests, "
+              << stats.triangle_tests / rays << " triangle tests, "
+              << stats.hits / rays << " hits, "
+              << "max stack depth " << stats.max_stack_depth << std::endl
+              << "  " << stats.to_json() << std::endl;
+    stats = {};
+#endif
+}
+
+
+// Runs query for every ray under hardware counters and prints values per ray.
+// Does nothing when counters are unavailable (e.g. in containers).
+template<typename Query>
+void print_perf_counters(const std::string& name, const std::vector<rmi::Ray<double>>& rays, Query query) {
+    static rmi::PerfCounters counters;
+    if (!counters.available() || rays.empty()) {
+        return;
+    }
+
+    size_t hits = 0;
+    counters.start();
+    for (const auto& ray : rays) {
+        hits += query(ray).size();
+    }
+    const auto sample = counters.stop();
+
+    std::cout << name << " (" << hits << " hits) per ray: " << sample.to_string(rays.size()) << std::endl;
+}
+
+std::vector<rmi::Ray<double>> generate_rays(size_t count) {
+    generator.reset();
+    std::vector<rmi::Ray<double>> rays;
+    for (size_t i = 0; i < count; ++i) {
+        rays.push_back(generator.next_ray());
+    }
+    return rays;
+}
+
+
 TEST_CASE("Mesh intersection", "[benchmark][ray][mesh]") {
     generator.reset();
     BENCHMARK_ADVANCED(concat("Sequential search ", mesh.size()))(auto meter) {
@@ -70,12 +121,17 @@ TEST_CASE("Mesh intersection", "[benchmark][ray][mesh]") {
 
 TEST_CASE("KD-Tree intersection", "[benchmark][ray][kdtree]") {
     auto tree = rmi::KDTree<TriangularMesh>::for_mesh(mesh, Splitter());
+    const auto perf_rays = generate_rays(1000);
 
     generator.reset();
     BENCHMARK_ADVANCED(concat("Sync KD-Tree search "))(auto meter) {
         auto ray = generator.next_ray();
         meter.measure([&ray, &tree] { return ray.intersects(tree); });
     };
+    print_traversal_stats("Sync KD-Tree search");
+    print_perf_counters("Sync KD-Tree search", perf_rays, [&tree](const auto& ray) {
+        return ray.intersects(tree);
+    });
 
 #ifdef RMI_INCLUDE_OMP
     for (int threads_count = 2; threads_count <= 8; threads_count *= 2) {
@@ -88,6 +144,10 @@ TEST_CASE("KD-Tree intersection", "[benchmark][ray][kdtree]") {
                 return ray.omp_intersects(tree, threads_count);
             });
         };
+        print_traversal_stats(concat("OMP (", threads_count, " threads) KD-Tree search"));
+        print_perf_counters(concat("OMP (", threads_count, " threads) KD-Tree search (calling thread)"), perf_rays, [&tree, threads_count](const auto& ray) {
+            return ray.omp_intersects(tree, threads_count);
+        });
     }
 #endif
 
@@ -102,6 +162,134 @@ TEST_CASE("KD-Tree intersection", "[benchmark][ray][kdtree]") {
                 return ray.pool_intersects(tree, threads_count);
             });
         };
+        print_traversal_stats(concat("Thread pool (", threads_count, " threads) KD-Tree search"));
+        print_perf_counters(concat("Thread pool (", threads_count, " threads) KD-Tree search (calling thread)"), perf_rays, [&tree, threads_count](const auto& ray) {
+            return ray.pool_intersects(tree, threads_count);
+        });
+    }
+#endif
+}
+
+
+TEST_CASE("KD-Tree intersection workloads", "[benchmark][ray][kdtree][workload]") {
+    auto tree = rmi::KDTree<TriangularMesh>::for_mesh(mesh, Splitter());
+    const std::pair<const char*, rmi::Workload> workloads[] = {
+        {"camera", rmi::Workload::Camera},
+        {"secondary", rmi::Workload::Secondary},
+        {"segments", rmi::Workload::Segments},
+        {"scanlines", rmi::Workload::Scanlines},
+        {"uniform", rmi::Workload::Uniform}
+    };
+
+    for (const auto& [name, workload] : workloads) {
+        const auto rays = rmi::generate_rays<double>(workload, mesh, 1000, 1);
+        BENCHMARK(concat("Sync KD-Tree search of ", rays.size(), " ", name, " rays")) {
+            size_t hits = 0;
+            for (const auto& ray : rays) {
+                hits += ray.intersects(tree).size();
+            }
+            return hits;
+        };
+        print_perf_counters(concat("Sync KD-Tree search of ", name, " rays"), rays, [&tree](const auto& ray) {
+            return ray.intersects(tree);
+        });
+    }
+
+    // the same segments without the interval, hits behind the target are filtered after the search
+    std::vector<rmi::Segment<double>> segments = rmi::segment_rays<double>(mesh, 1000, 1);
+    BENCHMARK(concat("Sync KD-Tree search of ", segments.size(), " segments as full rays")) {
+        size_t hits = 0;
+        for (const auto& segment : segments) {
+            const rmi::Ray<double> ray(segment.ray.origin(), segment.ray.direction());
+            for (const auto& point : ray.intersects(tree)) {
+                hits += (point - ray.origin()).length() <= segment.length;
+            }
+        }
+        return hits;
+    };
+}
+
+
+TEST_CASE("Quantized KD-Tree intersection", "[benchmark][ray][kdtree][quantized]") {
+    auto tree = rmi::KDTree<TriangularMesh>::for_mesh(mesh, Splitter());
+    auto tree8 = rmi::QuantizedKDTree<TriangularMesh, uint8_t>::from_tree(tree);
+    auto tree16 = rmi::QuantizedKDTree<TriangularMesh, uint16_t>::from_tree(tree);
+
+    const size_t tree_bytes = tree.stats().nodes_count * sizeof(rmi::KDTree<TriangularMesh>::Node);
+    std::cout << "KD-Tree nodes: " << tree_bytes << " bytes, "
+              << "8-bit: " << tree8.memory_usage() << " bytes, "
+              << "16-bit: " << tree16.memory_usage() << " bytes" << std::endl;
+
+    generator.reset();
+    BENCHMARK_ADVANCED(concat("Sync 8-bit quantized KD-Tree search "))(auto meter) {
+        auto ray = generator.next_ray();
+        meter.measure([&ray, &tree8] { return tree8.intersects(ray); });
+    };
+
+    generator.reset();
+    BENCHMARK_ADVANCED(concat("Sync 16-bit quantized KD-Tree search "))(auto meter) {
+        auto ray = generator.next_ray();
+        meter.measure([&ray, &tree16] { return tree16.intersects(ray); });
+    };
+}
+
+
+TEST_CASE("Dynamic tree intersection", "[benchmark][ray][dynamic]") {
+    rmi::DynamicTree<TriangularMesh> tree;
+    std::vector<rmi::DynamicTree<TriangularMesh>::handle> leaves;
+    for (const auto& element : mesh) {
+        leaves.push_back(tree.insert(element));
+    }
+
+    generator.reset();
+    BENCHMARK_ADVANCED(concat("Fresh dynamic tree search "))(auto meter) {
+        auto ray = generator.next_ray();
+        meter.measure([&ray, &tree] { return ray.intersects(tree); });
+    };
+    print_traversal_stats("Fresh dynamic tree search");
+
+    // quality drift: every triangle is removed and reinserted in random order
+    std::shuffle(leaves.begin(), leaves.end(), std::default_random_engine(7));
+    for (auto& leaf : leaves) {
+        const auto element = *leaf->begin();
+        tree.remove(leaf);
+        leaf = tree.insert(element);
+    }
+
+    generator.reset();
+    BENCHMARK_ADVANCED(concat("Edited dynamic tree search "))(auto meter) {
+        auto ray = generator.next_ray();
+        meter.measure([&ray, &tree] { return ray.intersects(tree); });
+    };
+    print_traversal_stats("Edited dynamic tree search");
+}
+
+
+TEST_CASE("Mesh to mesh intersection", "[benchmark][contacts][kdtree]") {
+    auto tree = rmi::KDTree<TriangularMesh>::for_mesh(mesh, Splitter());
+    const auto extent = tree.top().box().max - tree.top().box().min;
+
+    // the same mesh moved by 1% of its extent, so most of surfaces cross each other
+    auto vertices = mesh.vertices();
+    for (size_t i = 0; i < vertices.size(); i += 3) {
+        vertices[i] += extent.x() * 0.01;
+    }
+    auto indices = mesh.indices();
+    TriangularMesh moved(std::move(vertices), std::move(indices));
+    auto moved_tree = rmi::KDTree<TriangularMesh>::for_mesh(moved, Splitter());
+
+    BENCHMARK("Dual tree traversal") {
+        return rmi::mesh_intersections(tree, moved_tree).size();
+    };
+    BENCHMARK("Dual tree traversal with segments") {
+        return rmi::mesh_intersections(tree, moved_tree, true).size();
+    };
+
+#ifdef RMI_INCLUDE_POOL
+    for (int threads_count = 2; threads_count <= 8; threads_count *= 2) {
+        BENCHMARK(concat("Pool <", threads_count, "> dual tree traversal")) {
+            return rmi::pool_mesh_intersections(tree, moved_tree, threads_count).size();
+        };
     }
 #endif
 }
@@ -0,0 +1,226 @@
+#include <catch2/catch.hpp>
+
+#include <numeric>
+#include <random>
+#include "rmilib/rmi.hpp"
+#include "rmilib/raw_mesh.hpp"
+
+
+// Flat grid of size x size quads in XY plane
+TriangularMesh grid_mesh(size_t size) {
+    std::vector<double> coords;
+    std::vector<size_t> indices;
+    for (size_t i = 0; i <= size; ++i) {
+        for (size_t j = 0; j <= size; ++j) {
+            coords.push_back(static_cast<double>(i));
+            coords.push_back(static_cast<double>(j));
+            coords.push_back(0);
+        }
+    }
+    for (size_t i = 0; i < size; ++i) {
+        for (size_t j = 0; j < size; ++j) {
+            const size_t v = i * (size + 1) + j;
+            indices.push_back(v);     indices.push_back(v + 1);        indices.push_back(v + size + 1);
+            indices.push_back(v + 1); indices.push_back(v + size + 2); indices.push_back(v + size + 1);
+        }
+    }
+    return TriangularMesh(std::move(coords), std::move(indices));
+}
+
+// Bends grid along X axis
+void deform(TriangularMesh& mesh, double amplitude) {
+    auto& vertices = mesh.vertices();
+    for (size_t i = 0; i < vertices.size(); i += 3) {
+        vertices[i + 2] = amplitude * std::sin(vertices[i] * 0.3) + 0.05 * vertices[i + 1];
+    }
+}
+
+template<typename Tree>
+void require_same_intersections(TriangularMesh& mesh, const Tree& tree, int seed) {
+    std::default_random_engine engine(seed);
+    std::uniform_real_distribution<> dist(0, 32);
+    for (int i = 0; i < 100; ++i) {
+        rmi::Ray<double> ray(
+            rmi::Vector3d(dist(engine), dist(engine), 20),
+            rmi::Vector3d(dist(engine) - 16, dist(engine) - 16, -20)
+        );
+        REQUIRE_THAT(
+            ray.intersects(tree),
+            Catch::Matchers::UnorderedEquals(ray.intersects(mesh))
+        );
+    }
+}
+
+
+TEST_CASE("Tree refitting", "[kdtree][refit]") {
+    GIVEN("Grid mesh and tree built for it") {
+        TriangularMesh mesh = grid_mesh(32);
+        auto tree = rmi::KDTree<TriangularMesh>::for_mesh(mesh);
+
+        deform(mesh, 5);
+
+        WHEN("Refitting tree after vertices moved") {
+            tree.refit(mesh);
+            THEN("Root box should bound deformed mesh") {
+                REQUIRE(tree.top().box().min.z() == Approx(-5).margin(0.1));
+                REQUIRE(tree.top().box().max.z() == Approx(5 + 0.05 * 32).margin(0.1));
+            }
+            THEN("Intersections should match brute force search") {
+                require_same_intersections(mesh, tree, 1);
+            }
+        }
+
+        WHEN("Refitting tree with rebuilding of degraded subtrees") {
+            tree.refit(mesh, 0.1, rmi::SAHSplitter<TriangularMesh>());
+            THEN("Intersections should match brute force search") {
+                require_same_intersections(mesh, tree, 2);
+            }
+        }
+
+        #ifdef RMI_INCLUDE_OMP
+        WHEN("Refitting tree in parallel") {
+            tree.refit(mesh, 2);
+            THEN("Intersections should match brute force search") {
+                require_same_intersections(mesh, tree, 3);
+            }
+        }
+
+        WHEN("Refitting tree in parallel with rebuilding of degraded subtrees") {
+            tree.refit(mesh, 2, 0.1, rmi::MedianSplitter<TriangularMesh>());
+            THEN("Intersections should match brute force search") {
+                require_same_intersections(mesh, tree, 4);
+            }
+        }
+        #endif
+    }
+}
+
+
+template<typename Tree>
+void require_consistent_stats(const rmi::TreeStats& stats, const Tree&, size_t mesh_size) {
+    REQUIRE(stats.nodes_count == 2 * stats.leaves_count - 1);
+    REQUIRE(std::accumulate(stats.depth_histogram.begin(), stats.depth_histogram.end(), size_t(0)) == stats.leaves_count);
+    REQUIRE(std::accumulate(stats.leaf_size_histogram.begin(), stats.leaf_size_histogram.end(), size_t(0)) == stats.leaves_count);
+    REQUIRE(stats.nodes_bytes == stats.nodes_count * sizeof(typename Tree::Node));
+    REQUIRE(stats.elements_bytes == mesh_size * sizeof(rmi::Mesh<TriangularMesh>::Element));
+    // every triangle is tested at least once when all leaves are visited
+    REQUIRE(stats.sah_cost >= 1);
+    REQUIRE(stats.overlap >= 0);
+    REQUIRE(stats.timings.total > 0);
+    REQUIRE(stats.timings.splitting > 0);
+}
+
+
+TEST_CASE("Tree statistics", "[kdtree][stats]") {
+    TriangularMesh mesh = grid_mesh(32);
+    deform(mesh, 5);
+
+    WHEN("Tree is built with SAH splitter") {
+        const auto tree = rmi::KDTree<TriangularMesh>::for_mesh(mesh, rmi::SAHSplitter<TriangularMesh>(4));
+        const auto stats = tree.stats();
+        THEN("Statistics should be consistent") {
+            require_consistent_stats(stats, tree, mesh.size());
+            REQUIRE(stats.leaf_size_histogram.size() <= 3);
+            REQUIRE(stats.timings.splitting <= stats.timings.total);
+        }
+    }
+
+    WHEN("Tree is built with median splitter") {
+        const auto tree = rmi::KDTree<TriangularMesh>::for_mesh(mesh, rmi::MedianSplitter<TriangularMesh>(3));
+        const auto stats = tree.stats();
+        THEN("Statistics should be consistent") {
+            require_consistent_stats(stats, tree, mesh.size());
+            REQUIRE(stats.depth_histogram.size() == 4);
+            REQUIRE(stats.depth_histogram.back() == 8);
+        }
+    }
+
+    #ifdef RMI_INCLUDE_OMP
+    WHEN("Tree is built in parallel") {
+        const auto tree = rmi::KDTree<TriangularMesh>::for_mesh(mesh, 2, rmi::SAHSplitter<TriangularMesh>());
+        THEN("Statistics should be consistent") {
+            require_consistent_stats(tree.stats(), tree, mesh.size());
+        }
+    }
+    #endif
+}
+
+
+TEST_CASE("SAH splitting of flat mesh", "[kdtree][sah]") {
+    TriangularMesh mesh = grid_mesh(32);
+
+    WHEN("Tree is built with SAH splitter") {
+        const auto tree = rmi::KDTree<TriangularMesh>::for_mesh(mesh, rmi::SAHSplitter<TriangularMesh>(4));
+        const auto stats = tree.stats();
+        THEN("Flat nodes should be split down to small leaves") {
+            require_consistent_stats(stats, tree, mesh.size());
+            REQUIRE(stats.leaves_count >= mesh.size() / 8);
+            REQUIRE(stats.leaf_size_histogram.size() <= 3);
+            require_same_intersections(mesh, tree, 7);
+        }
+    }
+}
+
+
+#ifdef RMI_INCLUDE_OMP
+TEST_CASE("Parallel splitting of large nodes", "[kdtree][omp]") {
+    TriangularMesh mesh = grid_mesh(100);
+    deform(mesh, 5);
+    // splitters sort and evaluate nodes of at least 1024 elements by several tasks
+    const size_t parallel_threshold = 1024;
+
+    WHEN("Tree is built with SAH splitter") {
+        const auto sequential = rmi::KDTree<TriangularMesh>::for_mesh(mesh, rmi::SAHSplitter<TriangularMesh>(16, parallel_threshold));
+        const auto parallel = rmi::KDTree<TriangularMesh>::for_mesh(mesh, 4, rmi::SAHSplitter<TriangularMesh>(16, parallel_threshold));
+        THEN("It should be as good as sequentially built one") {
+            require_consistent_stats(parallel.stats(), parallel, mesh.size());
+            REQUIRE(parallel.stats().sah_cost == Approx(sequential.stats().sah_cost).epsilon(0.01));
+            require_same_intersections(mesh, parallel, 5);
+        }
+    }
+
+    WHEN("Tree is built with median splitter") {
+        const auto sequential = rmi::KDTree<TriangularMesh>::for_mesh(mesh, rmi::MedianSplitter<TriangularMesh>(8, parallel_threshold));
+        const auto parallel = rmi::KDTree<TriangularMesh>::for_mesh(mesh, 4, rmi::MedianSplitter<TriangularMesh>(8, parallel_threshold));
+        THEN("It should have the same shape as sequentially built one") {
+            REQUIRE(parallel.stats().depth_histogram == sequential.stats().depth_histogram);
+            REQUIRE(parallel.stats().leaf_size_histogram == sequential.stats().leaf_size_histogram);
+            require_same_intersections(mesh, parallel, 6);
+        }
+    }
+}
+#endif
+
+
+#ifdef RMI_INCLUDE_POOL
+TEST_CASE("Thread pool build", "[kdtree][pool]") {
+    TriangularMesh mesh = grid_mesh(100);
+    deform(mesh, 5);
+
+    WHEN("Tree is built with SAH splitter") {
+        const auto sequential = rmi::KDTree<TriangularMesh>::for_mesh(mesh, rmi::SAHSplitter<TriangularMesh>(4));
+        const auto tree = rmi::KDTree<TriangularMesh>::pool_for_mesh(mesh, 4, rmi::SAHSplitter<TriangularMesh>(4));
+        THEN("It should be as good as sequentially built one") {
+            require_consistent_stats(tree.stats(), tree, mesh.size());
+            REQUIRE(tree.stats().sah_cost == Approx(sequential.stats().sah_cost).epsilon(0.01));
+            require_same_intersections(mesh, tree, 7);
+        }
+    }
+
+    WHEN("Tree is built with median splitter") {
+        const auto sequential = rmi::KDTree<TriangularMesh>::for_mesh(mesh, rmi::MedianSplitter<TriangularMesh>(10));
+        const auto tree = rmi::KDTree<TriangularMesh>::pool_for_mesh(mesh, 3, rmi::MedianSplitter<TriangularMesh>(10));
+        THEN("It should have the same shape as sequentially built one") {
+            REQUIRE(tree.stats().depth_histogram == sequential.stats().depth_histogram);
+            require_same_intersections(mesh, tree, 8);
+        }
+    }
+
+    WHEN("Pool has one thread") {
+        const auto tree = rmi::KDTree<TriangularMesh>::pool_for_mesh(mesh, 1);
+        THEN("It should build the whole tree") {
+            require_consistent_stats(tree.stats(), tree, mesh.size());
+        }
+    }
+}
+#endif
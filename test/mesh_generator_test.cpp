@@ -0,0 +1,61 @@
+#include <catch2/catch.hpp>
+
+#include "rmilib/rmi.hpp"
+#include "rmilib/mesh_generator.hpp"
+
+
+template<typename Mesh>
+void require_in_cube(Mesh& mesh) {
+    const auto box = rmi::get_bounding_box<Mesh>(mesh.begin(), mesh.end());
+    REQUIRE(box.min.x() >= -1); REQUIRE(box.min.y() >= -1); REQUIRE(box.min.z() >= -1);
+    REQUIRE(box.max.x() <= 1);  REQUIRE(box.max.y() <= 1);  REQUIRE(box.max.z() <= 1);
+}
+
+
+TEST_CASE("Procedural meshes", "[generator]") {
+    const size_t size = 20000;
+
+    WHEN("Generating sphere") {
+        auto mesh = generate_sphere_mesh<double, size_t>(size);
+        THEN("It should be closed surface of about requested size") {
+            REQUIRE(mesh.size() == Approx(size).epsilon(0.05));
+            require_in_cube(mesh);
+
+            const auto tree = rmi::KDTree<TriangularMesh>::for_mesh(mesh);
+            for (const auto& direction : {rmi::Vector3d(1, 0.2, 0.3), rmi::Vector3d(-0.1, -1, 0.7), rmi::Vector3d(0.01, 0.02, -1)}) {
+                const rmi::Ray<double> ray(rmi::Vector3d(0.01, 0.02, 0.03), direction);
+                REQUIRE(ray.intersects(tree).size() == 1);
+            }
+        }
+    }
+
+    WHEN("Generating other meshes") {
+        auto terrain = generate_terrain_mesh<double, size_t>(size, 1);
+        auto soup = generate_soup_mesh<double, size_t>(size, 1);
+        auto slivers = generate_slivers_mesh<double, size_t>(size, 1);
+        THEN("They should be of about requested size") {
+            REQUIRE(terrain.size() == Approx(size).epsilon(0.05));
+            REQUIRE(soup.size() == size);
+            REQUIRE(slivers.size() == Approx(size).epsilon(0.05));
+            require_in_cube(terrain);
+            require_in_cube(soup);
+            require_in_cube(slivers);
+        }
+        THEN("The same seed should give the same mesh") {
+            REQUIRE(generate_soup_mesh<double, size_t>(size, 1).vertices() == soup.vertices());
+            REQUIRE(generate_soup_mesh<double, size_t>(size, 2).vertices() != soup.vertices());
+        }
+    }
+
+    WHEN("Generating soup of a few triangles") {
+        THEN("It should still fit into the cube") {
+            for (size_t count = 0; count < 10; ++count) {
+                auto small = generate_soup_mesh<double, size_t>(count, 1);
+                REQUIRE(small.size() == count);
+                if (count > 0) {
+                    require_in_cube(small);
+                }
+            }
+        }
+    }
+}
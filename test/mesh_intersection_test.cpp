@@ -0,0 +1,233 @@
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <utility>
+#include "rmilib/rmi.hpp"
+#include "rmilib/raw_mesh.hpp"
+#include "rmilib/mesh_generator.hpp"
+#include "rmilib/dynamic_tree.hpp"
+#include "rmilib/mesh_intersection.hpp"
+
+
+using Triangle = std::array<rmi::Vector3d, 3>;
+
+TriangularMesh shifted_mesh(const TriangularMesh& mesh, const rmi::Vector3d& offset) {
+    auto vertices = mesh.vertices();
+    for (size_t i = 0; i < vertices.size(); i += 3) {
+        vertices[i + 0] += offset.x();
+        vertices[i + 1] += offset.y();
+        vertices[i + 2] += offset.z();
+    }
+    auto indices = mesh.indices();
+    return TriangularMesh(std::move(vertices), std::move(indices));
+}
+
+std::vector<Triangle> triangles(TriangularMesh& mesh) {
+    std::vector<Triangle> result(mesh.size());
+    for (const auto& triangle : mesh) {
+        result[triangle.index] = {triangle.v1, triangle.v2, triangle.v3};
+    }
+    return result;
+}
+
+// Whether point of z = 0 plane is inside triangle of this plane
+bool in_plane_triangle(const rmi::Vector3d& p, const Triangle& t) {
+    bool negative = false, positive = false;
+    for (int i = 0; i < 3; ++i) {
+        const auto side = (t[(i + 1) % 3] - t[i]).cross(p - t[i]).z();
+        negative = negative || side < -1e-12;
+        positive = positive || side > 1e-12;
+    }
+    return p.z() == Approx(0).margin(1e-12) && !(negative && positive);
+}
+
+template<typename Contacts>
+std::vector<std::pair<size_t, size_t>> sorted_pairs(const Contacts& contacts) {
+    std::vector<std::pair<size_t, size_t>> pairs;
+    for (const auto& contact : contacts) {
+        pairs.emplace_back(contact.first, contact.second);
+    }
+    std::sort(pairs.begin(), pairs.end());
+    return pairs;
+}
+
+std::vector<std::pair<size_t, size_t>> brute_force_pairs(TriangularMesh& a, TriangularMesh& b) {
+    const auto first = triangles(a);
+    const auto second = triangles(b);
+    std::vector<std::pair<size_t, size_t>> pairs;
+    rmi::Vector3d from, to;
+    for (size_t i = 0; i < first.size(); ++i) {
+        for (size_t j = 0; j < second.size(); ++j) {
+            if (rmi::triangles_intersect(first[i], second[j], from, to)) {
+                pairs.emplace_back(i, j);
+            }
+        }
+    }
+    return pairs;
+}
+
+
+TEST_CASE("Triangle triangle intersection", "[contacts]") {
+    const Triangle base = {rmi::Vector3d(0, 0, 0), rmi::Vector3d(2, 0, 0), rmi::Vector3d(0, 2, 0)};
+    rmi::Vector3d from, to;
+
+    GIVEN("Triangle piercing the base one") {
+        const Triangle other = {rmi::Vector3d(0.5, 0.5, -1), rmi::Vector3d(0.5, 0.5, 1), rmi::Vector3d(0.5, 3, 1)};
+        THEN("Segment should lie on both triangles") {
+            REQUIRE(rmi::triangles_intersect(base, other, from, to));
+            REQUIRE(from.z() == Approx(0).margin(1e-12));
+            REQUIRE(to.z() == Approx(0).margin(1e-12));
+            REQUIRE(from.x() == Approx(0.5));
+            REQUIRE(to.x() == Approx(0.5));
+            REQUIRE(std::min(from.y(), to.y()) == Approx(0.5));
+            REQUIRE(std::max(from.y(), to.y()) == Approx(1.5));
+        }
+    }
+
+    GIVEN("Triangle touching the base one by vertex") {
+        const Triangle other = {rmi::Vector3d(0.5, 0.5, 0), rmi::Vector3d(0.5, 0.5, 1), rmi::Vector3d(1, 0.5, 1)};
+        THEN("Contact should be a point") {
+            REQUIRE(rmi::triangles_intersect(base, other, from, to));
+            REQUIRE((from - rmi::Vector3d(0.5, 0.5, 0)).length() == Approx(0).margin(1e-12));
+            REQUIRE((to - rmi::Vector3d(0.5, 0.5, 0)).length() == Approx(0).margin(1e-12));
+        }
+    }
+
+    GIVEN("Triangle crossing plane of the base one outside of it") {
+        const Triangle other = {rmi::Vector3d(3, 3, -1), rmi::Vector3d(3, 3, 1), rmi::Vector3d(4, 2, 1)};
+        THEN("They should not intersect") {
+            REQUIRE_FALSE(rmi::triangles_intersect(base, other, from, to));
+        }
+    }
+
+    GIVEN("Coplanar triangles") {
+        const Triangle overlapping = {rmi::Vector3d(1, 1, 0), rmi::Vector3d(3, 1, 0), rmi::Vector3d(1, 3, 0)};
+        const Triangle inner = {rmi::Vector3d(0.1, 0.1, 0), rmi::Vector3d(0.5, 0.1, 0), rmi::Vector3d(0.1, 0.5, 0)};
+        const Triangle separated = {rmi::Vector3d(1.5, 1.5, 0), rmi::Vector3d(3, 1.5, 0), rmi::Vector3d(1.5, 3, 0)};
+        THEN("Overlap should be found in the common plane") {
+            REQUIRE(rmi::triangles_intersect(base, inner, from, to));
+            REQUIRE(rmi::triangles_intersect(inner, base, from, to));
+            REQUIRE_FALSE(rmi::triangles_intersect(base, separated, from, to));
+        }
+        THEN("Common point should belong to both triangles") {
+            // the triangles share only the vertex of the second one
+            REQUIRE(rmi::triangles_intersect(base, overlapping, from, to));
+            REQUIRE(from.x() == Approx(1));
+            REQUIRE(from.y() == Approx(1));
+            REQUIRE(from.z() == Approx(0));
+            REQUIRE(to == from);
+
+            // edges cross, but no vertex lies in the other triangle
+            const Triangle crossing = {rmi::Vector3d(-1, 0.5, 0), rmi::Vector3d(3, 0.5, 0), rmi::Vector3d(1, -1, 0)};
+            REQUIRE(rmi::triangles_intersect(base, crossing, from, to));
+            REQUIRE(in_plane_triangle(from, base));
+            REQUIRE(in_plane_triangle(from, crossing));
+            REQUIRE(to == from);
+        }
+    }
+
+    GIVEN("Zero-area triangles") {
+        const Triangle far = {rmi::Vector3d(10, 10, -1), rmi::Vector3d(10, 10, 0), rmi::Vector3d(10, 10, 1)};
+        const Triangle piercing = {rmi::Vector3d(0.5, 0.5, -1), rmi::Vector3d(0.5, 0.5, 1), rmi::Vector3d(0.5, 0.5, 0.2)};
+        const Triangle lying = {rmi::Vector3d(-1, 0.5, 0), rmi::Vector3d(3, 0.5, 0), rmi::Vector3d(1, 0.5, 0)};
+        const Triangle point = {rmi::Vector3d(0.5, 0.5, 0), rmi::Vector3d(0.5, 0.5, 0), rmi::Vector3d(0.5, 0.5, 0)};
+        THEN("Segment far from the base one should not touch it") {
+            REQUIRE_FALSE(rmi::triangles_intersect(base, far, from, to));
+            REQUIRE_FALSE(rmi::triangles_intersect(far, base, from, to));
+        }
+        THEN("Segment crossing the base one should be found at the crossing") {
+            REQUIRE(rmi::triangles_intersect(base, piercing, from, to));
+            REQUIRE((from - rmi::Vector3d(0.5, 0.5, 0)).length() == Approx(0).margin(1e-12));
+            REQUIRE(to == from);
+            REQUIRE(rmi::triangles_intersect(piercing, base, from, to));
+            REQUIRE((from - rmi::Vector3d(0.5, 0.5, 0)).length() == Approx(0).margin(1e-12));
+        }
+        THEN("Segment in the plane of the base one should be found inside it") {
+            REQUIRE(rmi::triangles_intersect(lying, base, from, to));
+            REQUIRE(in_plane_triangle(from, base));
+            REQUIRE(std::abs(from.y() - 0.5) < 1e-12);
+        }
+        THEN("Two zero-area triangles should not intersect") {
+            REQUIRE_FALSE(rmi::triangles_intersect(point, piercing, from, to));
+            REQUIRE_FALSE(rmi::triangles_intersect(far, far, from, to));
+        }
+    }
+
+    GIVEN("Triangle lifted above the base one by rounding error") {
+        const Triangle lifted = {rmi::Vector3d(0.1, 0.1, 1e-17), rmi::Vector3d(0.5, 0.1, -1e-17), rmi::Vector3d(0.1, 0.5, 1e-17)};
+        THEN("They should be taken as coplanar") {
+            REQUIRE(rmi::triangles_intersect(base, lifted, from, to));
+            REQUIRE(to == from);
+        }
+    }
+}
+
+TEST_CASE("Mesh to mesh intersection", "[contacts][kdtree]") {
+    GIVEN("Two overlapping spheres") {
+        TriangularMesh first = generate_sphere_mesh<double, size_t>(5000);
+        TriangularMesh second = shifted_mesh(first, rmi::Vector3d(1, 0, 0));
+        const auto first_tree = rmi::KDTree<TriangularMesh>::for_mesh(first);
+        const auto second_tree = rmi::KDTree<TriangularMesh>::for_mesh(second);
+
+        WHEN("Searching contacts with segments") {
+            const auto contacts = rmi::mesh_intersections(first_tree, second_tree, true);
+            THEN("Segments should lie near the circle of spheres intersection") {
+                REQUIRE(contacts.size() > 0);
+                // tessellation is inscribed in unit spheres
+                for (const auto& contact : contacts) {
+                    for (const auto& p : {contact.from, contact.to}) {
+                        REQUIRE(p.x() == Approx(0.5).margin(0.05));
+                        REQUIRE(std::hypot(p.y(), p.z()) == Approx(std::sqrt(0.75)).margin(0.05));
+                    }
+                }
+            }
+
+            THEN("Pairs should match brute force search") {
+                REQUIRE(sorted_pairs(contacts) == brute_force_pairs(first, second));
+            }
+        }
+
+        #ifdef RMI_INCLUDE_POOL
+        WHEN("Searching contacts in pool") {
+            THEN("Pairs should be the same as sequential ones") {
+                const auto expected = sorted_pairs(rmi::mesh_intersections(first_tree, second_tree));
+                REQUIRE(sorted_pairs(rmi::pool_mesh_intersections(first_tree, second_tree, 4)) == expected);
+            }
+        }
+        #endif
+
+        WHEN("Second mesh is in dynamic tree") {
+            const auto dynamic = rmi::DynamicTree<TriangularMesh>::for_mesh(second);
+            THEN("Pairs should be the same") {
+                REQUIRE(
+                    sorted_pairs(rmi::mesh_intersections(first_tree, dynamic)) ==
+                    sorted_pairs(rmi::mesh_intersections(first_tree, second_tree))
+                );
+            }
+        }
+    }
+
+    GIVEN("Separated meshes") {
+        TriangularMesh first = generate_soup_mesh<double, size_t>(2000, 13);
+        TriangularMesh second = shifted_mesh(first, rmi::Vector3d(0, 5, 0));
+        const auto first_tree = rmi::KDTree<TriangularMesh>::for_mesh(first);
+        const auto second_tree = rmi::KDTree<TriangularMesh>::for_mesh(second);
+        THEN("No contacts should be found") {
+            REQUIRE(rmi::mesh_intersections(first_tree, second_tree).empty());
+        }
+    }
+
+    GIVEN("Random triangles soups") {
+        TriangularMesh first = generate_soup_mesh<double, size_t>(1000, 14);
+        TriangularMesh second = generate_soup_mesh<double, size_t>(1000, 15);
+        const auto first_tree = rmi::KDTree<TriangularMesh>::for_mesh(first);
+        const auto second_tree = rmi::KDTree<TriangularMesh>::for_mesh(second);
+        THEN("Pairs should match brute force search") {
+            const auto actual = sorted_pairs(rmi::mesh_intersections(first_tree, second_tree));
+            REQUIRE(actual.size() > 0);
+            REQUIRE(actual == brute_force_pairs(first, second));
+        }
+    }
+}
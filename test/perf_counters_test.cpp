@@ -0,0 +1,51 @@
+#include <catch2/catch.hpp>
+
+#include "rmilib/perf_counters.hpp"
+
+
+TEST_CASE("Hardware performance counters", "[perf]") {
+    rmi::PerfCounters counters;
+
+    counters.start();
+    volatile double sum = 0;
+    for (int i = 0; i < 1000000; ++i) {
+        sum = sum + i * 0.5;
+    }
+    const auto sample = counters.stop();
+
+    if (counters.available()) {
+        THEN("Supported counters should see the loop") {
+            if (sample.instructions) {
+                REQUIRE(*sample.instructions > 1000000);
+            }
+            if (sample.ipc()) {
+                REQUIRE(*sample.ipc() > 0);
+            }
+        }
+    } else {
+        THEN("Sample should be empty") {
+            REQUIRE_FALSE(sample.cycles);
+            REQUIRE_FALSE(sample.instructions);
+            REQUIRE_FALSE(sample.l1d_misses);
+            REQUIRE_FALSE(sample.llc_misses);
+            REQUIRE_FALSE(sample.branch_misses);
+            REQUIRE_FALSE(sample.ipc());
+        }
+    }
+}
+
+
+TEST_CASE("Printing performance sample", "[perf]") {
+    rmi::PerfSample sample;
+    sample.cycles = 200;
+    sample.instructions = 100;
+
+    THEN("Empty values should be n/a") {
+        REQUIRE(sample.to_string() == "200 cycles, 100 instructions, IPC 0.500000, "
+                                      "n/a L1D misses, n/a LLC misses, n/a branch misses");
+    }
+    THEN("Values should be divided by count") {
+        REQUIRE(sample.to_string(4) == "50.000000 cycles, 25.000000 instructions, IPC 0.500000, "
+                                       "n/a L1D misses, n/a LLC misses, n/a branch misses");
+    }
+}
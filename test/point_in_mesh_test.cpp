@@ -0,0 +1,132 @@
+#include <catch2/catch.hpp>
+
+#include <random>
+#include "rmilib/rmi.hpp"
+#include "rmilib/raw_mesh.hpp"
+#include "rmilib/mesh_generator.hpp"
+#include "rmilib/point_in_mesh.hpp"
+
+
+// Closed cube [0, 1]^3, every face is split by diagonal
+TriangularMesh cube_mesh() {
+    return TriangularMesh(
+        {0, 0, 0,  1, 0, 0,  1, 1, 0,  0, 1, 0,  0, 0, 1,  1, 0, 1,  1, 1, 1,  0, 1, 1},
+        {
+            0, 2, 1,  0, 3, 2,  4, 5, 6,  4, 6, 7,
+            0, 1, 5,  0, 5, 4,  3, 7, 6,  3, 6, 2,
+            0, 4, 7,  0, 7, 3,  1, 2, 6,  1, 6, 5
+        }
+    );
+}
+
+std::vector<rmi::Vector3d> random_points(int count, double size, int seed) {
+    std::default_random_engine engine(seed);
+    std::uniform_real_distribution<> dist(-size, size);
+    std::vector<rmi::Vector3d> points;
+    for (int i = 0; i < count; ++i) {
+        points.emplace_back(dist(engine), dist(engine), dist(engine));
+    }
+    return points;
+}
+
+
+TEST_CASE("Counting intersections", "[inside][ray]") {
+    GIVEN("Closed cube") {
+        TriangularMesh mesh = cube_mesh();
+        const auto tree = rmi::KDTree<TriangularMesh>::for_mesh(mesh);
+
+        WHEN("Ray crosses faces away from edges") {
+            const rmi::Ray<double> ray(rmi::Vector3d(0.3, 0.6, -1), rmi::Vector3d(0, 0, 1));
+            const auto crossings = ray.count_intersections(tree);
+            THEN("Both faces should be counted") {
+                REQUIRE(crossings.count == 2);
+                REQUIRE(crossings.degenerate == false);
+                REQUIRE(crossings.odd() == false);
+            }
+        }
+
+        WHEN("Ray crosses shared diagonal edges") {
+            const rmi::Ray<double> ray(rmi::Vector3d(0.5, 0.5, -1), rmi::Vector3d(0, 0, 1));
+            const auto crossings = ray.count_intersections(tree);
+            THEN("Result should be marked as degenerate") {
+                REQUIRE(crossings.degenerate == true);
+            }
+        }
+
+        WHEN("Ray is limited by segment") {
+            const auto ray = rmi::Ray<double>::segment(rmi::Vector3d(0.3, 0.6, -1), rmi::Vector3d(0.3, 0.6, 0.5));
+            THEN("Only crossings inside segment should be counted") {
+                REQUIRE(ray.count_intersections(tree).count == 1);
+            }
+        }
+
+        WHEN("Classifying points on diagonals and axes of the cube") {
+            THEN("Points should be classified despite rays along edges") {
+                REQUIRE(rmi::is_inside(tree, rmi::Vector3d(0.5, 0.5, 0.5)));
+                REQUIRE(rmi::is_inside(tree, rmi::Vector3d(0.25, 0.25, 0.25)));
+                REQUIRE(rmi::is_inside(tree, rmi::Vector3d(0.999, 0.001, 0.5)));
+                REQUIRE_FALSE(rmi::is_inside(tree, rmi::Vector3d(-0.5, -0.5, -0.5)));
+                REQUIRE_FALSE(rmi::is_inside(tree, rmi::Vector3d(1.5, 0.5, 0.5)));
+                REQUIRE_FALSE(rmi::is_inside(tree, rmi::Vector3d(0.5, 0.5, 1.001)));
+            }
+        }
+    }
+
+    GIVEN("Random triangles soup") {
+        TriangularMesh mesh = generate_soup_mesh<double, size_t>(2000, 7);
+        const auto tree = rmi::KDTree<TriangularMesh>::for_mesh(mesh);
+
+        WHEN("Counting intersections of random rays") {
+            THEN("Count should match number of found intersections") {
+                const auto origins = random_points(100, 1, 8);
+                const auto directions = random_points(100, 1, 9);
+                for (size_t i = 0; i < origins.size(); ++i) {
+                    const rmi::Ray<double> ray(origins[i], directions[i]);
+                    const auto crossings = ray.count_intersections(tree);
+                    if (!crossings.degenerate) {
+                        REQUIRE(crossings.count == ray.intersects(tree).size());
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("Point in mesh classification", "[inside][kdtree]") {
+    GIVEN("Closed sphere and random points around it") {
+        TriangularMesh mesh = generate_sphere_mesh<double, size_t>(5000);
+        const auto tree = rmi::KDTree<TriangularMesh>::for_mesh(mesh);
+        const auto points = random_points(2000, 1.5, 10);
+
+        WHEN("Classifying points one by one") {
+            THEN("Points should be inside if they are inside the sphere") {
+                for (const auto& p : points) {
+                    // tessellation is inscribed in unit sphere
+                    if (p.length() < 0.95 || p.length() > 1) {
+                        REQUIRE(rmi::is_inside(tree, p) == (p.length() < 1));
+                    }
+                }
+            }
+        }
+
+        WHEN("Classifying batch of points") {
+            const auto expected = rmi::classify_points(tree, points);
+            REQUIRE(expected.size() == points.size());
+            for (size_t i = 0; i < points.size(); ++i) {
+                REQUIRE(expected[i] == rmi::is_inside(tree, points[i]));
+            }
+
+            #ifdef RMI_INCLUDE_OMP
+            THEN("OMP classification should be the same") {
+                REQUIRE(rmi::omp_classify_points(tree, points, 4) == expected);
+            }
+            #endif
+
+            #ifdef RMI_INCLUDE_POOL
+            THEN("Pool classification should be the same") {
+                REQUIRE(rmi::pool_classify_points(tree, points, 4) == expected);
+            }
+            #endif
+        }
+    }
+}
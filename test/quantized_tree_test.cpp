@@ -0,0 +1,40 @@
+#include <catch2/catch.hpp>
+
+#include <random>
+#include "rmilib/rmi.hpp"
+#include "rmilib/raw_mesh.hpp"
+#include "rmilib/mesh_generator.hpp"
+#include "rmilib/quantized_tree.hpp"
+
+
+TEMPLATE_TEST_CASE("Quantized tree intersection", "[ray][kdtree][quantized]", uint8_t, uint16_t) {
+    GIVEN("Random triangles soup and tree built for it") {
+        TriangularMesh mesh = generate_soup_mesh<double, size_t>(5000, 42);
+        auto tree = rmi::KDTree<TriangularMesh>::for_mesh(mesh);
+
+        WHEN("Compressing tree") {
+            auto quantized = rmi::QuantizedKDTree<TriangularMesh, TestType>::from_tree(tree);
+
+            THEN("It should have the same nodes count and take less memory") {
+                const size_t nodes_count = tree.stats().nodes_count;
+                REQUIRE(quantized.nodes().size() == nodes_count);
+                REQUIRE(quantized.memory_usage() < nodes_count * sizeof(rmi::KDTree<TriangularMesh>::Node));
+            }
+
+            THEN("It should find the same intersections as original tree") {
+                std::default_random_engine engine(7);
+                std::uniform_real_distribution<> dist(-1, 1);
+                for (int i = 0; i < 200; ++i) {
+                    rmi::Ray<double> ray(
+                        rmi::Vector3d(dist(engine), dist(engine), dist(engine)),
+                        rmi::Vector3d(dist(engine), dist(engine), dist(engine))
+                    );
+                    REQUIRE_THAT(
+                        quantized.intersects(ray),
+                        Catch::Matchers::UnorderedEquals(ray.intersects(tree))
+                    );
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,116 @@
+#include <catch2/catch.hpp>
+
+#include "rmilib/rmi.hpp"
+#include "rmilib/mesh_generator.hpp"
+#include "rmilib/ray_generator.hpp"
+
+
+template<typename float_t>
+bool same_rays(const std::vector<rmi::Ray<float_t>>& lhs, const std::vector<rmi::Ray<float_t>>& rhs) {
+    if (lhs.size() != rhs.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < lhs.size(); ++i) {
+        if (lhs[i].origin() != rhs[i].origin() || lhs[i].direction() != rhs[i].direction()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+TEST_CASE("Ray workloads", "[generator][ray]") {
+    auto mesh = generate_sphere_mesh<double, size_t>(5000);
+    const auto tree = rmi::KDTree<TriangularMesh>::for_mesh(mesh);
+    const auto box = rmi::get_bounding_box<TriangularMesh>(mesh.begin(), mesh.end());
+
+    WHEN("Generating camera rays") {
+        const auto rays = rmi::camera_rays<double>(box, 40, 30, 1);
+        THEN("All rays should start from one point outside and some of them should hit the sphere") {
+            REQUIRE(rays.size() == 40 * 30);
+            size_t hits = 0;
+            for (const auto& ray : rays) {
+                REQUIRE(ray.origin() == rays.front().origin());
+                REQUIRE(ray.origin().length() > 1);
+                hits += !ray.intersects(tree).empty();
+            }
+            REQUIRE(hits > rays.size() / 10);
+            REQUIRE(hits < rays.size());
+        }
+    }
+
+    WHEN("Generating secondary rays") {
+        const auto rays = rmi::secondary_rays<double>(mesh, 500, 1);
+        THEN("Rays should start near surface") {
+            REQUIRE(rays.size() == 500);
+            for (const auto& ray : rays) {
+                REQUIRE(ray.origin().length() == Approx(1).epsilon(0.01));
+            }
+        }
+    }
+
+    WHEN("Generating segments") {
+        const auto segments = rmi::segment_rays<double>(mesh, 500, 1);
+        THEN("Segments should connect surface points") {
+            REQUIRE(segments.size() == 500);
+            for (const auto& segment : segments) {
+                REQUIRE(segment.length > 0);
+                REQUIRE(segment.ray.origin().length() == Approx(1).epsilon(0.01));
+                REQUIRE(segment.ray.at(segment.length).length() == Approx(1).epsilon(0.01));
+                REQUIRE(segment.ray.t_max() == segment.length);
+            }
+        }
+    }
+
+    WHEN("Generating scanlines") {
+        const auto rays = rmi::scanline_rays<double>(box, 1, 10, 20, 1);
+        THEN("Rays should be parallel to axis and start outside") {
+            REQUIRE(rays.size() == 200);
+            for (const auto& ray : rays) {
+                REQUIRE(ray.direction() == rmi::Vector3d(0, 1, 0));
+                REQUIRE(ray.origin().y() < box.min.y());
+            }
+        }
+    }
+
+    THEN("The same seed should give the same rays") {
+        for (auto workload : {rmi::Workload::Camera, rmi::Workload::Secondary, rmi::Workload::Segments,
+                              rmi::Workload::Scanlines, rmi::Workload::Uniform}) {
+            const auto rays = rmi::generate_rays<double>(workload, mesh, 400, 7);
+            REQUIRE(rays.size() == 400);
+            REQUIRE(same_rays(rays, rmi::generate_rays<double>(workload, mesh, 400, 7)));
+            REQUIRE_FALSE(same_rays(rays, rmi::generate_rays<double>(workload, mesh, 400, 8)));
+        }
+        REQUIRE(rmi::workload_from_string("scanlines") == rmi::Workload::Scanlines);
+        REQUIRE_THROWS(rmi::workload_from_string("unknown"));
+    }
+}
+
+TEST_CASE("Ray workloads of tiny meshes", "[generator][ray]") {
+    GIVEN("Empty mesh") {
+        TriangularMesh mesh({}, {});
+        THEN("Surface workloads should throw") {
+            REQUIRE(rmi::secondary_rays<double>(mesh, 0, 1).empty());
+            REQUIRE_THROWS_AS(rmi::secondary_rays<double>(mesh, 10, 1), std::string);
+            REQUIRE_THROWS_AS(rmi::segment_rays<double>(mesh, 10, 1), std::string);
+        }
+    }
+
+    GIVEN("Triangle collapsed to a point") {
+        TriangularMesh mesh({1, 2, 3,  1, 2, 3,  1, 2, 3}, {0, 1, 2});
+        THEN("Segments should throw instead of drawing points forever") {
+            REQUIRE_THROWS_AS(rmi::segment_rays<double>(mesh, 10, 1), std::string);
+        }
+    }
+
+    GIVEN("Thin triangle") {
+        TriangularMesh mesh({0, 0, 0,  1e-3, 0, 0,  0, 1e-9, 0}, {0, 1, 2});
+        THEN("Segments should be found with shorter offsets") {
+            const auto segments = rmi::segment_rays<double>(mesh, 10, 1);
+            REQUIRE(segments.size() == 10);
+            for (const auto& segment : segments) {
+                REQUIRE(segment.length > 0);
+            }
+        }
+    }
+}
@@ -3,8 +3,11 @@
 #include <sstream>
 #include <iostream>
 #include <array>
+#include <cmath>
+#include <random>
 #include "rmilib/rmi.hpp"
 #include "rmilib/raw_mesh.hpp"
+#include "rmilib/mesh_generator.hpp"
 
 #define EPSILON 0.00001
 
@@ -126,6 +129,29 @@ TEST_CASE("Ray and bounding box intersection method", "[ray][aabb]") {
         }
     }
 
+    GIVEN("Segment ending before AABB") {
+        auto ray = rmi::Ray<double>::segment(rmi::Vector3d(-5, 0, 0), rmi::Vector3d(-2, 0, 0));
+        rmi::AABBox<double> aabb = {rmi::Vector3d(-1, -1, -1), rmi::Vector3d(1, 1, 1)};
+        WHEN("Checking whether they intersects") {
+            bool is_intersects = ray.is_intersects(aabb);
+            THEN("Should return false") {
+                REQUIRE(is_intersects == false);
+            }
+        }
+    }
+
+    GIVEN("Ray starting inside AABB after interval begin") {
+        rmi::Ray<double> ray(rmi::Vector3d(-5, 0, 0), rmi::Vector3d(1, 0, 0), 5, 10);
+        rmi::AABBox<double> aabb = {rmi::Vector3d(-1, -1, -1), rmi::Vector3d(1, 1, 1)};
+        WHEN("Finding entry and exit distances") {
+            auto [tmin, tmax] = ray.intersects(aabb);
+            THEN("Should clip them by interval") {
+                REQUIRE(tmin == Approx(5));
+                REQUIRE(tmax == Approx(6));
+            }
+        }
+    }
+
     GIVEN("Ray inside AABB") {
         rmi::Ray<double> ray(rmi::Vector3d(0, 0, 0), rmi::Vector3d(1, 0, 0));
         rmi::AABBox<double> aabb = {rmi::Vector3d(-1, -1, -1), rmi::Vector3d(1, 1, 1)};
@@ -215,3 +241,200 @@ TEST_CASE("Ray and triangular mesh intersection methods", "[ray][mesh][kdtree]")
         #endif
     }
 }
+
+TEST_CASE("Ray segment and interval queries", "[ray][mesh][kdtree]") {
+    GIVEN("Row of triangles and segment crossing first ten of them") {
+        std::vector<double> coords;
+        std::vector<size_t> indices;
+        for (size_t i = 0; i < 1000; ++i) {
+            const double x = i + 1;
+            coords.insert(coords.end(), {x, 0, 0,  x, 1, 0,  x, 0, 1});
+            indices.insert(indices.end(), {3 * i, 3 * i + 1, 3 * i + 2});
+        }
+        TriangularMesh mesh(std::move(coords), std::move(indices));
+        auto kdtree = rmi::KDTree<TriangularMesh>::for_mesh(mesh);
+
+        std::vector<rmi::Vector3<double>> expected_intersections;
+        for (double x = 1; x <= 10; ++x) {
+            expected_intersections.emplace_back(x, 0.25, 0.25);
+        }
+        auto ray = rmi::Ray<double>::segment(rmi::Vector3d(0.5, 0.25, 0.25), rmi::Vector3d(10.5, 0.25, 0.25));
+
+        WHEN("Finding intersections with mesh") {
+            auto actual_intersections = ray.intersects(mesh);
+            REQUIRE_THAT(
+                actual_intersections,
+                Catch::Matchers::UnorderedEquals(expected_intersections)
+            );
+        }
+
+        WHEN("Finding intersections with kdtree") {
+            auto actual_intersections = ray.intersects(kdtree);
+            REQUIRE_THAT(
+                actual_intersections,
+                Catch::Matchers::UnorderedEquals(expected_intersections)
+            );
+        }
+
+        WHEN("Finding intersections in the middle of the ray") {
+            rmi::Ray<double> interval(rmi::Vector3d(-99.5, 0.25, 0.25), rmi::Vector3d(1, 0, 0), 100, 110);
+            auto actual_intersections = interval.intersects(kdtree);
+            REQUIRE_THAT(
+                actual_intersections,
+                Catch::Matchers::UnorderedEquals(expected_intersections)
+            );
+        }
+
+        #ifdef RMI_INCLUDE_POOL
+        WHEN("Finding intersections with kdtree with pool parallel algorithm") {
+            auto actual_intersections = ray.pool_intersects(kdtree, 2);
+            REQUIRE_THAT(
+                actual_intersections,
+                Catch::Matchers::UnorderedEquals(expected_intersections)
+            );
+        }
+        #endif
+
+        #ifdef RMI_INCLUDE_OMP
+        WHEN("Finding intersections with kdtree with omp parallel algorithm") {
+            auto actual_intersections = ray.omp_intersects(kdtree, 2);
+            REQUIRE_THAT(
+                actual_intersections,
+                Catch::Matchers::UnorderedEquals(expected_intersections)
+            );
+        }
+
+        WHEN("Finding intersections with mesh in parallel") {
+            auto actual_intersections = ray.omp_intersects(mesh, 2);
+            REQUIRE_THAT(
+                actual_intersections,
+                Catch::Matchers::UnorderedEquals(expected_intersections)
+            );
+        }
+        #endif
+    }
+}
+
+TEST_CASE("Closest and any hit queries", "[ray][kdtree]") {
+    GIVEN("Random triangles soup") {
+        TriangularMesh mesh = generate_soup_mesh<double, size_t>(5000, 21);
+        const auto tree = rmi::KDTree<TriangularMesh>::for_mesh(mesh);
+        std::default_random_engine engine(22);
+        std::uniform_real_distribution<> position(-2, 2);
+        std::uniform_real_distribution<> length(0, 3);
+
+        THEN("Results should match brute force search") {
+            size_t hit = 0;
+            for (int i = 0; i < 300; ++i) {
+                const rmi::Vector3d origin(position(engine), position(engine), position(engine));
+                const rmi::Vector3d direction(position(engine), position(engine), position(engine));
+                // half of the rays are limited segments
+                const rmi::Ray<double> ray(origin, direction, 0, i % 2 ? length(engine) : INFINITY);
+
+                const auto points = ray.intersects(mesh);
+                const auto closest = ray.closest_intersection(tree);
+                REQUIRE(ray.intersects_any(tree) == !points.empty());
+                REQUIRE(closest.has_value() == !points.empty());
+                if (closest) {
+                    double nearest = INFINITY;
+                    for (const auto& point : points) {
+                        nearest = std::min(nearest, (point - origin).length());
+                    }
+                    REQUIRE((*closest - origin).length() == Approx(nearest));
+                    ++hit;
+                }
+            }
+            REQUIRE(hit > 0);
+        }
+    }
+}
+
+TEST_CASE("Bounding box precision conversion", "[aabb]") {
+    GIVEN("Box with bounds not representable in float") {
+        rmi::AABBox<double> box = {rmi::Vector3d(0.1, -0.1, 1.0 / 3), rmi::Vector3d(0.7, 0.3, 1e10 + 1)};
+        WHEN("Converting it to float") {
+            rmi::AABBox<float> converted(box);
+            THEN("Bounds should be rounded outward") {
+                for (int axis = 0; axis < 3; ++axis) {
+                    REQUIRE(converted.min[axis] <= box.min[axis]);
+                    REQUIRE(converted.max[axis] >= box.max[axis]);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("Bounding box of negative coordinates", "[aabb]") {
+    GIVEN("Triangle with all coordinates below zero") {
+        MeshMock mesh(rmi::Vector3d(-3, -2, -1), rmi::Vector3d(-2, -3, -2), rmi::Vector3d(-1, -1, -3));
+        WHEN("Finding its bounding box") {
+            const auto box = rmi::get_bounding_box<MeshMock>(mesh.begin(), mesh.end());
+            THEN("Box should be tight") {
+                REQUIRE(box.min == rmi::Vector3d(-3, -3, -3));
+                REQUIRE(box.max == rmi::Vector3d(-1, -1, -1));
+            }
+        }
+    }
+}
+
+TEST_CASE("Mixed precision intersection methods", "[ray][mesh][kdtree]") {
+    GIVEN("Mesh stored in float and ray in double") {
+        std::vector<float> coords;
+        std::vector<unsigned int> indices;
+        std::vector<rmi::Vector3<double>> expected_intersections;
+        for (unsigned int i = 0; i < 1000; ++i) {
+            const float x = 1.0f + 0.1f * i;
+            coords.push_back(x); coords.push_back(-0.5); coords.push_back(-0.5);
+            coords.push_back(x); coords.push_back(1);    coords.push_back(0);
+            coords.push_back(x); coords.push_back(0);    coords.push_back(1);
+
+            indices.push_back(i*3 + 0);
+            indices.push_back(i*3 + 1);
+            indices.push_back(i*3 + 2);
+
+            expected_intersections.emplace_back(static_cast<double>(x), 0, 0);
+        }
+
+        rmi::Ray<double> ray(rmi::Vector3d(0, 0, 0), rmi::Vector3d(1, 0, 0));
+        WebGLMesh mesh(std::move(coords), std::move(indices));
+
+        WHEN("Finding intersections with mesh") {
+            auto actual_intersections = ray.intersects(mesh);
+            REQUIRE_THAT(
+                actual_intersections,
+                Catch::Matchers::UnorderedEquals(expected_intersections)
+            );
+        }
+
+        WHEN("Finding intersections with kdtree") {
+            auto kdtree = rmi::KDTree<WebGLMesh>::for_mesh(mesh);
+            auto actual_intersections = ray.intersects(kdtree);
+            REQUIRE_THAT(
+                actual_intersections,
+                Catch::Matchers::UnorderedEquals(expected_intersections)
+            );
+        }
+
+        #ifdef RMI_INCLUDE_POOL
+        WHEN("Finding intersections with kdtree with pool parallel algorithm") {
+            auto kdtree = rmi::KDTree<WebGLMesh>::for_mesh(mesh);
+            auto actual_intersections = ray.pool_intersects(kdtree, 2);
+            REQUIRE_THAT(
+                actual_intersections,
+                Catch::Matchers::UnorderedEquals(expected_intersections)
+            );
+        }
+        #endif
+
+        #ifdef RMI_INCLUDE_OMP
+        WHEN("Finding intersections with kdtree with omp parallel algorithm") {
+            auto kdtree = rmi::KDTree<WebGLMesh>::for_mesh(mesh);
+            auto actual_intersections = ray.omp_intersects(kdtree, 2);
+            REQUIRE_THAT(
+                actual_intersections,
+                Catch::Matchers::UnorderedEquals(expected_intersections)
+            );
+        }
+        #endif
+    }
+}
@@ -0,0 +1,145 @@
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <random>
+#include "rmilib/rmi.hpp"
+#include "rmilib/raw_mesh.hpp"
+#include "rmilib/mesh_generator.hpp"
+#include "rmilib/dynamic_tree.hpp"
+#include "rmilib/region_query.hpp"
+
+
+// Single triangle cutting the corner of [0, 1]^3 cube from outside
+TriangularMesh corner_triangle(double offset) {
+    return TriangularMesh({offset, 0, 0,  0, offset, 0,  0, 0, offset}, {0, 1, 2});
+}
+
+template<typename Region>
+std::vector<size_t> brute_force_query(TriangularMesh& mesh, const Region& region) {
+    std::vector<size_t> result;
+    for (const auto& triangle : mesh) {
+        if (rmi::triangle_overlaps<TriangularMesh>(triangle, region)) {
+            result.push_back(triangle.index);
+        }
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+template<typename Tree>
+std::vector<size_t> sorted_box_query(const Tree& tree, const rmi::AABBox<double>& box) {
+    std::vector<size_t> result;
+    rmi::query_box(tree, box, result);
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+
+TEST_CASE("Triangle and region overlap tests", "[region]") {
+    const rmi::AABBox<double> box = {rmi::Vector3d(-1, -1, -1), rmi::Vector3d(0, 0, 0)};
+
+    GIVEN("Triangle with bounding box overlapping the box") {
+        TriangularMesh mesh = corner_triangle(0.5);
+        const auto& triangle = *mesh.begin();
+        THEN("Triangle plane should separate them") {
+            const rmi::AABBox<double> shifted = {rmi::Vector3d(-1, -1, -1), rmi::Vector3d(0.1, 0.1, 0.1)};
+            REQUIRE_FALSE(rmi::triangle_overlaps<TriangularMesh>(triangle, shifted));
+
+            const rmi::AABBox<double> deeper = {rmi::Vector3d(-1, -1, -1), rmi::Vector3d(0.2, 0.2, 0.2)};
+            REQUIRE(rmi::triangle_overlaps<TriangularMesh>(triangle, deeper));
+        }
+    }
+
+    GIVEN("Triangle touching box corner") {
+        TriangularMesh mesh({0, 0, 0,  1, 0, 0,  0, 1, 0}, {0, 1, 2});
+        THEN("They should overlap") {
+            REQUIRE(rmi::triangle_overlaps<TriangularMesh>(*mesh.begin(), box));
+        }
+    }
+
+    GIVEN("Frustum looking along x axis") {
+        const auto frustum = rmi::Frustum<double>::perspective(
+            rmi::Vector3d(0, 0, 0), rmi::Vector3d(1, 0, 0), rmi::Vector3d(0, 0, 1), std::acos(-1.0) / 2, 1, 1, 10
+        );
+
+        THEN("Triangles should be tested exactly") {
+            // inside, in front of near plane, behind far plane
+            TriangularMesh inside({5, 0, 0,  5, 1, 0,  5, 0, 1}, {0, 1, 2});
+            TriangularMesh close({0.5, 0, 0,  0.5, 0.1, 0,  0.5, 0, 0.1}, {0, 1, 2});
+            TriangularMesh far({11, 0, 0,  11, 1, 0,  11, 0, 1}, {0, 1, 2});
+            REQUIRE(rmi::triangle_overlaps<TriangularMesh>(*inside.begin(), frustum));
+            REQUIRE_FALSE(rmi::triangle_overlaps<TriangularMesh>(*close.begin(), frustum));
+            REQUIRE_FALSE(rmi::triangle_overlaps<TriangularMesh>(*far.begin(), frustum));
+
+            // large triangle around the view axis with all vertices outside of frustum
+            TriangularMesh around({5, -100, -100,  5, 100, -100,  5, 0, 100}, {0, 1, 2});
+            REQUIRE(rmi::triangle_overlaps<TriangularMesh>(*around.begin(), frustum));
+
+            // triangle cutting frustum corner region, outside of it
+            TriangularMesh corner({5, 5.5, 4.8,  5, 4.8, 5.5,  5, 7, 7}, {0, 1, 2});
+            REQUIRE_FALSE(rmi::triangle_overlaps<TriangularMesh>(*corner.begin(), frustum));
+        }
+    }
+}
+
+TEST_CASE("Region queries", "[region][kdtree]") {
+    GIVEN("Random triangles soup") {
+        TriangularMesh mesh = generate_soup_mesh<double, size_t>(5000, 11);
+        const auto tree = rmi::KDTree<TriangularMesh>::for_mesh(mesh);
+
+        std::default_random_engine engine(12);
+        std::uniform_real_distribution<> position(-1, 1);
+        std::uniform_real_distribution<> size(0, 0.5);
+
+        WHEN("Querying random boxes") {
+            THEN("Result should match brute force search") {
+                size_t found = 0;
+                for (int i = 0; i < 50; ++i) {
+                    const rmi::Vector3d min(position(engine), position(engine), position(engine));
+                    const rmi::AABBox<double> box = {min, min + rmi::Vector3d(size(engine), size(engine), size(engine))};
+                    const auto actual = sorted_box_query(tree, box);
+                    REQUIRE(actual == brute_force_query(mesh, box));
+                    found += actual.size();
+                }
+                REQUIRE(found > 0);
+            }
+        }
+
+        WHEN("Querying dynamic tree") {
+            const auto dynamic = rmi::DynamicTree<TriangularMesh>::for_mesh(mesh);
+            const rmi::AABBox<double> box = {rmi::Vector3d(-0.5, -0.3, -0.2), rmi::Vector3d(0.1, 0.4, 0.3)};
+            THEN("Result should match brute force search") {
+                REQUIRE(sorted_box_query(dynamic, box) == brute_force_query(mesh, box));
+            }
+        }
+
+        WHEN("Querying box containing the whole mesh") {
+            const rmi::AABBox<double> box = {rmi::Vector3d(-2, -2, -2), rmi::Vector3d(2, 2, 2)};
+            size_t count = 0;
+            rmi::query_box(tree, box, [&count](const auto&) { ++count; });
+            THEN("Every triangle should be visited once") {
+                REQUIRE(count == mesh.size());
+            }
+        }
+
+        WHEN("Querying random frustums") {
+            THEN("Result should match brute force search") {
+                size_t found = 0;
+                for (int i = 0; i < 20; ++i) {
+                    const auto frustum = rmi::Frustum<double>::perspective(
+                        rmi::Vector3d(position(engine), position(engine), position(engine)) * 3,
+                        rmi::Vector3d(position(engine), position(engine), position(engine)),
+                        rmi::Vector3d(0, 0, 1),
+                        0.2 + size(engine), 1.5, 0.1, 0.5 + 4 * size(engine)
+                    );
+                    std::vector<size_t> actual;
+                    rmi::query_frustum(tree, frustum, actual);
+                    std::sort(actual.begin(), actual.end());
+                    REQUIRE(actual == brute_force_query(mesh, frustum));
+                    found += actual.size();
+                }
+                REQUIRE(found > 0);
+            }
+        }
+    }
+}
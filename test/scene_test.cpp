@@ -0,0 +1,127 @@
+#include <catch2/catch.hpp>
+
+#include "rmilib/rmi.hpp"
+#include "rmilib/raw_mesh.hpp"
+#include "rmilib/scene.hpp"
+
+#define EPSILON 0.00001
+
+const double pi = std::acos(-1.0);
+
+
+// Unit square in plane x = 0 made of two triangles
+TriangularMesh square_mesh() {
+    return TriangularMesh(
+        {0, 0, 0,  0, 1, 0,  0, 0, 1,  0, 1, 1},
+        {0, 1, 2,  1, 3, 2}
+    );
+}
+
+
+TEST_CASE("Transform methods", "[scene][transform]") {
+    GIVEN("Composition of rotation, scaling and translation") {
+        const auto transform =
+            rmi::Transform<double>::translation(rmi::Vector3d(1, 2, 3)) *
+            rmi::Transform<double>::rotation(rmi::Vector3d(0, 0, 1), pi / 2) *
+            rmi::Transform<double>::scaling(rmi::Vector3d(2, 2, 2));
+
+        WHEN("Transforming point") {
+            const auto point = transform.point(rmi::Vector3d(1, 0, 0));
+            THEN("Transformations should be applied from right to left") {
+                REQUIRE(point.x() == Approx(1).margin(EPSILON));
+                REQUIRE(point.y() == Approx(4).margin(EPSILON));
+                REQUIRE(point.z() == Approx(3).margin(EPSILON));
+            }
+        }
+
+        WHEN("Applying inverse transform") {
+            const auto point = transform.inverse().point(transform.point(rmi::Vector3d(0.3, -2, 5)));
+            THEN("Should return original point") {
+                REQUIRE(point.x() == Approx(0.3).margin(EPSILON));
+                REQUIRE(point.y() == Approx(-2).margin(EPSILON));
+                REQUIRE(point.z() == Approx(5).margin(EPSILON));
+            }
+        }
+    }
+
+    GIVEN("Scaling to a plane") {
+        const auto transform = rmi::Transform<double>::scaling(rmi::Vector3d(1, 1, 0));
+        THEN("Inverse should throw") {
+            REQUIRE_THROWS_AS(transform.inverse(), std::string);
+        }
+    }
+}
+
+TEST_CASE("Scene intersection", "[scene][ray]") {
+    GIVEN("Row of translated instances of the same mesh") {
+        TriangularMesh mesh = square_mesh();
+        const auto tree = rmi::KDTree<TriangularMesh>::for_mesh(mesh);
+
+        rmi::Scene<TriangularMesh> scene;
+        for (int i = 0; i < 100; ++i) {
+            scene.add(tree, rmi::Transform<double>::translation(rmi::Vector3d(i, 0, 0)));
+        }
+        scene.build();
+
+        WHEN("Casting ray along the row") {
+            rmi::Ray<double> ray(rmi::Vector3d(-0.5, 0.25, 0.25), rmi::Vector3d(1, 0, 0));
+            auto hits = scene.intersects(ray);
+
+            THEN("Every instance should be hit once at its own position") {
+                REQUIRE(hits.size() == 100);
+                for (const auto& hit : hits) {
+                    REQUIRE(hit.point.x() == Approx(static_cast<double>(hit.instance)).margin(EPSILON));
+                    REQUIRE(hit.point.y() == Approx(0.25).margin(EPSILON));
+                    REQUIRE(hit.point.z() == Approx(0.25).margin(EPSILON));
+                }
+            }
+        }
+
+        WHEN("Casting ray across the row") {
+            rmi::Ray<double> ray(rmi::Vector3d(40.1, -0.2, 0.5), rmi::Vector3d(-1, 4, 0));
+            auto hits = scene.intersects(ray);
+
+            THEN("Only crossed instance should be hit") {
+                REQUIRE(hits.size() == 1);
+                REQUIRE(hits[0].instance == 40);
+                REQUIRE(hits[0].point.y() == Approx(0.2).margin(EPSILON));
+            }
+        }
+    }
+
+    GIVEN("Rotated and scaled instance") {
+        TriangularMesh mesh = square_mesh();
+        const auto tree = rmi::KDTree<TriangularMesh>::for_mesh(mesh);
+
+        rmi::Scene<TriangularMesh> scene;
+        // square is turned into plane z = 5 and scaled 4 times
+        scene.add(tree,
+            rmi::Transform<double>::translation(rmi::Vector3d(0, 0, 5)) *
+            rmi::Transform<double>::rotation(rmi::Vector3d(0, 1, 0), -pi / 2) *
+            rmi::Transform<double>::scaling(rmi::Vector3d(4, 4, 4))
+        );
+        scene.build();
+
+        WHEN("Casting ray downwards") {
+            rmi::Ray<double> ray(rmi::Vector3d(-3, 3, 10), rmi::Vector3d(0, 0, -1));
+            auto hits = scene.intersects(ray);
+
+            THEN("Hit should be reported in world space") {
+                REQUIRE(hits.size() == 1);
+                REQUIRE(hits[0].point.x() == Approx(-3).margin(EPSILON));
+                REQUIRE(hits[0].point.y() == Approx(3).margin(EPSILON));
+                REQUIRE(hits[0].point.z() == Approx(5).margin(EPSILON));
+            }
+        }
+
+        WHEN("Casting segments ending near the instance") {
+            const auto before = rmi::Ray<double>::segment(rmi::Vector3d(-3, 3, 10), rmi::Vector3d(-3, 3, 5.1));
+            const auto after = rmi::Ray<double>::segment(rmi::Vector3d(-3, 3, 10), rmi::Vector3d(-3, 3, 4.9));
+
+            THEN("Interval should be measured in world space") {
+                REQUIRE(scene.intersects(before).empty());
+                REQUIRE(scene.intersects(after).size() == 1);
+            }
+        }
+    }
+}
@@ -0,0 +1,101 @@
+#include <catch2/catch.hpp>
+
+// Kernels are checked on the host, where vector extensions are lowered to SSE / NEON
+#if defined(__GNUC__) && !defined(RMI_SIMD128)
+#    define RMI_SIMD128
+#endif
+
+#include <random>
+#include "rmilib/rmi.hpp"
+#include "rmilib/raw_mesh.hpp"
+#include "rmilib/mesh_generator.hpp"
+#include "rmilib/dynamic_tree.hpp"
+
+
+#ifdef RMI_SIMD128
+rmi::Ray<float> random_ray(std::default_random_engine& engine) {
+    std::uniform_real_distribution<float> dist(-1, 1);
+    return rmi::Ray<float>(
+        rmi::Vector3f(dist(engine), dist(engine), dist(engine)),
+        rmi::Vector3f(dist(engine), dist(engine), dist(engine))
+    );
+}
+
+// Hits of ray with every triangle by the scalar test, in order of leaves
+template<typename Node>
+void scalar_intersects(const rmi::Ray<float>& ray, const Node& node, std::vector<rmi::Vector3f>& output) {
+    if (node.is_leaf()) {
+        for (const auto& triangle : node) {
+            if (auto intersection = ray.intersects<WebGLMesh>(triangle); intersection) {
+                output.push_back(*intersection);
+            }
+        }
+        return;
+    }
+    scalar_intersects(ray, node.left(), output);
+    scalar_intersects(ray, node.right(), output);
+}
+
+
+TEST_CASE("SIMD kernels", "[simd]") {
+    WebGLMesh mesh = generate_soup_mesh<float, unsigned>(5000, 16);
+    std::default_random_engine engine(17);
+
+    GIVEN("Bounding box of mesh") {
+        rmi::AABBox<float> expected;
+        for (const auto& triangle : mesh) {
+            expected += rmi::get_bounding_box<WebGLMesh>(triangle);
+        }
+        THEN("Reduction should give the same box") {
+            const auto box = rmi::get_bounding_box<WebGLMesh>(mesh.begin(), mesh.end());
+            REQUIRE(box.min == expected.min);
+            REQUIRE(box.max == expected.max);
+        }
+    }
+
+    GIVEN("Random rays and boxes") {
+        THEN("Slab test should give the same distances as the scalar one") {
+            std::uniform_real_distribution<float> dist(-1, 1);
+            for (int i = 0; i < 1000; ++i) {
+                const auto ray = random_ray(engine);
+                const rmi::Vector3f corner(dist(engine), dist(engine), dist(engine));
+                const rmi::AABBox<float> box = {corner, corner + rmi::Vector3f(0.5, 0.5, 0.5)};
+
+                const auto inv = rmi::Vector3f(1 / ray.direction().x(), 1 / ray.direction().y(), 1 / ray.direction().z());
+                const auto t1 = (box.min - ray.origin()) * inv;
+                const auto t2 = (box.max - ray.origin()) * inv;
+                const auto expected = std::make_pair(
+                    std::max({std::min(t1.x(), t2.x()), std::min(t1.y(), t2.y()), std::min(t1.z(), t2.z()), ray.t_min()}),
+                    std::min({std::max(t1.x(), t2.x()), std::max(t1.y(), t2.y()), std::max(t1.z(), t2.z()), ray.t_max()})
+                );
+                REQUIRE(ray.intersects(box) == expected);
+            }
+        }
+    }
+
+    GIVEN("Trees of the mesh") {
+        const auto tree = rmi::KDTree<WebGLMesh>::for_mesh(mesh);
+        const auto dynamic = rmi::DynamicTree<WebGLMesh>::for_mesh(mesh);
+
+        THEN("Triangles tested by 4 should give the same hits as scalar test") {
+            size_t hits = 0;
+            for (int i = 0; i < 500; ++i) {
+                auto ray = random_ray(engine);
+                if (i % 2) {
+                    ray = rmi::Ray<float>(ray.origin(), ray.direction(), 0.2f, 0.9f);
+                }
+
+                std::vector<rmi::Vector3f> expected;
+                scalar_intersects(ray, tree.top(), expected);
+                REQUIRE(ray.intersects(tree) == expected);
+
+                std::vector<rmi::Vector3f> from_dynamic;
+                scalar_intersects(ray, dynamic.top(), from_dynamic);
+                REQUIRE(ray.intersects(dynamic) == from_dynamic);
+                hits += expected.size();
+            }
+            REQUIRE(hits > 0);
+        }
+    }
+}
+#endif
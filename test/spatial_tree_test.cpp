@@ -0,0 +1,80 @@
+#include <catch2/catch.hpp>
+
+#include <random>
+#include "rmilib/rmi.hpp"
+#include "rmilib/raw_mesh.hpp"
+#include "rmilib/spatial_tree.hpp"
+
+
+// Long thin triangles spanning the whole [-10, 10] cube in random directions
+TriangularMesh slivers_mesh(size_t triangles_count, int seed) {
+    std::default_random_engine engine(seed);
+    std::uniform_real_distribution<> position(-10, 10);
+    std::uniform_real_distribution<> offset(-0.05, 0.05);
+
+    std::vector<double> coords;
+    std::vector<size_t> indices;
+    for (size_t i = 0; i < triangles_count; ++i) {
+        const double a[3] = {position(engine), position(engine), position(engine)};
+        const double b[3] = {position(engine), position(engine), position(engine)};
+        for (int j = 0; j < 3; ++j) coords.push_back(a[j]);
+        for (int j = 0; j < 3; ++j) coords.push_back(b[j]);
+        for (int j = 0; j < 3; ++j) coords.push_back(b[j] + offset(engine));
+        for (size_t j = 0; j < 3; ++j) indices.push_back(3 * i + j);
+    }
+    return TriangularMesh(std::move(coords), std::move(indices));
+}
+
+std::vector<rmi::Ray<double>> cube_rays(int count, int seed) {
+    std::default_random_engine engine(seed);
+    std::uniform_real_distribution<> dist(-10, 10);
+    std::vector<rmi::Ray<double>> rays;
+    for (int i = 0; i < count; ++i) {
+        rays.emplace_back(
+            rmi::Vector3d(dist(engine), dist(engine), dist(engine)),
+            rmi::Vector3d(dist(engine), dist(engine), dist(engine))
+        );
+    }
+    return rays;
+}
+
+
+TEST_CASE("Spatial splits tree", "[spatial][ray]") {
+    GIVEN("Mesh of long thin triangles") {
+        TriangularMesh mesh = slivers_mesh(1000, 21);
+
+        WHEN("Building tree with duplicates budget") {
+            const rmi::SpatialSplitter<TriangularMesh> splitter(4, 0.5);
+            const auto tree = rmi::SpatialTree<TriangularMesh>::for_mesh(mesh, splitter);
+
+            THEN("Triangles should be referenced from several leaves within budget") {
+                REQUIRE(tree.references().size() > mesh.size());
+                REQUIRE(tree.references().size() <= mesh.size() * 3 / 2);
+            }
+
+            THEN("Every hit should be reported exactly once") {
+                for (const auto& ray : cube_rays(200, 5)) {
+                    const auto expected = ray.intersects(mesh);
+                    REQUIRE_THAT(ray.intersects(tree), Catch::Matchers::UnorderedEquals(expected));
+                    #ifdef RMI_INCLUDE_POOL
+                    REQUIRE_THAT(ray.pool_intersects(tree, 4), Catch::Matchers::UnorderedEquals(expected));
+                    #endif
+                    #ifdef RMI_INCLUDE_OMP
+                    REQUIRE_THAT(ray.omp_intersects(tree, 4), Catch::Matchers::UnorderedEquals(expected));
+                    #endif
+                }
+            }
+        }
+
+        WHEN("Building tree without duplicates budget") {
+            const auto tree = rmi::SpatialTree<TriangularMesh>::for_mesh(mesh, rmi::SpatialSplitter<TriangularMesh>(4, 0));
+
+            THEN("It should degrade to object splits only") {
+                REQUIRE(tree.references().size() == mesh.size());
+                for (const auto& ray : cube_rays(50, 6)) {
+                    REQUIRE_THAT(ray.intersects(tree), Catch::Matchers::UnorderedEquals(ray.intersects(mesh)));
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef RMI_ENABLE_STATS
+#define RMI_ENABLE_STATS
+#endif
+#include <catch2/catch.hpp>
+
+#include <random>
+#include "rmilib/rmi.hpp"
+#include "rmilib/raw_mesh.hpp"
+#include "rmilib/mesh_generator.hpp"
+
+
+void require_same_work(const rmi::TraversalStats& actual, const rmi::TraversalStats& expected) {
+    REQUIRE(actual.rays == expected.rays);
+    REQUIRE(actual.nodes_visited == expected.nodes_visited);
+    REQUIRE(actual.box_tests == expected.box_tests);
+    REQUIRE(actual.triangle_tests == expected.triangle_tests);
+    REQUIRE(actual.hits == expected.hits);
+}
+
+
+TEST_CASE("Traversal statistics", "[stats][ray]") {
+    TriangularMesh mesh = generate_soup_mesh<double, size_t>(2000, 3);
+    const auto tree = rmi::KDTree<TriangularMesh>::for_mesh(mesh, rmi::SAHSplitter<TriangularMesh>(4));
+    const auto tree_stats = tree.stats();
+
+    std::vector<rmi::Ray<double>> rays;
+    for (int i = 0; i < 50; ++i) {
+        rays.emplace_back(rmi::Vector3d(-1.5, 0.01 * i - 0.25, 0.03), rmi::Vector3d(1, 0.01 * i, -0.02));
+    }
+
+    auto& stats = rmi::traversal_stats();
+    stats = {};
+    size_t hits = 0;
+    for (const auto& ray : rays) {
+        hits += ray.intersects(tree).size();
+    }
+    const auto sequential = stats;
+
+    THEN("Counters should describe sequential search") {
+        REQUIRE(sequential.rays == rays.size());
+        REQUIRE(sequential.hits == hits);
+        REQUIRE(hits > 0);
+        REQUIRE(sequential.triangle_tests >= sequential.hits);
+        REQUIRE(sequential.triangle_tests < rays.size() * mesh.size());
+        // root box test of every ray and two children tests of every visited internal node
+        REQUIRE(sequential.box_tests % 2 == rays.size() % 2);
+        REQUIRE(sequential.nodes_visited <= sequential.box_tests);
+        REQUIRE(sequential.max_stack_depth > 1);
+        REQUIRE(sequential.max_stack_depth <= tree_stats.depth_histogram.size());
+    }
+
+    THEN("Segments should skip nodes behind their ends") {
+        stats = {};
+        for (const auto& ray : rays) {
+            rmi::Ray<double>(ray.origin(), ray.direction(), 0, 1).intersects(tree);
+        }
+        REQUIRE(stats.nodes_visited < sequential.nodes_visited);
+        REQUIRE(stats.triangle_tests < sequential.triangle_tests);
+    }
+
+    THEN("Counters should be exported as JSON") {
+        const auto json = sequential.to_json();
+        REQUIRE(json.find("\"rays\": " + std::to_string(rays.size())) != std::string::npos);
+        REQUIRE(json.find("\"hits\": " + std::to_string(hits)) != std::string::npos);
+    }
+
+    #ifdef RMI_INCLUDE_POOL
+    THEN("Pool search should do the same work") {
+        stats = {};
+        for (const auto& ray : rays) {
+            ray.pool_intersects(tree, 4);
+        }
+        require_same_work(stats, sequential);
+    }
+    #endif
+
+    #ifdef RMI_INCLUDE_OMP
+    THEN("OMP search should do the same work") {
+        stats = {};
+        for (const auto& ray : rays) {
+            ray.omp_intersects(tree, 4);
+        }
+        require_same_work(stats, sequential);
+        REQUIRE(stats.max_stack_depth == sequential.max_stack_depth);
+    }
+    #endif
+}
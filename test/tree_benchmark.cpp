@@ -1,10 +1,14 @@
 #define CATCH_CONFIG_ENABLE_BENCHMARKING
 #include <catch2/catch.hpp>
+#include <iostream>
 #include <sstream>
 
 #include "rmilib/reader.hpp"
 #include "rmilib/raw_mesh.hpp"
 #include "rmilib/rmi.hpp"
+#include "rmilib/dynamic_tree.hpp"
+#include "rmilib/scene.hpp"
+#include "rmilib/perf_counters.hpp"
 
 
 template<typename... Args>
@@ -15,6 +19,23 @@ std::string concat(const Args&... args) {
 }
 
 
+// Runs build once under hardware counters and prints values.
+// Does nothing when counters are unavailable (e.g. in containers).
+template<typename Build>
+void print_perf_counters(const std::string& name, Build build) {
+    static rmi::PerfCounters counters;
+    if (!counters.available()) {
+        return;
+    }
+
+    counters.start();
+    const auto tree = build();
+    const auto sample = counters.stop();
+
+    std::cout << name << ": " << sample.to_string() << std::endl;
+}
+
+
 using Splitter = rmi::SAHSplitter<TriangularMesh>;
 constexpr const char* MESH_FILEPATH = "../../data/Fantasy_Castle.stl";
 
@@ -31,12 +52,120 @@ TEST_CASE("KD-Tree Building", "[benchmark][kdtree]") {
     BENCHMARK(concat("KD-Tree Build Benchmark (", mesh.size(), " polygons)")) {
         return rmi::KDTree<TriangularMesh>::for_mesh(mesh, Splitter());
     };
+    print_perf_counters("KD-Tree Build", [&mesh] {
+        return rmi::KDTree<TriangularMesh>::for_mesh(mesh, Splitter());
+    });
 
 #ifdef RMI_INCLUDE_OMP
     for (int threads_count = 2; threads_count <= 8; threads_count *= 2) {
         BENCHMARK(concat("KD-Tree Parallel <", threads_count, "> Build Benchmark (", mesh.size(), " polygons)")) {
             return rmi::KDTree<TriangularMesh>::for_mesh(mesh, threads_count, Splitter());
         };
+        // OMP workers are reused between runs, so only the calling thread is counted
+        print_perf_counters(concat("KD-Tree Parallel <", threads_count, "> Build (calling thread)"), [&mesh, threads_count] {
+            return rmi::KDTree<TriangularMesh>::for_mesh(mesh, threads_count, Splitter());
+        });
+    }
+#endif
+
+#ifdef RMI_INCLUDE_POOL
+    for (int threads_count = 2; threads_count <= 8; threads_count *= 2) {
+        BENCHMARK(concat("KD-Tree Thread Pool <", threads_count, "> Build Benchmark (", mesh.size(), " polygons)")) {
+            return rmi::KDTree<TriangularMesh>::pool_for_mesh(mesh, threads_count, Splitter());
+        };
+    }
+#endif
+}
+
+void print_stats(const std::string& name, const rmi::TreeStats& stats) {
+    std::cout << name << ": " << stats.nodes_count << " nodes, " << stats.leaves_count << " leaves, "
+              << "max depth " << stats.depth_histogram.size() - 1 << ", SAH cost " << stats.sah_cost << ", "
+              << "sibling overlap " << stats.overlap << ", "
+              << "nodes " << stats.nodes_bytes << " bytes, elements " << stats.elements_bytes << " bytes, "
+              << "build " << stats.timings.total << " s (splitting " << stats.timings.splitting << " s)" << std::endl;
+
+    std::cout << "  leaf size histogram:";
+    for (size_t i = 0; i < stats.leaf_size_histogram.size(); ++i) {
+        std::cout << " [" << (size_t(1) << i) << ".." << (size_t(2) << i) << "): " << stats.leaf_size_histogram[i];
+    }
+    std::cout << std::endl;
+}
+
+TEST_CASE("KD-Tree Statistics", "[benchmark][kdtree][stats]") {
+    TriangularMesh mesh = read_raw_triangular_mesh<double, size_t>(MESH_FILEPATH);
+
+    for (int threshold : {4, 16, 64}) {
+        const auto tree = rmi::KDTree<TriangularMesh>::for_mesh(mesh, rmi::SAHSplitter<TriangularMesh>(threshold));
+        print_stats(concat("SAH splitter (threshold ", threshold, ")"), tree.stats());
+    }
+    for (int depth_limit : {8, 16, 24}) {
+        const auto tree = rmi::KDTree<TriangularMesh>::for_mesh(mesh, rmi::MedianSplitter<TriangularMesh>(depth_limit));
+        print_stats(concat("Median splitter (depth limit ", depth_limit, ")"), tree.stats());
+    }
+}
+
+TEST_CASE("KD-Tree Refitting", "[benchmark][kdtree][refit]") {
+    TriangularMesh mesh = read_raw_triangular_mesh<double, size_t>(MESH_FILEPATH);
+    auto tree = rmi::KDTree<TriangularMesh>::for_mesh(mesh, Splitter());
+
+    BENCHMARK(concat("KD-Tree Refit Benchmark (", mesh.size(), " polygons)")) {
+        tree.refit(mesh);
+    };
+
+#ifdef RMI_INCLUDE_OMP
+    for (int threads_count = 2; threads_count <= 8; threads_count *= 2) {
+        BENCHMARK(concat("KD-Tree Parallel <", threads_count, "> Refit Benchmark (", mesh.size(), " polygons)")) {
+            tree.refit(mesh, threads_count);
+        };
     }
 #endif
 }
+
+TEST_CASE("Dynamic Tree Editing", "[benchmark][dynamic]") {
+    TriangularMesh mesh = read_raw_triangular_mesh<double, size_t>(MESH_FILEPATH);
+
+    rmi::DynamicTree<TriangularMesh> tree;
+    std::vector<rmi::DynamicTree<TriangularMesh>::handle> leaves;
+    for (const auto& element : mesh) {
+        leaves.push_back(tree.insert(element));
+    }
+
+    BENCHMARK(concat("Dynamic Tree Build Benchmark (", mesh.size(), " polygons)")) {
+        return rmi::DynamicTree<TriangularMesh>::for_mesh(mesh);
+    };
+
+    // one edit removes and reinserts a group of 100 triangles
+    const size_t group_size = 100;
+    size_t group = 0;
+    BENCHMARK(concat("Dynamic Tree Edit Benchmark (", group_size, " triangles)")) {
+        const size_t first = (group++ * group_size) % (leaves.size() - group_size);
+        for (size_t i = first; i < first + group_size; ++i) {
+            const auto element = *leaves[i]->begin();
+            tree.remove(leaves[i]);
+            leaves[i] = tree.insert(element);
+        }
+    };
+
+    BENCHMARK(concat("KD-Tree Rebuild Benchmark (", mesh.size(), " polygons)")) {
+        return rmi::KDTree<TriangularMesh>::for_mesh(mesh, Splitter());
+    };
+}
+
+TEST_CASE("Scene Building", "[benchmark][scene]") {
+    TriangularMesh mesh = read_raw_triangular_mesh<double, size_t>(MESH_FILEPATH);
+    const auto tree = rmi::KDTree<TriangularMesh>::for_mesh(mesh, Splitter());
+    const auto size = tree.top().box().max - tree.top().box().min;
+
+    for (int side = 10; side <= 100; side *= 10) {
+        BENCHMARK(concat("Scene Build Benchmark (", side * side, " instances of ", mesh.size(), " polygons)")) {
+            rmi::Scene<TriangularMesh> scene;
+            for (int i = 0; i < side; ++i) {
+                for (int j = 0; j < side; ++j) {
+                    scene.add(tree, rmi::Transform<double>::translation(rmi::Vector3d(i * size.x(), j * size.y(), 0)));
+                }
+            }
+            scene.build();
+            return scene;
+        };
+    }
+}
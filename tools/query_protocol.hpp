@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+#include <unistd.h>
+
+
+/*
+ * Binary framing of rmi_server. Every message is a fixed header followed by
+ * payload of header.bytes bytes, numbers are in host byte order (the socket
+ * is local). Requests of one connection may be pipelined: responses carry
+ * the id of their request and may come in any order. The server admits at
+ * most max_in_flight_jobs unanswered requests of a connection (and
+ * max_in_flight_bytes of their payloads) and reads no more requests until
+ * some responses are written. So a client pipelining more requests than that
+ * must read responses while it is writing requests, e.g. from another thread,
+ * otherwise both sides block on writing.
+ *
+ * Request payloads:
+ *   Info       -  empty
+ *   Hits,
+ *   Closest,
+ *   Occluded   -  count RayRecords
+ *
+ * Response payloads:
+ *   Info       -  MeshInfo for every loaded mesh
+ *   Hits       -  count + 1 offsets (uint32), then 3 floats of every hit;
+ *                 hits of ray i are from offsets[i] to offsets[i + 1]
+ *   Closest    -  ClosestHit for every ray
+ *   Occluded   -  uint8 for every ray, 1 if anything is hit in [t_min, t_max]
+ */
+namespace rmi::protocol {
+
+constexpr uint32_t magic = 0x514d4952;  // "RMIQ"
+
+enum class Query: uint16_t {
+    Info     = 0,
+    Hits     = 1,
+    Closest  = 2,
+    Occluded = 3,
+};
+
+enum class Status: uint16_t {
+    Ok           = 0,
+    BadRequest   = 1,
+    UnknownMesh  = 2,
+};
+
+struct RequestHeader {
+    uint32_t magic;
+    uint32_t id;
+    Query    query;
+    uint16_t mesh;
+    uint32_t bytes;
+};
+
+struct ResponseHeader {
+    uint32_t magic;
+    uint32_t id;
+    Query    query;
+    Status   status;
+    uint32_t bytes;
+};
+
+struct RayRecord {
+    float origin[3];
+    float direction[3];
+    float t_min;
+    float t_max;
+};
+
+struct ClosestHit {
+    // infinity if nothing is hit
+    float t;
+    float point[3];
+};
+
+struct MeshInfo {
+    uint32_t triangles;
+    float    min[3];
+    float    max[3];
+};
+
+static_assert(sizeof(RequestHeader) == 16 && sizeof(ResponseHeader) == 16, "Headers must be packed");
+static_assert(sizeof(RayRecord) == 32 && sizeof(ClosestHit) == 16 && sizeof(MeshInfo) == 28, "Records must be packed");
+
+// Larger messages are rejected
+constexpr uint32_t max_message_bytes = 1u << 30;
+
+// Unanswered requests admitted per connection, so a client not reading
+// responses holds at most this much memory of the server
+constexpr size_t max_in_flight_jobs = 16;
+constexpr size_t max_in_flight_bytes = size_t(256) << 20;
+
+
+// Reads exactly size bytes, false on end of stream or error.
+// Writers should ignore SIGPIPE, so closed peers are reported as errors.
+inline bool read_all(int fd, void* data, size_t size) {
+    auto* bytes = static_cast<char*>(data);
+    while (size > 0) {
+        const ssize_t count = ::read(fd, bytes, size);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        bytes += count;
+        size -= count;
+    }
+    return true;
+}
+
+inline bool write_all(int fd, const void* data, size_t size) {
+    const auto* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        const ssize_t count = ::write(fd, bytes, size);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        bytes += count;
+        size -= count;
+    }
+    return true;
+}
+
+} // namespace rmi::protocol
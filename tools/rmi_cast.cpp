@@ -0,0 +1,309 @@
+/*
+ * Offline batch ray caster: loads a mesh, builds its tree and streams rays from
+ * a file in chunks. Reading of the next chunk, casting of the current one and
+ * writing of the previous one overlap.
+ *
+ * rmi_cast --mesh data/bunny.ply --rays rays.bin --output hits.bin [--mode all|closest]
+ *          [--threads 8] [--chunk 1000000] [--splitter sah]
+ *
+ * Rays are read as CSV if the file name ends with .csv (ox,oy,oz,dx,dy,dz[,t_min,t_max]
+ * per line), otherwise as binary records of 8 floats: origin, direction, t_min, t_max.
+ * Hits are written as CSV (ray,x,y,z) if the output name ends with .csv, otherwise as
+ * binary records of uint64 ray index and 3 floats. Meshes may also be generated,
+ * e.g. sphere:1000000.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "rmilib/rmi.hpp"
+#include "rmilib/raw_mesh.hpp"
+#include "tool_common.hpp"
+
+using namespace rmi::tools;
+using Clock = std::chrono::steady_clock;
+
+
+struct Options {
+    std::string mesh;
+    std::string rays;
+    std::string output;
+    // all hits of every ray or only the closest one
+    std::string mode = "all";
+    int threads = 1;
+    size_t chunk = 1000000;
+    std::string splitter = "sah";
+};
+
+struct Hit {
+    uint64_t ray;
+    rmi::Vector3f point;
+};
+
+// Rays of one chunk with index of the first one in the file
+struct Chunk {
+    uint64_t first = 0;
+    std::vector<rmi::Ray<float>> rays;
+};
+
+
+Options parse_options(int argc, char** argv) {
+    Options options;
+    for_each_option(argc, argv, [&](const std::string& arg, const auto& value) {
+        if (arg == "--mesh") {
+            options.mesh = value();
+        } else if (arg == "--rays") {
+            options.rays = value();
+        } else if (arg == "--output") {
+            options.output = value();
+        } else if (arg == "--mode") {
+            options.mode = value();
+        } else if (arg == "--threads") {
+            options.threads = std::max(1, std::stoi(value()));
+        } else if (arg == "--chunk") {
+            options.chunk = std::max<size_t>(1, std::stoul(value()));
+        } else if (arg == "--splitter") {
+            options.splitter = value();
+        } else {
+            throw "Unknown option " + arg;
+        }
+    });
+    if (options.mesh.empty() || options.rays.empty() || options.output.empty()) {
+        throw std::string("--mesh, --rays and --output are required");
+    }
+    if (options.mode != "all" && options.mode != "closest") {
+        throw "Unknown mode " + options.mode;
+    }
+    return options;
+}
+
+
+class RayReader {
+    struct Record {
+        float values[8];
+    };
+public:
+    explicit RayReader(const std::string& path):
+        csv(ends_with(path, ".csv")),
+        file(path, csv ? std::ios::in : std::ios::in | std::ios::binary)
+    {
+        if (!file) {
+            throw "Can't open " + path;
+        }
+        if (!csv) {
+            file.seekg(0, std::ios::end);
+            total = static_cast<uint64_t>(file.tellg()) / sizeof(Record);
+            file.seekg(0, std::ios::beg);
+        }
+    }
+
+    // Empty chunk at the end of file
+    Chunk read(size_t count) {
+        Chunk chunk;
+        chunk.first = position;
+        chunk.rays.reserve(count);
+        if (csv) {
+            std::string line;
+            while (chunk.rays.size() < count && std::getline(file, line)) {
+                float v[8] = {0, 0, 0, 0, 0, 0, 0, std::numeric_limits<float>::infinity()};
+                std::replace(line.begin(), line.end(), ',', ' ');
+                std::istringstream stream(line);
+                int fields = 0;
+                while (fields < 8 && stream >> v[fields]) {
+                    ++fields;
+                }
+                if (fields == 6 || fields == 8) {
+                    chunk.rays.push_back(to_ray(v));
+                } else if (fields > 0) {
+                    throw "Bad ray at line " + std::to_string(++lines);
+                }
+                ++lines;
+            }
+        } else {
+            buffer.resize(count);
+            file.read(reinterpret_cast<char*>(buffer.data()), count * sizeof(Record));
+            const size_t read = file.gcount() / sizeof(Record);
+            for (size_t i = 0; i < read; ++i) {
+                chunk.rays.push_back(to_ray(buffer[i].values));
+            }
+        }
+        position += chunk.rays.size();
+        return chunk;
+    }
+
+    // zero for CSV files
+    uint64_t size() const { return total; }
+private:
+    static rmi::Ray<float> to_ray(const float v[8]) {
+        return rmi::Ray<float>(rmi::Vector3f(v[0], v[1], v[2]), rmi::Vector3f(v[3], v[4], v[5]), v[6], v[7]);
+    }
+
+    bool csv;
+    std::ifstream file;
+    std::vector<Record> buffer;
+    uint64_t total = 0;
+    uint64_t position = 0;
+    uint64_t lines = 0;
+};
+
+
+class HitWriter {
+public:
+    explicit HitWriter(const std::string& path):
+        csv(ends_with(path, ".csv")),
+        file(path, csv ? std::ios::out : std::ios::out | std::ios::binary)
+    {
+        if (!file) {
+            throw "Can't open " + path;
+        }
+    }
+
+    void write(const std::vector<Hit>& hits) {
+        if (csv) {
+            std::ostringstream stream;
+            stream.precision(std::numeric_limits<float>::max_digits10);
+            for (const auto& hit : hits) {
+                stream << hit.ray << ',' << hit.point.x() << ',' << hit.point.y() << ',' << hit.point.z() << '\n';
+            }
+            file << stream.str();
+        } else {
+            std::vector<char> buffer(hits.size() * record_size);
+            char* out = buffer.data();
+            for (const auto& hit : hits) {
+                const float point[3] = {hit.point.x(), hit.point.y(), hit.point.z()};
+                std::memcpy(out, &hit.ray, sizeof(hit.ray));
+                std::memcpy(out + sizeof(hit.ray), point, sizeof(point));
+                out += record_size;
+            }
+            file.write(buffer.data(), buffer.size());
+        }
+        if (!file) {
+            throw std::string("Can't write hits");
+        }
+    }
+private:
+    static constexpr size_t record_size = sizeof(uint64_t) + 3 * sizeof(float);
+
+    bool csv;
+    std::ofstream file;
+};
+
+
+// Rays of one parallel task, their hits are appended to one buffer
+constexpr size_t cast_grain = 256;
+
+template<typename Function>
+void parallel_for([[maybe_unused]] int threads, size_t count, const Function& function) {
+#if defined(RMI_INCLUDE_OMP)
+    #pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+    for (size_t i = 0; i < count; ++i) {
+        function(i);
+    }
+#elif defined(RMI_INCLUDE_POOL)
+    rmi::parallel::pool_for(threads, count, 1, function);
+#else
+    for (size_t i = 0; i < count; ++i) {
+        function(i);
+    }
+#endif
+}
+
+std::vector<Hit> cast(const rmi::KDTree<WebGLMesh>& tree, const Chunk& chunk, const Options& options) {
+    const bool closest = options.mode == "closest";
+    const size_t count = chunk.rays.size();
+    const size_t tasks = (count + cast_grain - 1) / cast_grain;
+    std::vector<std::vector<Hit>> results(tasks);
+    parallel_for(options.threads, tasks, [&](size_t task) {
+        auto& hits = results[task];
+        std::vector<rmi::Vector3f> points;
+        for (size_t i = task * cast_grain; i < std::min(count, (task + 1) * cast_grain); ++i) {
+            const auto& ray = chunk.rays[i];
+            points.clear();
+            if (!closest) {
+                ray.intersects(tree, points);
+            } else if (const auto nearest = ray.closest_intersection(tree); nearest) {
+                points.push_back(*nearest);
+            }
+            for (const auto& point : points) {
+                hits.push_back({chunk.first + i, point});
+            }
+        }
+    });
+
+    size_t total = 0;
+    for (const auto& hits : results) {
+        total += hits.size();
+    }
+    std::vector<Hit> hits;
+    hits.reserve(total);
+    for (const auto& task_hits : results) {
+        hits.insert(hits.end(), task_hits.begin(), task_hits.end());
+    }
+    return hits;
+}
+
+
+int main(int argc, char** argv) {
+    try {
+        const auto options = parse_options(argc, argv);
+
+        auto start = Clock::now();
+        auto mesh = load_mesh(options.mesh);
+        const auto tree = build_tree(mesh, options.threads, options.splitter);
+        std::chrono::duration<double> duration = Clock::now() - start;
+        std::cerr << options.mesh << ": " << mesh.size() << " triangles, tree built in " << duration.count() << " s" << std::endl;
+
+        RayReader reader(options.rays);
+        HitWriter writer(options.output);
+
+        start = Clock::now();
+        uint64_t rays = 0, hits = 0;
+        auto next = std::async(std::launch::async, [&] { return reader.read(options.chunk); });
+        std::future<void> writing;
+        while (true) {
+            const Chunk chunk = next.get();
+            if (chunk.rays.empty()) {
+                break;
+            }
+            next = std::async(std::launch::async, [&] { return reader.read(options.chunk); });
+
+            auto chunk_hits = cast(*tree, chunk, options);
+            if (writing.valid()) {
+                writing.get();
+            }
+            hits += chunk_hits.size();
+            writing = std::async(std::launch::async, [&writer, chunk_hits = std::move(chunk_hits)] { writer.write(chunk_hits); });
+
+            rays += chunk.rays.size();
+            duration = Clock::now() - start;
+            std::cerr << "\r" << rays;
+            if (reader.size() > 0) {
+                std::cerr << " / " << reader.size() << " (" << 100 * rays / reader.size() << "%)";
+            }
+            std::cerr << " rays, " << static_cast<uint64_t>(rays / duration.count()) << " rays/s" << std::flush;
+        }
+        if (writing.valid()) {
+            writing.get();
+        }
+
+        duration = Clock::now() - start;
+        std::cerr << std::endl << rays << " rays, " << hits << " hits in " << duration.count() << " s, "
+                  << static_cast<uint64_t>(rays / duration.count()) << " rays/s" << std::endl;
+    } catch (const std::string& error) {
+        std::cerr << error << std::endl;
+        return 2;
+    } catch (const char* error) {
+        std::cerr << error << std::endl;
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,300 @@
+/*
+ * Load generator for rmi_server: every connection keeps depth requests in
+ * flight and reads responses by its own thread, rays are random within the
+ * box of the mesh. Prints throughput and latency percentiles of requests.
+ *
+ * rmi_load --socket /tmp/rmi.sock [--connections 4] [--depth 8] [--requests 1000]
+ *          [--batch 256] [--query hits|closest|occluded] [--mesh 0] [--seed 1]
+ */
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "query_protocol.hpp"
+#include "tool_options.hpp"
+
+using namespace rmi::protocol;
+using namespace rmi::tools;
+using Clock = std::chrono::steady_clock;
+
+
+struct Options {
+    std::string socket = "/tmp/rmi.sock";
+    int connections = 4;
+    int depth = 8;
+    // per connection
+    int requests = 1000;
+    uint32_t batch = 256;
+    Query query = Query::Hits;
+    uint16_t mesh = 0;
+    unsigned seed = 1;
+};
+
+struct ConnectionResult {
+    std::vector<double> latencies;
+    size_t rays = 0;
+    size_t hits = 0;
+    size_t errors = 0;
+};
+
+
+Options parse_options(int argc, char** argv) {
+    Options options;
+    for_each_option(argc, argv, [&](const std::string& arg, const auto& value) {
+        if (arg == "--socket") {
+            options.socket = value();
+        } else if (arg == "--connections") {
+            options.connections = std::max(1, std::stoi(value()));
+        } else if (arg == "--depth") {
+            options.depth = std::max(1, std::stoi(value()));
+        } else if (arg == "--requests") {
+            options.requests = std::max(1, std::stoi(value()));
+        } else if (arg == "--batch") {
+            options.batch = std::max(1, std::stoi(value()));
+        } else if (arg == "--mesh") {
+            options.mesh = static_cast<uint16_t>(std::stoi(value()));
+        } else if (arg == "--seed") {
+            options.seed = static_cast<unsigned>(std::stoul(value()));
+        } else if (arg == "--query") {
+            const auto query = value();
+            if (query == "hits") {
+                options.query = Query::Hits;
+            } else if (query == "closest") {
+                options.query = Query::Closest;
+            } else if (query == "occluded") {
+                options.query = Query::Occluded;
+            } else {
+                throw "Unknown query " + query;
+            }
+        } else {
+            throw "Unknown option " + arg;
+        }
+    });
+    return options;
+}
+
+int connect_to(const std::string& path) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw "Too long socket path " + path;
+    }
+    path.copy(address.sun_path, path.size());
+
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        throw "Can't connect to " + path + ": " + std::strerror(errno);
+    }
+    return fd;
+}
+
+// Response header and payload, false if connection is closed
+bool receive(int fd, ResponseHeader& header, std::vector<char>& payload) {
+    if (!read_all(fd, &header, sizeof(header)) || header.magic != magic || header.bytes > max_message_bytes) {
+        return false;
+    }
+    payload.resize(header.bytes);
+    return read_all(fd, payload.data(), header.bytes);
+}
+
+MeshInfo request_info(const Options& options) {
+    const int fd = connect_to(options.socket);
+    const RequestHeader request = {magic, 0, Query::Info, 0, 0};
+    ResponseHeader header;
+    std::vector<char> payload;
+    if (!write_all(fd, &request, sizeof(request)) || !receive(fd, header, payload)) {
+        throw std::string("Can't get info of meshes");
+    }
+    ::close(fd);
+    if (header.status != Status::Ok || (options.mesh + 1) * sizeof(MeshInfo) > payload.size()) {
+        throw "Unknown mesh " + std::to_string(options.mesh);
+    }
+    MeshInfo info;
+    std::memcpy(&info, payload.data() + options.mesh * sizeof(MeshInfo), sizeof(info));
+    return info;
+}
+
+// Random origins in the mesh box and random directions
+std::vector<RayRecord> random_rays(const MeshInfo& info, uint32_t count, std::default_random_engine& engine) {
+    std::uniform_real_distribution<float> unit(0, 1);
+    std::uniform_real_distribution<float> direction(-1, 1);
+    std::vector<RayRecord> rays(count);
+    for (auto& ray : rays) {
+        for (int axis = 0; axis < 3; ++axis) {
+            ray.origin[axis] = info.min[axis] + (info.max[axis] - info.min[axis]) * unit(engine);
+            ray.direction[axis] = direction(engine);
+        }
+        ray.t_min = 0;
+        ray.t_max = std::numeric_limits<float>::infinity();
+    }
+    return rays;
+}
+
+size_t count_hits(Query query, uint32_t rays, const std::vector<char>& payload) {
+    switch (query) {
+    case Query::Hits: {
+        uint32_t last = 0;
+        std::memcpy(&last, payload.data() + rays * sizeof(uint32_t), sizeof(last));
+        return last;
+    }
+    case Query::Closest: {
+        size_t hits = 0;
+        for (uint32_t i = 0; i < rays; ++i) {
+            ClosestHit hit;
+            std::memcpy(&hit, payload.data() + i * sizeof(ClosestHit), sizeof(hit));
+            hits += hit.t != std::numeric_limits<float>::infinity();
+        }
+        return hits;
+    }
+    case Query::Occluded:
+        return std::count(payload.begin(), payload.end(), 1);
+    default:
+        return 0;
+    }
+}
+
+ConnectionResult run_connection(const Options& options, const MeshInfo& info, unsigned seed) {
+    const int fd = connect_to(options.socket);
+    std::default_random_engine engine(seed);
+    ConnectionResult result;
+
+    // a few batches are reused, so generation doesn't limit the load
+    std::vector<std::vector<RayRecord>> batches;
+    for (int i = 0; i < 16; ++i) {
+        batches.push_back(random_rays(info, options.batch, engine));
+    }
+
+    std::mutex mutex;
+    std::condition_variable answered;
+    std::map<uint32_t, Clock::time_point> in_flight;
+    bool closed = false;
+
+    // responses are read while requests are written, the server stops reading
+    // requests of a connection with max_in_flight_jobs unanswered ones
+    std::thread receiver([&] {
+        ResponseHeader header;
+        std::vector<char> payload;
+        for (int received = 0; received < options.requests; ++received) {
+            if (!receive(fd, header, payload)) {
+                break;
+            }
+            std::unique_lock<std::mutex> lock(mutex);
+            const auto it = in_flight.find(header.id);
+            if (it == in_flight.end()) {
+                break;
+            }
+            const std::chrono::duration<double, std::milli> latency = Clock::now() - it->second;
+            in_flight.erase(it);
+
+            if (header.status == Status::Ok) {
+                result.latencies.push_back(latency.count());
+                result.rays += options.batch;
+                result.hits += count_hits(options.query, options.batch, payload);
+            } else {
+                ++result.errors;
+            }
+            lock.unlock();
+            answered.notify_one();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        answered.notify_one();
+        // a sender blocked on writing is woken up by the error
+        ::shutdown(fd, SHUT_RDWR);
+    });
+
+    for (uint32_t id = 0; static_cast<int>(id) < options.requests; ++id) {
+        const auto& rays = batches[id % batches.size()];
+        const RequestHeader request = {
+            magic, id, options.query, options.mesh, static_cast<uint32_t>(rays.size() * sizeof(RayRecord))
+        };
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            answered.wait(lock, [&] { return closed || static_cast<int>(in_flight.size()) < options.depth; });
+            if (closed) {
+                break;
+            }
+            in_flight[id] = Clock::now();
+        }
+        if (!write_all(fd, &request, sizeof(request)) || !write_all(fd, rays.data(), request.bytes)) {
+            ::shutdown(fd, SHUT_RDWR);
+            break;
+        }
+    }
+    receiver.join();
+
+    result.errors += in_flight.size();
+    ::close(fd);
+    return result;
+}
+
+
+int main(int argc, char** argv) {
+    try {
+        const auto options = parse_options(argc, argv);
+        std::signal(SIGPIPE, SIG_IGN);
+        const auto info = request_info(options);
+        std::cerr << "mesh " << options.mesh << ": " << info.triangles << " triangles" << std::endl;
+
+        std::vector<ConnectionResult> results(options.connections);
+        std::vector<std::thread> threads;
+        const auto start = Clock::now();
+        for (int i = 0; i < options.connections; ++i) {
+            threads.emplace_back([&, i] {
+                try {
+                    results[i] = run_connection(options, info, options.seed + i);
+                } catch (...) {
+                    results[i].errors = options.requests;
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        const std::chrono::duration<double> duration = Clock::now() - start;
+
+        ConnectionResult total;
+        for (const auto& result : results) {
+            total.latencies.insert(total.latencies.end(), result.latencies.begin(), result.latencies.end());
+            total.rays += result.rays;
+            total.hits += result.hits;
+            total.errors += result.errors;
+        }
+        std::sort(total.latencies.begin(), total.latencies.end());
+        auto percentile = [&total](double p) {
+            if (total.latencies.empty()) {
+                return 0.0;
+            }
+            const size_t index = std::min(total.latencies.size() - 1, static_cast<size_t>(p * total.latencies.size()));
+            return total.latencies[index];
+        };
+
+        std::cout << total.latencies.size() << " requests, " << total.errors << " errors, "
+                  << total.rays << " rays, " << total.hits << " hits in " << duration.count() << " s" << std::endl
+                  << total.latencies.size() / duration.count() << " requests/s, "
+                  << total.rays / duration.count() << " rays/s" << std::endl
+                  << "latency ms: p50 " << percentile(0.5) << ", p90 " << percentile(0.9)
+                  << ", p99 " << percentile(0.99) << ", max " << percentile(1) << std::endl;
+        return total.errors > 0 ? 1 : 0;
+    } catch (const std::string& error) {
+        std::cerr << error << std::endl;
+        return 2;
+    } catch (const char* error) {
+        std::cerr << error << std::endl;
+        return 2;
+    }
+}
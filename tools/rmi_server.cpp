@@ -0,0 +1,389 @@
+/*
+ * Query server: loads meshes and builds their trees once, then answers batched
+ * ray queries of many local clients over a Unix domain socket (see
+ * query_protocol.hpp). Every connection has a reader and a writer thread,
+ * requests are answered by a pool of workers, so one client may pipeline
+ * many of them. Unanswered requests of a connection are limited.
+ *
+ * rmi_server --socket /tmp/rmi.sock --meshes sphere:1000000,data/bunny.ply [--workers 8] [--splitter sah]
+ *
+ * Generated meshes are given as name:triangles (sphere, terrain, soup, slivers),
+ * anything else is read as a mesh file.
+ */
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "rmilib/rmi.hpp"
+#include "rmilib/raw_mesh.hpp"
+#include "query_protocol.hpp"
+#include "tool_common.hpp"
+
+using namespace rmi::protocol;
+using namespace rmi::tools;
+
+
+struct Options {
+    std::string socket = "/tmp/rmi.sock";
+    std::vector<std::string> meshes = {"sphere:1000000"};
+    int workers = std::max(1u, std::thread::hardware_concurrency());
+    std::string splitter = "sah";
+};
+
+struct LoadedMesh {
+    std::string name;
+    std::unique_ptr<WebGLMesh> mesh;
+    // references elements of mesh, so mesh is never moved
+    std::unique_ptr<rmi::KDTree<WebGLMesh>> tree;
+};
+
+// Responses are queued by workers and written by the connection's own thread,
+// so a client not reading them stalls only its own requests, not the workers
+class Connection {
+public:
+    explicit Connection(int fd): fd(fd), writer([this] { write_responses(); }) {}
+
+    ~Connection() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closing = true;
+        }
+        changed.notify_all();
+        writer.join();
+        ::close(fd);
+    }
+
+    // Waits until a request of this size fits into in-flight limits, a request
+    // is released when its response is written
+    void admit(uint32_t bytes) {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&] {
+            return in_flight_jobs == 0 ||
+                (in_flight_jobs < max_in_flight_jobs && in_flight_bytes + bytes <= max_in_flight_bytes);
+        });
+        ++in_flight_jobs;
+        in_flight_bytes += bytes;
+    }
+
+    // Queues response of admitted request, never blocks on the socket
+    void send(const ResponseHeader& header, std::vector<char>&& payload, uint32_t request_bytes) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            outbox.push_back({header, std::move(payload), request_bytes});
+        }
+        changed.notify_all();
+    }
+
+    // Waits until responses of all admitted requests are written
+    void drain() {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this] { return in_flight_jobs == 0; });
+    }
+
+    const int fd;
+private:
+    struct Response {
+        ResponseHeader    header;
+        std::vector<char> payload;
+        uint32_t          request_bytes;
+    };
+
+    void write_responses() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            changed.wait(lock, [this] { return closing || !outbox.empty(); });
+            if (outbox.empty()) {
+                return;
+            }
+            Response response = std::move(outbox.front());
+            outbox.pop_front();
+            lock.unlock();
+            // after an error the rest is dropped, admissions are still released
+            broken = broken ||
+                !write_all(fd, &response.header, sizeof(response.header)) ||
+                !write_all(fd, response.payload.data(), response.payload.size());
+            lock.lock();
+            --in_flight_jobs;
+            in_flight_bytes -= response.request_bytes;
+            changed.notify_all();
+        }
+    }
+
+    std::mutex              mutex;
+    std::condition_variable changed;
+    std::deque<Response>    outbox;
+    size_t                  in_flight_jobs = 0;
+    size_t                  in_flight_bytes = 0;
+    bool                    closing = false;
+    // touched by the writer thread only
+    bool                    broken = false;
+    std::thread             writer;
+};
+
+struct Job {
+    std::shared_ptr<Connection> connection;
+    RequestHeader header;
+    // payload is read from the socket directly into this buffer
+    std::vector<RayRecord> rays;
+};
+
+
+class WorkerPool {
+public:
+    WorkerPool(int count, std::function<void(Job&)> handler): handler(std::move(handler)) {
+        for (int i = 0; i < count; ++i) {
+            threads.emplace_back([this] { work(); });
+        }
+    }
+
+    void push(Job&& job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(std::move(job));
+        }
+        ready.notify_one();
+    }
+private:
+    void work() {
+        while (true) {
+            std::unique_lock<std::mutex> lock(mutex);
+            ready.wait(lock, [this] { return !jobs.empty(); });
+            Job job = std::move(jobs.front());
+            jobs.pop_front();
+            lock.unlock();
+            handler(job);
+        }
+    }
+
+    std::function<void(Job&)> handler;
+    std::vector<std::thread> threads;
+    std::deque<Job> jobs;
+    std::mutex mutex;
+    std::condition_variable ready;
+};
+
+
+Options parse_options(int argc, char** argv) {
+    Options options;
+    for_each_option(argc, argv, [&](const std::string& arg, const auto& value) {
+        if (arg == "--socket") {
+            options.socket = value();
+        } else if (arg == "--meshes") {
+            options.meshes = split_list(value());
+        } else if (arg == "--workers") {
+            options.workers = std::max(1, std::stoi(value()));
+        } else if (arg == "--splitter") {
+            options.splitter = value();
+        } else {
+            throw "Unknown option " + arg;
+        }
+    });
+    return options;
+}
+
+
+class Server {
+public:
+    Server(std::vector<LoadedMesh>&& meshes, int workers):
+        meshes(std::move(meshes)),
+        pool(workers, [this](Job& job) { answer(job); })
+    {}
+
+    // Reads requests of connection until it is closed, requests are answered by workers.
+    // Reading stops while the connection has too many unanswered requests.
+    void serve(std::shared_ptr<Connection> connection) {
+        RequestHeader header;
+        while (read_all(connection->fd, &header, sizeof(header))) {
+            if (header.magic != magic || header.bytes > max_message_bytes || header.bytes % sizeof(RayRecord) != 0) {
+                connection->admit(0);
+                reply(*connection, header, Status::BadRequest, {}, 0);
+                break;
+            }
+
+            connection->admit(header.bytes);
+            Job job{connection, header, std::vector<RayRecord>(header.bytes / sizeof(RayRecord))};
+            if (!read_all(connection->fd, job.rays.data(), header.bytes)) {
+                // nothing else will release the admitted request
+                reply(*connection, header, Status::BadRequest, {}, header.bytes);
+                break;
+            }
+            pool.push(std::move(job));
+        }
+        connection->drain();
+    }
+private:
+    // Admission of admitted_bytes is released when the response is written
+    void reply(
+        Connection& connection,
+        const RequestHeader& request,
+        Status status,
+        std::vector<char>&& payload,
+        uint32_t admitted_bytes
+    ) {
+        const ResponseHeader header = {magic, request.id, request.query, status, static_cast<uint32_t>(payload.size())};
+        connection.send(header, std::move(payload), admitted_bytes);
+    }
+
+    void reply(Job& job, Status status, std::vector<char>&& payload = {}) {
+        reply(*job.connection, job.header, status, std::move(payload), job.header.bytes);
+    }
+
+    void answer(Job& job) {
+        const auto& header = job.header;
+        if (header.query == Query::Info) {
+            std::vector<char> payload(meshes.size() * sizeof(MeshInfo));
+            for (size_t i = 0; i < meshes.size(); ++i) {
+                const auto& box = meshes[i].tree->top().box();
+                const MeshInfo info = {
+                    static_cast<uint32_t>(meshes[i].mesh->size()),
+                    {box.min.x(), box.min.y(), box.min.z()},
+                    {box.max.x(), box.max.y(), box.max.z()}
+                };
+                std::memcpy(payload.data() + i * sizeof(MeshInfo), &info, sizeof(info));
+            }
+            reply(job, Status::Ok, std::move(payload));
+            return;
+        }
+        if (header.mesh >= meshes.size()) {
+            reply(job, Status::UnknownMesh);
+            return;
+        }
+
+        const auto& tree = *meshes[header.mesh].tree;
+        std::vector<char> payload;
+        switch (header.query) {
+        case Query::Hits:     payload = hits(tree, job.rays);     break;
+        case Query::Closest:  payload = closest(tree, job.rays);  break;
+        case Query::Occluded: payload = occluded(tree, job.rays); break;
+        default:
+            reply(job, Status::BadRequest);
+            return;
+        }
+        reply(job, Status::Ok, std::move(payload));
+    }
+
+    static rmi::Ray<float> to_ray(const RayRecord& record) {
+        return rmi::Ray<float>(
+            rmi::Vector3f(record.origin[0], record.origin[1], record.origin[2]),
+            rmi::Vector3f(record.direction[0], record.direction[1], record.direction[2]),
+            record.t_min,
+            record.t_max
+        );
+    }
+
+    template<typename Value>
+    static void append(std::vector<char>& payload, const Value& value) {
+        const auto* bytes = reinterpret_cast<const char*>(&value);
+        payload.insert(payload.end(), bytes, bytes + sizeof(value));
+    }
+
+    static std::vector<char> hits(const rmi::KDTree<WebGLMesh>& tree, const std::vector<RayRecord>& rays) {
+        std::vector<uint32_t> offsets = {0};
+        std::vector<rmi::Vector3f> points;
+        for (const auto& record : rays) {
+            to_ray(record).intersects(tree, points);
+            offsets.push_back(points.size());
+        }
+
+        std::vector<char> payload;
+        payload.reserve(offsets.size() * sizeof(uint32_t) + points.size() * 3 * sizeof(float));
+        for (auto offset : offsets) {
+            append(payload, offset);
+        }
+        for (const auto& point : points) {
+            append(payload, point.x());
+            append(payload, point.y());
+            append(payload, point.z());
+        }
+        return payload;
+    }
+
+    static std::vector<char> closest(const rmi::KDTree<WebGLMesh>& tree, const std::vector<RayRecord>& rays) {
+        std::vector<char> payload;
+        payload.reserve(rays.size() * sizeof(ClosestHit));
+        for (const auto& record : rays) {
+            const auto ray = to_ray(record);
+            ClosestHit hit = {std::numeric_limits<float>::infinity(), {0, 0, 0}};
+            if (const auto point = ray.closest_intersection(tree); point) {
+                hit = {(*point - ray.origin()).length(), {point->x(), point->y(), point->z()}};
+            }
+            append(payload, hit);
+        }
+        return payload;
+    }
+
+    static std::vector<char> occluded(const rmi::KDTree<WebGLMesh>& tree, const std::vector<RayRecord>& rays) {
+        std::vector<char> payload;
+        payload.reserve(rays.size());
+        for (const auto& record : rays) {
+            payload.push_back(to_ray(record).intersects_any(tree));
+        }
+        return payload;
+    }
+
+    std::vector<LoadedMesh> meshes;
+    WorkerPool pool;
+};
+
+
+int main(int argc, char** argv) {
+    try {
+        const auto options = parse_options(argc, argv);
+        std::signal(SIGPIPE, SIG_IGN);
+
+        std::vector<LoadedMesh> meshes;
+        for (const auto& spec : options.meshes) {
+            const auto start = std::chrono::steady_clock::now();
+            auto mesh = std::make_unique<WebGLMesh>(load_mesh(spec));
+            auto tree = build_tree(*mesh, options.workers, options.splitter);
+            const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+            std::cerr << "mesh " << meshes.size() << ": " << spec << " (" << mesh->size() << " triangles), "
+                      << duration.count() << " s" << std::endl;
+            meshes.push_back({spec, std::move(mesh), std::move(tree)});
+        }
+
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if (options.socket.size() >= sizeof(address.sun_path)) {
+            throw "Too long socket path " + options.socket;
+        }
+        options.socket.copy(address.sun_path, options.socket.size());
+
+        const int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        ::unlink(options.socket.c_str());
+        if (listener < 0 || ::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || ::listen(listener, 64) < 0) {
+            throw "Can't listen on " + options.socket + ": " + std::strerror(errno);
+        }
+        std::cerr << "listening on " << options.socket << " with " << options.workers << " workers" << std::endl;
+
+        Server server(std::move(meshes), options.workers);
+        while (true) {
+            const int fd = ::accept(listener, nullptr, nullptr);
+            if (fd < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::string("Can't accept connection: ") + std::strerror(errno);
+            }
+            std::thread([&server, fd] { server.serve(std::make_shared<Connection>(fd)); }).detach();
+        }
+    } catch (const std::string& error) {
+        std::cerr << error << std::endl;
+        return 2;
+    } catch (const char* error) {
+        std::cerr << error << std::endl;
+        return 2;
+    }
+}
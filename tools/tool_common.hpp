@@ -0,0 +1,59 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "rmilib/rmi.hpp"
+#include "rmilib/raw_mesh.hpp"
+#include "rmilib/reader.hpp"
+#include "rmilib/mesh_generator.hpp"
+#include "tool_options.hpp"
+
+
+/*
+ * Mesh helpers shared by rmi_cast and rmi_server, errors are thrown as strings
+ * and reported by main.
+ */
+namespace rmi::tools {
+
+// Generated meshes are given as name:triangles (sphere, terrain, soup, slivers),
+// anything else is read as a mesh file
+inline WebGLMesh load_mesh(const std::string& spec) {
+    const auto colon = spec.find(':');
+    if (colon != std::string::npos) {
+        const auto name = spec.substr(0, colon);
+        const size_t size = std::stoul(spec.substr(colon + 1));
+        if (name == "sphere") {
+            return generate_sphere_mesh<float, unsigned int>(size);
+        } else if (name == "terrain") {
+            return generate_terrain_mesh<float, unsigned int>(size, 1);
+        } else if (name == "soup") {
+            return generate_soup_mesh<float, unsigned int>(size, 1);
+        } else if (name == "slivers") {
+            return generate_slivers_mesh<float, unsigned int>(size, 1);
+        }
+    }
+    return read_raw_triangular_mesh<float, unsigned int>(spec);
+}
+
+template<typename Splitter>
+std::unique_ptr<KDTree<WebGLMesh>> build_tree(WebGLMesh& mesh, [[maybe_unused]] int threads, const Splitter& splitter) {
+#ifdef RMI_INCLUDE_POOL
+    if (threads > 1) {
+        return std::make_unique<KDTree<WebGLMesh>>(KDTree<WebGLMesh>::pool_for_mesh(mesh, threads, splitter));
+    }
+#endif
+    return std::make_unique<KDTree<WebGLMesh>>(KDTree<WebGLMesh>::for_mesh(mesh, splitter));
+}
+
+// Tree of the mesh by splitter name (sah, median), built by the pool when threads > 1
+inline std::unique_ptr<KDTree<WebGLMesh>> build_tree(WebGLMesh& mesh, int threads, const std::string& splitter) {
+    if (splitter == "sah") {
+        return build_tree(mesh, threads, SAHSplitter<WebGLMesh>());
+    } else if (splitter == "median") {
+        return build_tree(mesh, threads, MedianSplitter<WebGLMesh>());
+    }
+    throw "Unknown splitter " + splitter;
+}
+
+} // namespace rmi::tools
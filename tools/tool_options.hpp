@@ -0,0 +1,48 @@
+#pragma once
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+/*
+ * Command line helpers shared by all tools. They don't depend on rmilib, so
+ * rmi_load, which only talks to the server, uses them too. Errors are thrown
+ * as strings and reported by main.
+ */
+namespace rmi::tools {
+
+// Comma separated items, empty ones are skipped
+inline std::vector<std::string> split_list(const std::string& list) {
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+inline bool ends_with(const std::string& value, const std::string& suffix) {
+    return value.size() >= suffix.size() && value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Calls handle(arg, value) for every option, value() consumes the next argument
+// and throws when it is missing. Handler throws on unknown options.
+template<typename Handler>
+void for_each_option(int argc, char** argv, const Handler& handle) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw "Missing value of " + arg;
+            }
+            return argv[++i];
+        };
+        handle(arg, value);
+    }
+}
+
+} // namespace rmi::tools
@@ -22,12 +22,10 @@ class IntersectionHandler {
         this.pointsColor = [0.96, 0.3, 0.0, 1];
     }
 
+    // Coordinates of points by 3 numbers
     extendPoints(intersections) {
-        const size = intersections.size();
-        if (size > 0) {
-            for (let i = 0; i < size; ++i) {
-                this.coords.push(...intersections.get(i));
-            }
+        if (intersections.length > 0) {
+            this.coords.push(...intersections);
             this.points = new Drawable({position: this.coords}, this.pointsColor, gl.POINTS);
         }
     }
@@ -35,8 +33,11 @@ class IntersectionHandler {
     findIntersections(ray, tree) {
         this.clear();
 
+        // batch of one ray, hits come back in one typed array
+        const rays = Float32Array.of(...ray.origin(), ...ray.direction());
+
         let start = performance.now();
-        const intersections = ray.intersectsKDTree(tree.data);
+        const intersections = Module.intersectsRays(tree.data, rays).points.slice();
         const seqTimeInfo = `${toFixed(performance.now() - start, 3)} ms`;
 
         let parTimeInfo = "-";
@@ -47,7 +48,7 @@ class IntersectionHandler {
         }
 
         this.ray = ray;
-        this.info = `seq: ${seqTimeInfo}, par: ${parTimeInfo}`;
+        this.info = `seq: ${seqTimeInfo}, par: ${parTimeInfo}${useSimd ? " (simd)" : ""}`;
 
         this.extendPoints(intersections);
         const pair = ray.intersectsAABB(tree.data.root().box);
@@ -61,7 +62,7 @@ class IntersectionHandler {
         this.tree = tree;
         this.ray = ray;
 
-        tree.ascendToRoot();
+        tree.startTraversal(ray);
 
         this.boxes = new Drawable({position: this.tree.createWireframe()}, this.boxesColor, gl.LINES);
         const pair = ray.intersectsAABB(tree.data.root().box);
@@ -72,7 +73,7 @@ class IntersectionHandler {
 
     traverse() {
         if (this.tree) {
-            this.extendPoints(this.tree.descendAlongRay(this.ray));
+            this.extendPoints(this.tree.descendAlongRay());
 
             const wireframe = this.tree.createWireframe();
             if (wireframe.length == 0) {
@@ -1,74 +1,106 @@
+// Promises of trees built off the main thread by rmilib_par, by build id
+const treeBuilds = new Map();
+
+
 class Tree {
     constructor(data) {
         this.data = data;
-        this.nodes = [this.data.root()];
+
+        // boxes and links are copied, views over module memory are detached when it grows
+        this.flat = this.data.flatten();
+        this.boxes = this.flat.boxes().slice();
+        this.links = this.flat.links().slice();
+
+        this.traversal = null;
+        this.nodes = [0];
+    }
+
+    // Builds tree on the pthread pool, the page stays responsive. Only one build
+    // of a mesh may run at a time, since elements of the mesh are reordered.
+    static buildAsync(meshData, splitter, threadsCount) {
+        Module.onTreeBuilt ??= (id, success) => {
+            const {resolve, reject} = treeBuilds.get(id);
+            treeBuilds.delete(id);
+            if (success) {
+                resolve(new Tree(Module.takeBuiltTree(id)));
+            } else {
+                reject(new Error("Can't build tree"));
+            }
+        };
+
+        return new Promise((resolve, reject) => {
+            const id = Module.startPoolTreeBuild(meshData, splitter, threadsCount);
+            treeBuilds.set(id, {resolve, reject});
+        });
     }
 
     createWireframe() {
         let points = [];
         for (const node of this.nodes) {
-            const mn = node.box.min;
-            const mx = node.box.max;
-
-            const dx = mx[0] - mn[0];
-            const dy = mx[1] - mn[1];
-            const dz = mx[2] - mn[2];
-
+            const [x0, y0, z0, x1, y1, z1] = this.boxes.subarray(6 * node, 6 * node + 6);
             points.push(
-                mn[0],      mn[1],      mn[2],
-                mn[0] + dx, mn[1],      mn[2],
-                mn[0],      mn[1],      mn[2],
-                mn[0],      mn[1],      mn[2] + dz,
-                mn[0] + dx, mn[1],      mn[2],
-                mn[0] + dx, mn[1],      mn[2] + dz,
-                mn[0],      mn[1],      mn[2] + dz,
-                mn[0] + dx, mn[1],      mn[2] + dz,
+                x0, y0, z0,  x1, y0, z0,
+                x0, y0, z0,  x0, y0, z1,
+                x1, y0, z0,  x1, y0, z1,
+                x0, y0, z1,  x1, y0, z1,
 
-                mn[0],      mn[1] + dy, mn[2],
-                mn[0] + dx, mn[1] + dy, mn[2],
-                mn[0],      mn[1] + dy, mn[2],
-                mn[0],      mn[1] + dy, mn[2] + dz,
-                mn[0],      mn[1] + dy, mn[2] + dz,
-                mn[0] + dx, mn[1] + dy, mn[2] + dz,
-                mn[0] + dx, mn[1] + dy, mn[2],
-                mn[0] + dx, mn[1] + dy, mn[2] + dz,
+                x0, y1, z0,  x1, y1, z0,
+                x0, y1, z0,  x0, y1, z1,
+                x0, y1, z1,  x1, y1, z1,
+                x1, y1, z0,  x1, y1, z1,
 
-                mn[0],      mn[1],      mn[2],
-                mn[0],      mn[1] + dy, mn[2],
-                mn[0] + dx, mn[1],      mn[2],
-                mn[0] + dx, mn[1] + dy, mn[2],
-                mn[0],      mn[1],      mn[2] + dz,
-                mn[0],      mn[1] + dy, mn[2] + dz,
-                mn[0] + dx, mn[1],      mn[2] + dz,
-                mn[0] + dx, mn[1] + dy, mn[2] + dz,
+                x0, y0, z0,  x0, y1, z0,
+                x1, y0, z0,  x1, y1, z0,
+                x0, y0, z1,  x0, y1, z1,
+                x1, y0, z1,  x1, y1, z1,
             );
         }
         return points;
     }
 
-    descendAlongRay(ray) {
+    isLeaf(node) {
+        return this.links[3 * node + 1] < 0;
+    }
+
+    // The whole traversal is computed by one call, descending only reads its result
+    startTraversal(ray) {
+        const result = this.flat.traverse(ray);
+        this.traversal = {
+            visited: result.visited.slice(),
+            leaves: result.leaves.slice(),
+            points: result.points.slice(),
+        };
+        this.nodes = [0];
+    }
+
+    // Returns coordinates of hits in reached leaves, by 3 numbers
+    descendAlongRay() {
         let childrenNodes = [];
-        let intersections = new Module.PointsList();
+        let reached = new Set();
         for (const node of this.nodes) {
-            if (node.isLeaf()) {
-                const points = ray.intersectsNode(node);
-                for (let i = 0; i < points.size(); ++i) {
-                    intersections.push_back(points.get(i));
-                }
+            if (this.isLeaf(node)) {
+                reached.add(node);
             } else {
-                if (ray.isIntersectsAABB(node.left().box)) {
-                    childrenNodes.push(node.left());
-                }
-                if (ray.isIntersectsAABB(node.right().box)) {
-                    childrenNodes.push(node.right());
+                for (const child of [this.links[3 * node + 1], this.links[3 * node + 2]]) {
+                    if (this.traversal.visited[child]) {
+                        childrenNodes.push(child);
+                    }
                 }
             }
         }
+
+        let intersections = [];
+        const {leaves, points} = this.traversal;
+        for (let i = 0; i < leaves.length; ++i) {
+            if (reached.has(leaves[i])) {
+                intersections.push(points[3 * i], points[3 * i + 1], points[3 * i + 2]);
+            }
+        }
         this.nodes = childrenNodes;
         return intersections;
     }
 
     ascendToRoot() {
-        this.nodes = [this.data.root()];
+        this.nodes = [0];
     }
 }
@@ -8,11 +8,16 @@ const handler = new IntersectionHandler();
 const camera = new Camera();
 let mesh = null;
 let tree = null;
+// the last started parallel build, the next one waits for it
+let treeBuild = Promise.resolve();
+// id of the last requested parallel build, results of older ones are dropped
+let treeRequest = 0;
 
 const TARGET_FRAMERATE = 120;
 
 let stepUnits = 0.2;
 let useParallel = false;
+let useSimd = false;
 let lastRenderTime = 0;
 
 let movement = {
@@ -33,12 +38,44 @@ function isViewerActive() {
 }
 
 
-function loadParallelLibVersion() {
-    const parLibScript = document.createElement("script");
-    parLibScript.src = "web/js/rmilib_par.js";
-    document.body.appendChild(parLibScript);
+// Smallest module with v128 instructions, rejected by browsers without SIMD support
+function isSimdSupported() {
+    return WebAssembly.validate(new Uint8Array([
+        0, 97, 115, 109, 1, 0, 0, 0, 1, 5, 1, 96, 0, 1, 123, 3, 2, 1, 0,
+        10, 10, 1, 8, 0, 65, 0, 253, 15, 253, 98, 11
+    ]));
+}
+
+
+// Loads SIMD build of the module if it is supported and was built (RMI_WASM_SIMD), scalar one otherwise
+function loadLibScript(name, onload, onerror) {
+    const script = document.createElement("script");
+    const simd = isSimdSupported();
+    script.src = `web/js/${name}${simd ? "_simd" : ""}.js`;
+    document.body.appendChild(script);
 
-    parLibScript.onload = () => {
+    script.onload = () => {
+        useSimd = simd;
+        onload();
+    }
+
+    script.onerror = () => {
+        script.remove();
+        if (!simd) {
+            onerror();
+            return;
+        }
+        const fallback = document.createElement("script");
+        fallback.src = `web/js/${name}.js`;
+        document.body.appendChild(fallback);
+        fallback.onload = onload;
+        fallback.onerror = onerror;
+    }
+}
+
+
+function loadParallelLibVersion() {
+    loadLibScript("rmilib_par", () => {
         const headersScript = document.createElement("script");
         headersScript.src = "coi-serviceworker.min.js";
         document.body.appendChild(headersScript);
@@ -52,28 +89,20 @@ function loadParallelLibVersion() {
             alert("Can't setup COOP/COEP");
             location.reload();
         }
-    }
-
-    parLibScript.onerror = () => {
+    }, () => {
         alert("Can't load parallel lib version");
         location.reload();
-    }
+    });
 }
 
 
 function loadSeqLibVersion() {
-    const libScript = document.createElement("script");
-    libScript.src = "web/js/rmilib_seq.js";
-    document.body.appendChild(libScript);
-
-    libScript.onload = () => {
+    loadLibScript("rmilib_seq", () => {
         useParallel = false;
         Module.onRuntimeInitialized = main;
-    }
-
-    libScript.onerror = () => {
+    }, () => {
         alert("Can't load seq lib version");
-    }
+    });
 }
 
 
@@ -105,7 +134,35 @@ function updateTree() {
     case "median": splitter = Module.Splitter.Median; break;
     }
 
-    tree = new Tree(Module.KDTree.forMesh(mesh.data, splitter));
+    if (!useParallel) {
+        tree = new Tree(Module.KDTree.forMesh(mesh.data, splitter));
+        return;
+    }
+
+    // the old tree references elements, that are reordered by the build
+    tree = null;
+    const request = ++treeRequest;
+    const target = mesh;
+    const label = document.querySelector('label[for="file-upload"]');
+    treeBuild = treeBuild.then(() => {
+        // a previous build of the same mesh may have set the tree in the meantime,
+        // neither it nor its traversal may be used until this build is finished
+        handler.clear();
+        tree = null;
+        label.classList.add("button-loading");
+        const start = performance.now();
+        return Tree.buildAsync(target.data, splitter, parseInt(threadsCountSlider.value)).then((built) => {
+            console.log(`tree built in ${toFixed(performance.now() - start, 3)} ms`);
+            if (request === treeRequest && target === mesh) {
+                tree = built;
+            }
+        });
+    }).catch((err) => {
+        alert("Can't build tree");
+        console.error(err);
+    }).finally(() => {
+        label.classList.remove("button-loading");
+    });
 }
 
 
@@ -124,7 +181,7 @@ function takeScreenShot() {
 ui.onclick = () => {
     if (mesh && !isViewerActive()) {
         ui.requestPointerLock();
-    } else if (isViewerActive()) {
+    } else if (isViewerActive() && tree) {
         const ray = camera.eyeRay();
         if (checkbox.checked) {
             handler.startTraversal(ray, tree);
@@ -1,7 +1,79 @@
+#include <emscripten/threading.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
 #include "rmilib_shared.hpp"
 
 
+rmi::KDTree<WebGLMesh> pool_tree_for_mesh(WebGLMesh& mesh, SplitterType splitter, int threads_count) {
+    switch (splitter) {
+    case SplitterType::SAH:
+        return rmi::KDTree<WebGLMesh>::pool_for_mesh(mesh, threads_count, rmi::SAHSplitter<WebGLMesh>());
+    case SplitterType::Median:
+        return rmi::KDTree<WebGLMesh>::pool_for_mesh(mesh, threads_count, rmi::MedianSplitter<WebGLMesh>());
+    }
+}
+
+
+// Trees built off the main thread wait here until JS takes them
+std::mutex built_trees_mutex;
+std::map<int, std::unique_ptr<rmi::KDTree<WebGLMesh>>> built_trees;
+int next_build_id = 0;
+
+// Called on the main thread, settles the promise of build (see Tree.buildAsync in web/js/tree.js)
+void notify_tree_built(int id, int success) {
+    EM_ASM({ Module.onTreeBuilt($0, $1); }, id, success);
+}
+
+// Builds tree on a pthread, so the main thread keeps handling events. The mesh
+// must not be deleted, used by other builds or queried through older trees
+// until the build is finished.
+int start_pool_tree_build(WebGLMesh& mesh, SplitterType splitter, int threads_count) {
+    const int id = next_build_id++;
+    std::thread([&mesh, splitter, threads_count, id] {
+        int success = 1;
+        try {
+            auto tree = std::make_unique<rmi::KDTree<WebGLMesh>>(pool_tree_for_mesh(mesh, splitter, threads_count));
+            std::lock_guard<std::mutex> lock(built_trees_mutex);
+            built_trees[id] = std::move(tree);
+        } catch (...) {
+            success = 0;
+        }
+        emscripten_async_run_in_main_runtime_thread(EM_FUNC_SIG_VII, notify_tree_built, id, success);
+    }).detach();
+    return id;
+}
+
+emscripten::val pool_intersects_rays(const WebGLTree& tree, const emscripten::val& array, int threads_count) {
+    const auto rays = unpack_rays(array);
+    std::vector<std::vector<rmi::Vector3f>> results(rays.size());
+    rmi::parallel::pool_for(threads_count, rays.size(), 64, [&](size_t i) {
+        rays[i].intersects(tree, results[i]);
+    });
+
+    auto& hits = rays_hits();
+    for (const auto& result : results) {
+        hits.append(result);
+    }
+    return hits.view();
+}
+
+rmi::KDTree<WebGLMesh> take_built_tree(int id) {
+    std::lock_guard<std::mutex> lock(built_trees_mutex);
+    auto tree = std::move(built_trees.at(id));
+    built_trees.erase(id);
+    return std::move(*tree);
+}
+
+
 EMSCRIPTEN_BINDINGS(module) {
     register_shared()
-        .function("poolIntersectsTree", &rmi::Ray<float>::pool_intersects<WebGLMesh>);
+        .function("poolIntersectsTree", &rmi::Ray<float>::pool_intersects<rmi::KDTree<WebGLMesh>>);
+
+    emscripten::function("poolTreeForMesh", &pool_tree_for_mesh);
+    emscripten::function("startPoolTreeBuild", &start_pool_tree_build);
+    emscripten::function("takeBuiltTree", &take_built_tree);
+    emscripten::function("poolIntersectsRays", &pool_intersects_rays);
 }
@@ -2,6 +2,9 @@
 
 #include <emscripten.h>
 #include <emscripten/bind.h>
+#include <emscripten/val.h>
+#include <cstdint>
+#include <unordered_map>
 #include <vector>
 #include <sstream>
 
@@ -26,6 +29,155 @@ enum class SplitterType {
 };
 
 
+using WebGLTree = rmi::KDTree<WebGLMesh>;
+
+
+// Rays packed by 6 floats: origin and direction
+std::vector<rmi::Ray<float>> unpack_rays(const emscripten::val& array) {
+    const auto coords = emscripten::convertJSArrayToNumberVector<float>(array);
+    std::vector<rmi::Ray<float>> rays;
+    rays.reserve(coords.size() / 6);
+    for (size_t i = 0; i + 6 <= coords.size(); i += 6) {
+        rays.emplace_back(
+            rmi::Vector3f(coords[i + 0], coords[i + 1], coords[i + 2]),
+            rmi::Vector3f(coords[i + 3], coords[i + 4], coords[i + 5])
+        );
+    }
+    return rays;
+}
+
+
+/*
+ * Hits of a batch of rays: hits of ray i are points from offsets[i] to
+ * offsets[i + 1], by 3 floats. JS gets views over module memory, which are
+ * valid until the next batch (or memory growth), so they are copied if kept.
+ */
+struct RaysHits {
+    std::vector<uint32_t> offsets;
+    std::vector<float>    points;
+
+    void append(const std::vector<rmi::Vector3f>& hits) {
+        for (const auto& hit : hits) {
+            points.insert(points.end(), {hit.x(), hit.y(), hit.z()});
+        }
+        offsets.push_back(points.size() / 3);
+    }
+
+    emscripten::val view() const {
+        using emscripten::val;
+        val result = val::object();
+        result.set("offsets", val(emscripten::typed_memory_view(offsets.size(), offsets.data())));
+        result.set("points",  val(emscripten::typed_memory_view(points.size(), points.data())));
+        return result;
+    }
+};
+
+RaysHits& rays_hits() {
+    static RaysHits hits;
+    hits.offsets.assign(1, 0);
+    hits.points.clear();
+    return hits;
+}
+
+emscripten::val intersects_rays(const WebGLTree& tree, const emscripten::val& array) {
+    auto& hits = rays_hits();
+    std::vector<rmi::Vector3f> buffer;
+    for (const auto& ray : unpack_rays(array)) {
+        buffer.clear();
+        ray.intersects(tree, buffer);
+        hits.append(buffer);
+    }
+    return hits.view();
+}
+
+
+/*
+ * Tree in arrays for drawing and traversal visualisation in JS. Nodes are in
+ * depth-first order, boxes are min and max corners by 6 floats, links are
+ * depth, left and right child indices by 3 ints (-1 for children of leaves).
+ * The tree must live as long as this object.
+ */
+class FlatTree {
+public:
+    explicit FlatTree(const WebGLTree& tree): tree(&tree) {
+        add(tree.top(), 0);
+    }
+
+    size_t size() const { return nodes.size(); }
+
+    emscripten::val boxes() const {
+        return emscripten::val(emscripten::typed_memory_view(m_boxes.size(), m_boxes.data()));
+    }
+
+    emscripten::val links() const {
+        return emscripten::val(emscripten::typed_memory_view(m_links.size(), m_links.data()));
+    }
+
+    /*
+     * One traversal for a whole visualisation: visited has 1 for nodes with
+     * boxes crossed by the ray, hits of leaf leaves[i] are points[3 * i .. 3 * i + 3).
+     * Views are valid until the next traversal.
+     */
+    emscripten::val traverse(const rmi::Ray<float>& ray) {
+        visited.assign(nodes.size(), 0);
+        leaves.clear();
+        points.clear();
+        visit(ray, tree->top());
+
+        using emscripten::val;
+        val result = val::object();
+        result.set("visited", val(emscripten::typed_memory_view(visited.size(), visited.data())));
+        result.set("leaves",  val(emscripten::typed_memory_view(leaves.size(), leaves.data())));
+        result.set("points",  val(emscripten::typed_memory_view(points.size(), points.data())));
+        return result;
+    }
+private:
+    int add(const WebGLTree::Node& node, int depth) {
+        const int id = nodes.size();
+        nodes.push_back(&node);
+        ids[&node] = id;
+
+        const auto& box = node.box();
+        m_boxes.insert(m_boxes.end(), {box.min.x(), box.min.y(), box.min.z(), box.max.x(), box.max.y(), box.max.z()});
+        m_links.insert(m_links.end(), {depth, -1, -1});
+        if (!node.is_leaf()) {
+            const int left = add(node.left(), depth + 1);
+            const int right = add(node.right(), depth + 1);
+            m_links[3 * id + 1] = left;
+            m_links[3 * id + 2] = right;
+        }
+        return id;
+    }
+
+    void visit(const rmi::Ray<float>& ray, const WebGLTree::Node& node) {
+        if (!ray.is_intersects(node.box())) {
+            return;
+        }
+        const int id = ids[&node];
+        visited[id] = 1;
+        if (node.is_leaf()) {
+            ray.intersects_leaf<WebGLMesh>(node, std::numeric_limits<float>::epsilon(), [&](const auto&, const rmi::Vector3f& hit) {
+                leaves.push_back(id);
+                points.insert(points.end(), {hit.x(), hit.y(), hit.z()});
+            });
+            return;
+        }
+        visit(ray, node.left());
+        visit(ray, node.right());
+    }
+
+    const WebGLTree*                                  tree;
+    std::vector<const WebGLTree::Node*>               nodes;
+    std::unordered_map<const WebGLTree::Node*, int>   ids;
+    std::vector<float>                                m_boxes;
+    std::vector<int32_t>                              m_links;
+
+    std::vector<uint8_t>                              visited;
+    std::vector<int32_t>                              leaves;
+    std::vector<float>                                points;
+};
+
+
 auto register_shared() {
     using namespace emscripten;
 
@@ -81,12 +233,24 @@ auto register_shared() {
             return ray.intersects(tree);
         })
         .function("root", +[](const rmi::KDTree<WebGLMesh>& tree) { return &tree.top(); }, allow_raw_pointers())
+        .function("flatten", +[](const rmi::KDTree<WebGLMesh>& tree) { return FlatTree(tree); })
+        ;
+
+    class_<FlatTree>("FlatTree")
+        .property("size",   &FlatTree::size)
+        .function("boxes",    &FlatTree::boxes)
+        .function("links",    &FlatTree::links)
+        .function("traverse", &FlatTree::traverse)
         ;
 
+    function("intersectsRays", &intersects_rays);
+
     function("readMesh", &read_mesh_from_string);
 
     return class_<rmi::Ray<float>>("Ray")
         .constructor<rmi::Vector3f, rmi::Vector3f>()
+        .function("origin",    +[](const rmi::Ray<float>& ray) { return ray.origin(); })
+        .function("direction", +[](const rmi::Ray<float>& ray) { return ray.direction(); })
         .function("at", &rmi::Ray<float>::at)
         .function("isIntersectsAABB", &rmi::Ray<float>::is_intersects)
         .function("intersectsNode", +[](const rmi::Ray<float>& ray, const typename rmi::KDTree<WebGLMesh>::Node* node) {